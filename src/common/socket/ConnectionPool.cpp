@@ -0,0 +1,270 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+ * @file    ConnectionPool.cpp
+ * @brief   Persistent framed connections to a mwsd, shared by threads
+ * @date    2026-10-19
+ *
+ * License: GPLv3
+ */
+
+/****************************************************************************/
+/* Includes                                                                 */
+/****************************************************************************/
+
+#include <netdb.h>                      // getaddrinfo
+#include <poll.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "ConnectionPool.hpp"
+#include "common/utils/TimeStamp.hpp"
+#include "common/utils/ToString.hpp"
+#include "config.h"
+
+/****************************************************************************/
+/* Namespaces                                                               */
+/****************************************************************************/
+
+using namespace std;
+
+/****************************************************************************/
+/* Constants                                                                */
+/****************************************************************************/
+
+/// First wait after mwsd could not be reached
+static const unsigned MIN_BACKOFF_MS = 100;
+
+/****************************************************************************/
+/* Implementation                                                           */
+/****************************************************************************/
+
+/**
+ * @brief   Check that an idle connection was not closed by mwsd, which
+ *          never sends anything unasked.
+ */
+static bool
+isIdleAlive(int fd)
+{
+    struct pollfd pollFd;
+
+    pollFd.fd = fd;
+    pollFd.events = POLLIN;
+    pollFd.revents = 0;
+
+    return poll(&pollFd, 1, 0) == 0;
+}
+
+/**
+ * @brief   Requests which can be sent again if their connection turns out to
+ *          be stale, since they do not change the index.
+ */
+static bool
+isIdempotent(uint8_t type)
+{
+    return type == FRAME_QUERY || type == FRAME_ENCODED_QUERY ||
+            type == FRAME_BATCH_QUERY || type == FRAME_GENERATION;
+}
+
+ConnectionPool::Config::Config() :
+    host(DEFAULT_MWS_HOST),
+    port(DEFAULT_MWS_PORT),
+    maxConnections(20),
+    timeoutMs(30000),
+    maxBackoffMs(5000)
+{
+}
+
+ConnectionPool::ConnectionPool(const Config& config) :
+    _config(config),
+    _numOpen(0),
+    _nextRequestId(0),
+    _addrLen(0),
+    _backoffMs(0),
+    _retryAtMs(0)
+{
+    pthread_mutex_init(&_lock, NULL);
+    pthread_cond_init(&_released, NULL);
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    for (int fd : _idle) {
+        (void) close(fd);
+    }
+    pthread_cond_destroy(&_released);
+    pthread_mutex_destroy(&_lock);
+}
+
+int
+ConnectionPool::request(Frame* request, Frame* answer)
+{
+    bool  reused;
+    int   fd;
+
+    do {
+        if ((fd = acquire(&reused)) < 0) return -1;
+
+        pthread_mutex_lock(&_lock);
+        request->requestId = _nextRequestId++;
+        pthread_mutex_unlock(&_lock);
+
+        bool healthy = writeFrame(fd, *request) == 0 &&
+                readFrame(fd, answer) == 1 &&
+                answer->requestId == request->requestId;
+        release(fd, healthy);
+        if (healthy) return 0;
+    // harvests and deletions might have been carried out already
+    } while (reused && isIdempotent(request->type));
+
+    return -1;
+}
+
+int
+ConnectionPool::acquire(bool* reused)
+{
+    int fd;
+
+    pthread_mutex_lock(&_lock);
+    while (true) {
+        while (!_idle.empty()) {
+            fd = _idle.back();
+            _idle.pop_back();
+            if (isIdleAlive(fd)) {
+                pthread_mutex_unlock(&_lock);
+                *reused = true;
+                return fd;
+            }
+            (void) close(fd);
+            _numOpen--;
+        }
+        if (_numOpen < _config.maxConnections) break;
+        pthread_cond_wait(&_released, &_lock);
+    }
+
+    if (_backoffMs > 0 && MonotonicMs() < _retryAtMs) {
+        pthread_mutex_unlock(&_lock);
+        return -1;
+    }
+    _numOpen++;
+    pthread_mutex_unlock(&_lock);
+
+    fd = connectMws();
+
+    pthread_mutex_lock(&_lock);
+    if (fd < 0) {
+        _numOpen--;
+        _backoffMs = (_backoffMs > 0) ?
+                min(2 * _backoffMs, _config.maxBackoffMs) : MIN_BACKOFF_MS;
+        _retryAtMs = MonotonicMs() + _backoffMs;
+        pthread_cond_signal(&_released);
+    } else {
+        _backoffMs = 0;
+    }
+    pthread_mutex_unlock(&_lock);
+
+    *reused = false;
+    return fd;
+}
+
+void
+ConnectionPool::release(int fd, bool healthy)
+{
+    pthread_mutex_lock(&_lock);
+    if (healthy) {
+        _idle.push_back(fd);
+    } else {
+        (void) close(fd);
+        _numOpen--;
+        // mwsd may have moved
+        _addrLen = 0;
+    }
+    pthread_cond_signal(&_released);
+    pthread_mutex_unlock(&_lock);
+}
+
+int
+ConnectionPool::connectMws()
+{
+    struct sockaddr_storage addr;
+    socklen_t               addrLen;
+    struct timeval          timeout;
+    int                     fd;
+
+    pthread_mutex_lock(&_lock);
+    addr = _addr;
+    addrLen = _addrLen;
+    pthread_mutex_unlock(&_lock);
+
+    if (addrLen == 0 && !_config.socketPath.empty()) {
+        struct sockaddr_un* unAddr = (struct sockaddr_un*) &addr;
+
+        if (_config.socketPath.size() >= sizeof(unAddr->sun_path)) return -1;
+        memset(unAddr, 0, sizeof(*unAddr));
+        unAddr->sun_family = AF_UNIX;
+        strcpy(unAddr->sun_path, _config.socketPath.c_str());
+        addrLen = sizeof(*unAddr);
+    } else if (addrLen == 0) {
+        struct addrinfo hints;
+        struct addrinfo* result;
+
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(_config.host.c_str(),
+                        ToString(_config.port).c_str(),
+                        &hints, &result) != 0) {
+            return -1;
+        }
+        memcpy(&addr, result->ai_addr, result->ai_addrlen);
+        addrLen = result->ai_addrlen;
+        freeaddrinfo(result);
+    }
+
+    fd = socket(addr.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    timeout.tv_sec = _config.timeoutMs / 1000;
+    timeout.tv_usec = (_config.timeoutMs % 1000) * 1000;
+#ifdef SO_NOSIGPIPE
+    int noSigpipe = 1;
+    (void) setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSigpipe,
+                      sizeof(noSigpipe));
+#endif
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                   sizeof(timeout)) != 0 ||
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+                       sizeof(timeout)) != 0 ||
+            connect(fd, (const struct sockaddr*) &addr, addrLen) != 0) {
+        (void) close(fd);
+        return -1;
+    }
+
+    pthread_mutex_lock(&_lock);
+    _addr = addr;
+    _addrLen = addrLen;
+    pthread_mutex_unlock(&_lock);
+
+    return fd;
+}
@@ -0,0 +1,131 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+ * @file    ConnectionPool.hpp
+ * @brief   Persistent framed connections to a mwsd, shared by threads
+ * @date    2026-10-19
+ *
+ * License: GPLv3
+ */
+#ifndef _CONNECTIONPOOL_HPP
+#define _CONNECTIONPOOL_HPP
+
+/****************************************************************************/
+/* Includes                                                                 */
+/****************************************************************************/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <string>
+#include <vector>
+
+#include "Frame.hpp"
+
+/****************************************************************************/
+/* Prototypes                                                               */
+/****************************************************************************/
+
+/**
+ * @class ConnectionPool
+ * ConnectionPool sends requests to a mwsd over framed connections (see
+ * Frame) which are kept open between requests, instead of connecting for
+ * every request. The host is only resolved when connecting.
+ *
+ * Idle connections closed by mwsd are detected when they are taken from
+ * the pool, and replaced. When mwsd cannot be reached, the pool waits
+ * longer and longer (up to maxBackoffMs) before connecting again, and the
+ * requests fail right away meanwhile.
+ */
+class ConnectionPool
+{
+public:
+    struct Config {
+        std::string host;
+        int         port;
+        /// Unix domain socket of mwsd, used instead of host and port if set
+        std::string socketPath;
+        /// connections to mwsd, which bounds the requests in flight
+        unsigned    maxConnections;
+        /// time mwsd has to answer a request
+        unsigned    timeoutMs;
+        /// longest wait between two failed attempts to connect
+        unsigned    maxBackoffMs;
+
+        Config();
+    };
+
+// Members
+private:
+    Config                  _config;
+    pthread_mutex_t         _lock;
+    pthread_cond_t          _released;  /**< Signaled when one is released */
+    std::vector<int>        _idle;      /**< Idle connections              */
+    unsigned                _numOpen;   /**< Idle and used connections     */
+    uint32_t                _nextRequestId;
+    struct sockaddr_storage _addr;      /**< Address of mwsd when resolved */
+    socklen_t               _addrLen;   /**< 0 until resolved              */
+    unsigned                _backoffMs; /**< 0 while mwsd is reachable     */
+    double                  _retryAtMs; /**< When to connect again         */
+
+// Constructors and destructors
+public:
+    ConnectionPool(const Config& config);
+    ~ConnectionPool();
+
+// Class Methods
+public:
+    /**
+     * @brief   Send a request to mwsd and wait for its answer.
+     *
+     * Requests which do not change the index (queries, encoded and batch
+     * queries, generations) and fail on a connection which was idle in the
+     * pool are sent again on a new connection, as mwsd may have been
+     * restarted.
+     *
+     * @param   request request to send, whose requestId is set here
+     * @param   answer  where to store the answer
+     * @return  0 on success
+     * @return  -1 if mwsd could not be reached or did not answer in time
+     */
+    int request(Frame* request, Frame* answer);
+
+private:
+    /**
+     * @brief   Take a connection from the pool, or connect a new one.
+     * @param   reused  set if the connection was idle in the pool
+     * @return  the connection, or -1 on failure
+     */
+    int acquire(bool* reused);
+
+    /**
+     * @brief   Give a connection back to the pool, or close it if it failed.
+     */
+    void release(int fd, bool healthy);
+
+    /// @return a new connection to mwsd, or -1 on failure
+    int connectMws();
+
+    ConnectionPool(const ConnectionPool&);
+    ConnectionPool& operator=(const ConnectionPool&);
+};
+
+#endif // ! _CONNECTIONPOOL_HPP
@@ -0,0 +1,171 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+ * @file    Frame.cpp
+ * @brief   Length-prefixed frames carrying several requests per connection
+ * @date    2026-10-19
+ *
+ * License: GPLv3
+ */
+
+/****************************************************************************/
+/* Includes                                                                 */
+/****************************************************************************/
+
+#include <arpa/inet.h>                  // htonl, ntohl
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>                 // sendmsg
+#include <sys/uio.h>                    // writev
+#include <unistd.h>
+
+#include "Frame.hpp"
+
+#ifndef MSG_NOSIGNAL                    // SO_NOSIGPIPE is set instead
+#define MSG_NOSIGNAL 0
+#endif
+
+/****************************************************************************/
+/* Namespaces                                                               */
+/****************************************************************************/
+
+using namespace std;
+
+/****************************************************************************/
+/* Implementation                                                           */
+/****************************************************************************/
+
+/**
+ * @brief   Read exactly size bytes.
+ * @return  size on success, less if the connection was closed, -1 on failure
+ */
+static ssize_t
+readAll(int fd, void* buf, size_t size)
+{
+    size_t done = 0;
+
+    while (done < size) {
+        ssize_t n = read(fd, (char*) buf + done, size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        if (n == 0) break;
+        done += n;
+    }
+
+    return done;
+}
+
+bool
+isFrameStart(const char* buf, size_t size)
+{
+    return size >= FRAME_MAGIC_SIZE &&
+            memcmp(buf, FRAME_MAGIC, FRAME_MAGIC_SIZE) == 0;
+}
+
+int
+readFrame(int fd, Frame* frame)
+{
+    unsigned char header[FRAME_HEADER_SIZE];
+    uint32_t      value;
+    ssize_t       n;
+
+    n = readAll(fd, header, sizeof(header));
+    if (n == 0) return 0;
+    if (n != sizeof(header) ||
+            !isFrameStart((const char*) header, sizeof(header)) ||
+            header[3] != FRAME_VERSION) {
+        return -1;
+    }
+    frame->type = header[4];
+    frame->status = header[5];
+    frame->format = header[6];
+    memcpy(&value, header + 8, sizeof(value));
+    frame->requestId = ntohl(value);
+    memcpy(&value, header + 12, sizeof(value));
+    value = ntohl(value);
+    if (value > FRAME_MAX_LENGTH) return -1;
+
+    frame->body.resize(value);
+    if (value > 0 && readAll(fd, &frame->body[0], value) != (ssize_t) value) {
+        return -1;
+    }
+
+    return 1;
+}
+
+int
+writeFrame(int fd, const Frame& frame)
+{
+    unsigned char header[FRAME_HEADER_SIZE];
+    uint32_t      value;
+    struct iovec  iov[2];
+    size_t        left;
+
+    memcpy(header, FRAME_MAGIC, FRAME_MAGIC_SIZE);
+    header[3] = FRAME_VERSION;
+    header[4] = frame.type;
+    header[5] = frame.status;
+    header[6] = frame.format;
+    header[7] = 0;
+    value = htonl(frame.requestId);
+    memcpy(header + 8, &value, sizeof(value));
+    value = htonl(frame.body.size());
+    memcpy(header + 12, &value, sizeof(value));
+
+    iov[0].iov_base = header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = (void*) frame.body.data();
+    iov[1].iov_len = frame.body.size();
+    left = sizeof(header) + frame.body.size();
+
+    // header and body in as few segments as possible, without SIGPIPE if
+    // the peer closed a socket
+    struct iovec* current = iov;
+    int count = 2;
+    bool isSocket = true;
+    while (left > 0) {
+        struct msghdr msg;
+        ssize_t n;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = current;
+        msg.msg_iovlen = count;
+        n = isSocket ? sendmsg(fd, &msg, MSG_NOSIGNAL) : writev(fd, current,
+                                                                count);
+        if (n < 0 && errno == ENOTSOCK && isSocket) {
+            isSocket = false;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        left -= n;
+        while (count > 0 && (size_t) n >= current->iov_len) {
+            n -= current->iov_len;
+            current++;
+            count--;
+        }
+        if (count > 0) {
+            current->iov_base = (char*) current->iov_base + n;
+            current->iov_len -= n;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+ * @file    Frame.hpp
+ * @brief   Length-prefixed frames carrying several requests per connection
+ * @date    2026-10-19
+ *
+ * License: GPLv3
+ */
+#ifndef _FRAME_HPP
+#define _FRAME_HPP
+
+/****************************************************************************/
+/* Includes                                                                 */
+/****************************************************************************/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+/****************************************************************************/
+/* Prototypes                                                               */
+/****************************************************************************/
+
+/// Bytes starting every frame header, which cannot start an XML document
+#define FRAME_MAGIC             "MWS"
+#define FRAME_MAGIC_SIZE        3
+/// Version of the framing, following the magic
+#define FRAME_VERSION           2
+/// Size of a frame header on the wire
+#define FRAME_HEADER_SIZE       16
+/// Largest frame body accepted (harvests included)
+#define FRAME_MAX_LENGTH        (1u << 28)
+
+/// Requests, answered by a frame of the same type
+enum FrameType {
+    FRAME_QUERY                 = 1,
+    FRAME_HARVEST               = 2,
+    FRAME_DELETE                = 3,
+    /// token of the current index contents, answered as the body (the
+    /// token changes whenever the answers to queries may change)
+    FRAME_GENERATION            = 4,
+    /// query encoded as by mws/query/EncodedQuery.hpp
+    FRAME_ENCODED_QUERY         = 5,
+    /// query whose expressions are each answered, with one answer set per
+    /// expression in the answer
+    FRAME_BATCH_QUERY           = 6
+};
+
+/// Outcome of a request, set in the answer frame
+enum FrameStatus {
+    FRAME_STATUS_OK             = 0,
+    /// the request could not be parsed or carried out
+    FRAME_STATUS_ERROR          = 1
+};
+
+/**
+ * @brief Request or answer of the framed protocol.
+ *
+ * On the wire, a frame is its header, then length bytes of body:
+ *
+ *     "MWS" version(1) type(1) status(1) format(1) reserved(1)
+ *     requestId(4) length(4)
+ *
+ * with integers in network byte order. A client may send several requests
+ * on a connection without waiting for the answers, which come back in any
+ * order, each with the requestId of its request.
+ */
+struct Frame
+{
+    uint8_t     type;                   /**< FrameType                      */
+    uint8_t     status;                 /**< FrameStatus of answers         */
+    uint8_t     format;                 /**< DataFormat of the body         */
+    uint32_t    requestId;              /**< Chosen by the client           */
+    std::string body;
+
+    Frame() : type(0), status(FRAME_STATUS_OK), format(0), requestId(0) {}
+};
+
+/**
+ * @brief   Check whether a connection starts with a frame.
+ *
+ * @param   buf     first bytes received on the connection
+ * @param   size    number of bytes in buf
+ * @return  true if buf starts with the frame magic
+ */
+bool isFrameStart(const char* buf, size_t size);
+
+/**
+ * @brief   Read a frame, blocking until it is received whole.
+ *
+ * @param   fd      file descriptor to read from
+ * @param   frame   where to store the frame
+ * @return  1 if a frame was read
+ * @return  0 if the connection was closed between two frames
+ * @return  -1 on failure or if the frame is not valid
+ */
+int readFrame(int fd, Frame* frame);
+
+/**
+ * @brief   Write a frame whole. Writing to a socket closed by its peer
+ * fails rather than raising SIGPIPE.
+ *
+ * @param   fd      file descriptor to write to
+ * @param   frame   frame to write
+ * @return  0 on success, -1 on failure
+ */
+int writeFrame(int fd, const Frame& frame);
+
+#endif // ! _FRAME_HPP
@@ -34,6 +34,8 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 #include <netinet/in.h>                 // Domain, Protocol standards
 #include <iostream>                     // Standard input/output stream
 #include <sys/socket.h>                 // ISO C Socket library
+#include <sys/stat.h>                   // stat()
+#include <sys/un.h>                     // Unix domain sockets: sockaddr_un
 #include <unistd.h>                     // write()
 #include <cerrno>                       // C errno codes
 #include <unistd.h>
@@ -56,6 +58,16 @@ InSocket::InSocket(int aPort,
 }
 
 
+InSocket::InSocket(const string& aPath,
+                   int aQueueSize) :
+        _port       ( 0 ),
+        _path       ( aPath ),
+        _queueSize  ( aQueueSize ),
+        _isOpen     ( false )
+{
+}
+
+
 InSocket::~InSocket()
 {
     if (this->_isOpen)
@@ -67,6 +79,10 @@ InSocket::~InSocket()
         {
             perror("close:");
         }
+        if (!this->_path.empty())
+        {
+            (void) unlink(this->_path.c_str());
+        }
     }
 }
 
@@ -76,6 +92,11 @@ int InSocket::enable()
     int ret;
     int optval_true = true;     // integer True Value - see setsockopt (2)
 
+    if (!this->_path.empty())
+    {
+        return this->enableUnix();
+    }
+
     this->_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (this->_fd == -1)
     {
@@ -121,7 +142,68 @@ fail:
 }
 
 
+int InSocket::enableUnix()
+{
+    int ret;
+    struct sockaddr_un addr;
+    struct stat st;
+
+    this->_fd = -1;
+    if (this->_path.size() >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Socket path too long: %s\n", this->_path.c_str());
+        goto fail;
+    }
+
+    this->_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (this->_fd == -1)
+    {
+        perror("socket");
+        goto fail;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, this->_path.c_str());
+
+    // a socket left behind by a previous run would make bind() fail
+    if (stat(this->_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+    {
+        (void) unlink(this->_path.c_str());
+    }
+
+    ret = ::bind(this->_fd, (struct sockaddr*) &addr, sizeof(addr));
+    if (ret == -1)
+    {
+        perror("bind");
+        goto fail;
+    }
+
+    ret = listen(this->_fd, this->_queueSize);
+    if (ret == -1)
+    {
+        perror("listen");
+        (void) unlink(this->_path.c_str());
+        goto fail;
+    }
+    this->_isOpen = true;
+
+    return 0;
+
+fail:
+    fprintf(stderr, "%s failed\n", __func__);
+    if (this->_fd >= 0) close(this->_fd);
+    return -1;
+}
+
+
 OutSocket* InSocket::accept()
 {
     return buildAcceptedConnection(this->_fd);
 }
+
+
+void InSocket::shutdown()
+{
+    (void) ::shutdown(this->_fd, SHUT_RDWR);
+}
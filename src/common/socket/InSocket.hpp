@@ -35,6 +35,7 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 /****************************************************************************/
 
 #include <netinet/in.h>                 // Network related types: sockaddr_in
+#include <string>                       // STL string
 #include "OutSocket.hpp"                // OutSocket class definition
 
 /****************************************************************************/
@@ -50,6 +51,8 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 /**
  * InSocket is the general implementation of a server side socket which is
  * created, binded, set to listen and then just used to accept connections.
+ * It listens either on a TCP port or on a Unix domain socket, which is
+ * cheaper for clients on the same host.
  *
  * @brief Server side socket.
  */
@@ -62,6 +65,7 @@ class InSocket
     int         _fd;                    /**< File Descriptor of the socket  */
     _SockAddr   _insideAddr;            /**< Inside socket physical address */
     int         _port;                  /**< Port number                    */
+    std::string _path;                  /**< Unix socket path, or empty     */
     int         _queueSize;             /**< Acceptance queue max size      */
     bool        _isOpen;                /**< Socket open / closed state     */
 
@@ -75,6 +79,15 @@ public:
      */
     InSocket(int aPort,
              int aQueueSize = SOCKET_DEFAULT_QUEUE_SIZE);
+    /**
+     * @brief Constructor of an InSocket listening on a Unix domain socket.
+     *
+     * @param aPath path of the socket, replaced if it exists already and
+     *        removed when the InSocket is destroyed.
+     * @param aQueueSize maximum acceptance waiting connections.
+     */
+    InSocket(const std::string& aPath,
+             int aQueueSize = SOCKET_DEFAULT_QUEUE_SIZE);
     /**
       * @brief Destructor of the InSocket class.
       */
@@ -98,6 +111,18 @@ public:
      *         or if the socket is not started.
      */
     OutSocket* accept();
+
+    /**
+     * Note that this is safe to call from a signal handler.
+     *
+     * @brief Method to stop accepting connections, such that a blocked
+     * accept() returns NULL.
+     */
+    void shutdown();
+
+private:
+    /// enable() for a Unix domain socket
+    int enableUnix();
 };
 
 #endif // ! _INSOCKET_HPP
@@ -34,6 +34,7 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 #include <string.h>                     // Mem-related functions: memcpy
 #include <sys/socket.h>                 // ISO C Socket library
 #include <sys/types.h>                  // Datatypes: size_t, socklen_t
+#include <sys/un.h>                     // Unix domain sockets: sockaddr_un
 #include <unistd.h>                     // write()
 #include <netdb.h>                      // struct hostent, gethostbyname
 #include <cerrno>                       // C errno codes
@@ -70,7 +71,7 @@ using namespace std;
 
 
 OutSocket::OutSocket() :
-        _outsideLen ( sizeof(sockaddr_in) ),
+        _outsideLen ( sizeof(_SockAddr) ),
         _isOpen ( false )
 {
 }
@@ -95,6 +96,15 @@ OutSocket::OutSocket(int aPort) :
 }
 
 
+OutSocket::OutSocket(const string& aPath) :
+        _outsideLen ( sizeof(sockaddr_un) ),
+        _port   ( 0 ),
+        _path   ( aPath ),
+        _isOpen ( false )
+{
+}
+
+
 OutSocket::~OutSocket()
 {
     if (this->_isOpen)
@@ -114,6 +124,12 @@ int OutSocket::enable()
 {
     int ret;
     struct hostent *server;
+    struct sockaddr_in* inAddr;
+
+    if (!this->_path.empty())
+    {
+        return this->enableUnix();
+    }
 
     server = gethostbyname(this->_host.c_str());
     if (server == NULL) goto fail;
@@ -130,11 +146,12 @@ int OutSocket::enable()
         this->_isOpen = true;
     }
 
-    this->_outsideAddr.sin_family = AF_INET;
-    memcpy(&this->_outsideAddr.sin_addr.s_addr,
+    inAddr = (struct sockaddr_in*) &this->_outsideAddr;
+    inAddr->sin_family = AF_INET;
+    memcpy(&inAddr->sin_addr.s_addr,
            server->h_addr,
            server->h_length);
-    this->_outsideAddr.sin_port = htons(this->_port);
+    inAddr->sin_port = htons(this->_port);
     // Open _fd
     ret = connect(this->_fd,
                   (sockaddr*) &this->_outsideAddr, this->_outsideLen);
@@ -153,6 +170,44 @@ fail:
 }
 
 
+int OutSocket::enableUnix()
+{
+    int ret;
+    struct sockaddr_un* unAddr;
+
+    unAddr = (struct sockaddr_un*) &this->_outsideAddr;
+    if (this->_path.size() >= sizeof(unAddr->sun_path)) goto fail;
+
+    this->_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (this->_fd == -1)
+    {
+        perror("socket");
+        goto fail;
+    }
+    else
+    {
+        this->_isOpen = true;
+    }
+
+    memset(unAddr, 0, sizeof(*unAddr));
+    unAddr->sun_family = AF_UNIX;
+    strcpy(unAddr->sun_path, this->_path.c_str());
+    ret = connect(this->_fd,
+                  (sockaddr*) &this->_outsideAddr, this->_outsideLen);
+    if (ret == -1) goto fail;
+
+    return 0;
+
+fail:
+    fprintf(stderr, "%s failed\n", __func__);
+    if (this->_isOpen)
+    {
+        close(this->_fd);
+        this->_isOpen = false;
+    }
+    return -1;
+}
+
 
 int OutSocket::write(const void* pAddr, int nrBytes)
 {
@@ -222,6 +277,11 @@ SocketInfo OutSocket::getInfo() const
 
     if (!this->_isOpen) goto fail;
 
+    if (this->_outsideAddr.ss_family == AF_UNIX)
+    {
+        return this->getPeerInfo();
+    }
+
     ret = getnameinfo((const sockaddr*)&this->_outsideAddr, this->_outsideLen,
                       hostname, MAX_HOSTNAME_LEN,
                       service, MAX_SERVICE_LEN,
@@ -246,6 +306,36 @@ fail:
 }
 
 
+SocketInfo OutSocket::getPeerInfo() const
+{
+    SocketInfo info;
+
+#ifdef SO_PEERCRED
+    struct ucred cred;
+    socklen_t    credLen = sizeof(cred);
+    char         buf[32];
+
+    if (getsockopt(this->_fd, SOL_SOCKET, SO_PEERCRED,
+                   &cred, &credLen) == 0)
+    {
+        snprintf(buf, sizeof(buf), "pid %d", (int) cred.pid);
+        info.hostname = buf;
+        snprintf(buf, sizeof(buf), "uid %d", (int) cred.uid);
+        info.service  = buf;
+
+        return info;
+    }
+    perror("getsockopt");
+#endif // SO_PEERCRED
+
+    fprintf(stderr, "%s failed\n", __func__);
+    info.hostname = SOCKET_INFO_UNKNOWN;
+    info.service  = SOCKET_INFO_UNKNOWN;
+
+    return info;
+}
+
+
 OutSocket* buildAcceptedConnection(int aFd)
 {
     OutSocket* outsock;
@@ -35,6 +35,7 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 /****************************************************************************/
 
 #include <netinet/in.h>                 // Network related types: sockaddr_in
+#include <sys/socket.h>                 // Socket types: sockaddr_storage
 #include <string>                       // STL string
 
 /****************************************************************************/
@@ -54,23 +55,25 @@ struct SocketInfo
  * will be immediatly connected and used for read/write
  * opperations. The best examples are the kind of sockets a
  * client would use, or the resulting "sockets" of an accepted
- * connection (same socket, different file descriptors).
+ * connection (same socket, different file descriptors). The endpoint is
+ * either a TCP host and port, or a Unix domain socket.
  */
 class OutSocket
 {
 // Typedefs
 
 private:
-    typedef struct sockaddr_in _SockAddr;   /**< Socket address container   */
+    typedef struct sockaddr_storage _SockAddr; /**< Socket address container*/
 
 // Members
 
 private:
     int         _fd;                    /**< File Descriptor of the socket  */
     _SockAddr   _outsideAddr;           /**< Outside socket physical address*/
-    int         _outsideLen;            /**< Outside socket address length  */
+    socklen_t   _outsideLen;            /**< Outside socket address length  */
     std::string _host;                  /**< Host name                      */
     int         _port;                  /**< Port number                    */
+    std::string _path;                  /**< Unix socket path, or empty     */
     bool        _isOpen;                /**< Socket open / closed state     */
 
 // Constructors and destructors
@@ -92,6 +95,12 @@ public:
      */
     OutSocket(int aPort);
 
+    /**
+     * @brief Public constructor of an OutSocket connecting to the Unix
+     * domain socket at aPath.
+     */
+    explicit OutSocket(const std::string& aPath);
+
     /**
      * @brief Destructor of the OutSocket class
      */
@@ -135,11 +144,20 @@ public:
     int getFd() const;
 
     /**
-     * @brief Retrieve socket information
+     * @brief Retrieve socket information: the host and port of the
+     * endpoint, or the pid and uid of the process on the other end of a
+     * Unix domain socket
      * @return SocketInfo data
      */
     SocketInfo getInfo() const;
 
+private:
+    /// enable() for a Unix domain socket
+    int enableUnix();
+
+    /// getInfo() for a Unix domain socket, from SO_PEERCRED
+    SocketInfo getPeerInfo() const;
+
 // Friend methods
 
     /**
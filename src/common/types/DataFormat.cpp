@@ -49,6 +49,9 @@ operator << (std::ostream& out, DataFormat dataFormat)
     case DATAFORMAT_JSON:
         out << "application/json";
         break;
+    case DATAFORMAT_BINARY:
+        out << "application/x-mws-answset";
+        break;
     default:
         out << DEFAULT_MIME_TYPE;
         break;
@@ -47,6 +47,8 @@ enum DataFormat
     DATAFORMAT_UNKNOWN,
     DATAFORMAT_XML,
     DATAFORMAT_JSON,
+    /// compact answer sets (see mws/xmlparser/writeBinaryAnswsetToFd.hpp)
+    DATAFORMAT_BINARY,
 };
 
 std::ostream& operator << (std::ostream& out, DataFormat dataFormat);
@@ -21,6 +21,7 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef _COMMON_TYPES_IDDICTIONARY_HPP
 #define _COMMON_TYPES_IDDICTIONARY_HPP
 
+#include <pthread.h>
 #include <istream>
 #include <map>
 #include <ostream>
@@ -30,25 +31,49 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 namespace common {
 namespace types {
 
+/**
+ * @brief Ids given to keys in the order they are put. The ids of the keys
+ * never change, and keys may be put and looked up from several threads at
+ * once.
+ */
 template<class Key, class ValueId>
 class IdDictionary {
 private:
     typedef std::map<Key, ValueId>  _MapContainer;
     
     _MapContainer   _map;
+    ValueId         _firstId;
     ValueId         _nextId;
+    mutable pthread_rwlock_t _lock;
 public:
     static const ValueId KEY_NOT_FOUND = 0;
 
-    IdDictionary() :
-        _nextId(KEY_NOT_FOUND + 1)  {
+    /**
+     * @param firstId id of the first key put, such that the ids below it
+     * remain free for other uses
+     */
+    explicit IdDictionary(ValueId firstId = KEY_NOT_FOUND + 1) :
+        _firstId(firstId), _nextId(firstId)  {
+        pthread_rwlock_init(&_lock, NULL);
+    }
+
+    IdDictionary(const IdDictionary& other) {
+        pthread_rwlock_init(&_lock, NULL);
+        pthread_rwlock_rdlock(&other._lock);
+        _map = other._map;
+        _firstId = other._firstId;
+        _nextId = other._nextId;
+        pthread_rwlock_unlock(&other._lock);
+    }
+
+    ~IdDictionary() {
+        pthread_rwlock_destroy(&_lock);
     }
 
     int load(std::istream& in) {
         try {
             Key key;
-            while (!in.eof()) {
-                std::getline(in, key, '\0');
+            while (std::getline(in, key, '\0')) {
                 if (key.size() > 0) {
                     put(key);
                 } else {
@@ -63,16 +88,18 @@ public:
         return 0;
     }
 
-    int save(std::ostream& out) {
+    int save(std::ostream& out) const {
         std::vector<Key> keys;
-        keys.resize(_map.size());
 
-        for (typename _MapContainer::iterator it = _map.begin();
+        pthread_rwlock_rdlock(&_lock);
+        keys.resize(_map.size());
+        for (typename _MapContainer::const_iterator it = _map.begin();
              it != _map.end();
              it++) {
 
-            keys[it->second - 1] = it->first;
+            keys[it->second - _firstId] = it->first;
         }
+        pthread_rwlock_unlock(&_lock);
 
         try {
             Key key;
@@ -91,24 +118,33 @@ public:
         ValueId result = get(key);
 
         if (result == KEY_NOT_FOUND) {
-            result = _nextId;
-            _map[key] = _nextId;
-            _nextId++;
+            pthread_rwlock_wrlock(&_lock);
+            std::pair<typename _MapContainer::iterator, bool> ret =
+                    _map.insert(std::make_pair(key, _nextId));
+            if (ret.second) _nextId++;
+            result = ret.first->second;
+            pthread_rwlock_unlock(&_lock);
         }
 
         return result;
     }
 
-    ValueId get(const Key& key) {
-        typename _MapContainer :: iterator it;
+    ValueId get(const Key& key) const {
+        typename _MapContainer :: const_iterator it;
+        ValueId result = KEY_NOT_FOUND;
 
+        pthread_rwlock_rdlock(&_lock);
         it = _map.find(key);
         if (it != _map.end()) {
-            return it->second;
-        } else {
-            return KEY_NOT_FOUND;
+            result = it->second;
         }
+        pthread_rwlock_unlock(&_lock);
+
+        return result;
     }
+
+private:
+    IdDictionary& operator=(const IdDictionary&);
 };
 
 }  // namespace types
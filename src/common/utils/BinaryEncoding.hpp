@@ -0,0 +1,123 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef _BINARYENCODING_HPP
+#define _BINARYENCODING_HPP
+
+/**
+  * @brief Integers and strings of the binary encodings: little-endian
+  * uint32s, and varints (7 bits per byte, least significant first, high bit
+  * set on all but the last byte)
+  *
+  * @file BinaryEncoding.hpp
+  * @date 19 Oct 2026
+  *
+  * License: GPL v3
+  */
+
+// System includes
+
+#include <stdint.h>
+#include <string>
+
+/**
+  * @brief Append a little-endian uint32 to out.
+  */
+inline void
+putUint32(std::string* out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) {
+        out->push_back((char) (value >> (8 * i)));
+    }
+}
+
+/**
+  * @brief Read the little-endian uint32 at data.
+  */
+inline uint32_t
+getUint32(const unsigned char* data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) |
+            ((uint32_t) data[3] << 24);
+}
+
+/**
+  * @brief Append a varint to out.
+  */
+inline void
+putVarint(std::string* out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out->push_back((char) (value | 0x80));
+        value >>= 7;
+    }
+    out->push_back((char) value);
+}
+
+/**
+  * @brief Read the varint at *data, and move *data past it.
+  * @return 0 on success, -1 if the varint does not end before end.
+  */
+inline int
+getVarint(const unsigned char** data, const unsigned char* end,
+          uint64_t* value)
+{
+    *value = 0;
+    for (int shift = 0; *data < end && shift < 64; shift += 7) {
+        unsigned char byte = *(*data)++;
+        *value |= (uint64_t) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return 0;
+    }
+
+    return -1;
+}
+
+/**
+  * @brief Append a string as its varint length, then its bytes.
+  */
+inline void
+putVarintString(std::string* out, const std::string& value)
+{
+    putVarint(out, value.size());
+    out->append(value);
+}
+
+/**
+  * @brief Read the string at *data written by putVarintString(), and move
+  * *data past it.
+  * @return 0 on success, -1 if the string does not end before end.
+  */
+inline int
+getVarintString(const unsigned char** data, const unsigned char* end,
+                std::string* value)
+{
+    uint64_t length;
+
+    if (getVarint(data, end, &length) != 0 ||
+            length > (uint64_t) (end - *data)) {
+        return -1;
+    }
+    value->assign((const char*) *data, length);
+    *data += length;
+
+    return 0;
+}
+
+#endif // _BINARYENCODING_HPP
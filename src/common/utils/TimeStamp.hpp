@@ -36,6 +36,7 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 #include <string>                      // C++ string header
 #include <cstdio>                      // C standard IO header
 #include <ctime>                       // C time headers
+#include <time.h>                      // POSIX clocks
 
 // Macros
 #define TIMESTAMP_MAXBUFSZ       20
@@ -79,4 +80,18 @@ TimeStamp()
     return (std::string) buffer;
 }
 
+/**
+  * @brief Method to measure durations.
+  * @return milliseconds elapsed on a monotonic clock since an arbitrary point.
+  */
+inline double
+MonotonicMs()
+{
+    struct timespec ts;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
 #endif // _TIMESTAMP_HPP
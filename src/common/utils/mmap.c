@@ -67,6 +67,8 @@ int mmap_create(const char* path, off_t size, int flags, mmap_handle_t* mmap_han
     mmap_handle->path = path;
     mmap_handle->start_addr = mapped_region;
     mmap_handle->size = size;
+    mmap_handle->max_size = size;
+    mmap_handle->fd = -1;
 
     /* close file descriptor */
     (void) close(fd);
@@ -78,6 +80,68 @@ fail:
     return -1;
 }
 
+int mmap_create_growable(const char* path, off_t size, size_t max_size,
+                         mmap_handle_t* mmap_handle) {
+    int fd = -1;
+    char* reserved_region = MAP_FAILED;
+    int oflags;
+
+    FAIL_ON((size_t) size > max_size);
+
+    /* reserve address space, without backing memory */
+    reserved_region = mmap(/* addr   = */ NULL, max_size, PROT_NONE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                           /* fd     = */ -1, /* offset = */ 0);
+    FAIL_ON(reserved_region == MAP_FAILED);
+
+    /* opening file */
+    oflags = O_RDWR | O_CREAT | O_EXCL;
+    FAIL_ON((fd = open(path, oflags, S_IRUSR | S_IWUSR)) < 0);
+
+    /* copy to mmap_handle */
+    mmap_handle->path = path;
+    mmap_handle->start_addr = reserved_region;
+    mmap_handle->size = 0;
+    mmap_handle->max_size = max_size;
+    mmap_handle->fd = fd;
+
+    /* set file size and map it */
+    FAIL_ON(mmap_resize(mmap_handle, size) != 0);
+
+    return 0;
+
+fail:
+    if (fd >= 0) (void) close(fd);
+    if (reserved_region != MAP_FAILED) {
+        (void) munmap(reserved_region, max_size);
+    }
+    return -1;
+}
+
+int mmap_resize(mmap_handle_t* mmap_handle, off_t size) {
+    char* mapped_region;
+
+    FAIL_ON(mmap_handle->fd < 0);
+    FAIL_ON((size_t) size > mmap_handle->max_size);
+
+    /* set file size */
+    FAIL_ON(ftruncate(mmap_handle->fd, size) != 0);
+
+    /* map the file over the reserved range (data stays in the page cache) */
+    if ((size_t) size > mmap_handle->size) {
+        mapped_region = mmap(mmap_handle->start_addr, size,
+                             PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+                             mmap_handle->fd, /* offset = */ 0);
+        FAIL_ON(mapped_region == MAP_FAILED);
+    }
+    mmap_handle->size = size;
+
+    return 0;
+
+fail:
+    return -1;
+}
+
 int mmap_load(const char* path, int flags, mmap_handle_t* mmap_handle) {
     int fd = -1;
     struct stat s;
@@ -106,6 +170,68 @@ int mmap_load(const char* path, int flags, mmap_handle_t* mmap_handle) {
     mmap_handle->path = path;
     mmap_handle->start_addr = mapped_region;
     mmap_handle->size = size;
+    mmap_handle->max_size = size;
+    mmap_handle->fd = -1;
+
+    /* close file descriptor */
+    (void) close(fd);
+
+    return 0;
+
+fail:
+    if (fd >= 0) (void) close(fd);
+    return -1;
+}
+
+int mmap_load_anonymous(const char* path, int flags,
+                        mmap_handle_t* mmap_handle) {
+    int fd = -1;
+    struct stat s;
+    size_t size;
+    size_t map_size = 0;
+    size_t done;
+    ssize_t nread;
+    char* mapped_region = MAP_FAILED;
+
+    /* opening file */
+    FAIL_ON((fd = open(path, O_RDONLY)) < 0);
+
+    /* get file size */
+    FAIL_ON(fstat(fd, &s) < 0);
+    size = s.st_size;
+    FAIL_ON(size == 0);
+
+    /* hugetlb mappings have to span whole huge pages */
+    map_size = size;
+    if (flags & MAP_HUGETLB) {
+        map_size = (size + MMAP_HUGE_PAGE_SIZE - 1) / MMAP_HUGE_PAGE_SIZE *
+                MMAP_HUGE_PAGE_SIZE;
+    }
+
+    mapped_region = mmap(/* addr   = */ NULL, map_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | flags,
+                         /* fd     = */ -1, /* offset = */ 0);
+    FAIL_ON(mapped_region == MAP_FAILED);
+#ifdef MADV_HUGEPAGE
+    if (!(flags & MAP_HUGETLB)) {
+        /* best-effort, transparent huge pages may be disabled */
+        (void) madvise(mapped_region, map_size, MADV_HUGEPAGE);
+    }
+#endif
+
+    /* copy the file */
+    for (done = 0; done < size; done += nread) {
+        nread = pread(fd, mapped_region + done, size - done, done);
+        FAIL_ON(nread <= 0);
+    }
+    FAIL_ON(mprotect(mapped_region, map_size, PROT_READ) != 0);
+
+    /* copy to mmap_handle */
+    mmap_handle->path = path;
+    mmap_handle->start_addr = mapped_region;
+    mmap_handle->size = size;
+    mmap_handle->max_size = map_size;
+    mmap_handle->fd = -1;
 
     /* close file descriptor */
     (void) close(fd);
@@ -113,12 +239,17 @@ int mmap_load(const char* path, int flags, mmap_handle_t* mmap_handle) {
     return 0;
 
 fail:
+    if (mapped_region != MAP_FAILED) (void) munmap(mapped_region, map_size);
     if (fd >= 0) (void) close(fd);
     return -1;
 }
 
 int mmap_unload(mmap_handle_t* mmap_handle) {
-    FAIL_ON(munmap(mmap_handle->start_addr, mmap_handle->size) != 0);
+    FAIL_ON(munmap(mmap_handle->start_addr, mmap_handle->max_size) != 0);
+    if (mmap_handle->fd >= 0) {
+        (void) close(mmap_handle->fd);
+        mmap_handle->fd = -1;
+    }
     return 0;
 
 fail:
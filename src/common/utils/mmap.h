@@ -37,6 +37,20 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "common/utils/compiler_defs.h"
 
+/*--------------------------------------------------------------------------*/
+/* Constants                                                                */
+/*--------------------------------------------------------------------------*/
+
+/** Size of the huge pages backing MAP_HUGETLB mappings */
+#define MMAP_HUGE_PAGE_SIZE     (2 * 1024 * 1024)
+
+#ifndef MAP_POPULATE
+#define MAP_POPULATE    0
+#endif
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB     0
+#endif
+
 /*--------------------------------------------------------------------------*/
 /* Type declarations                                                        */
 /*--------------------------------------------------------------------------*/
@@ -44,7 +58,9 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 typedef struct mmap_handle_s {
     const char* path;
     char*    start_addr;
-    uint32_t size;
+    size_t   size;
+    size_t   max_size;  /* size of the reserved address range */
+    int      fd;        /* kept open by growable mmaps, -1 otherwise */
 } mmap_handle_t;
 
 /*--------------------------------------------------------------------------*/
@@ -61,6 +77,25 @@ BEGIN_DECLS
  */
 int mmap_create(const char* path, off_t size, int flags, mmap_handle_t* mmap);
 
+/**
+ * Create and mmap a read/writeable file at the start of a reserved address
+ * range of max_size bytes, such that it can be resized in place
+ *
+ * @return 0 on success
+ * @return -1 on failure
+ */
+int mmap_create_growable(const char* path, off_t size, size_t max_size,
+                         mmap_handle_t* mmap);
+
+/**
+ * Resize a growable mmap and its file in place. The mapped region never
+ * moves. Memory past a reduced size must no longer be accessed.
+ *
+ * @return 0 on success
+ * @return -1 on failure
+ */
+int mmap_resize(mmap_handle_t* mmap, off_t size);
+
 /**
  * Load a read-only mmap of a file
  *
@@ -69,6 +104,16 @@ int mmap_create(const char* path, off_t size, int flags, mmap_handle_t* mmap);
  */
 int mmap_load(const char* path, int flags, mmap_handle_t* mmap);
 
+/**
+ * Load a read-only copy of a file into anonymous memory. With MAP_HUGETLB in
+ * flags the copy is backed by huge pages and its mapping is rounded up to
+ * MMAP_HUGE_PAGE_SIZE, otherwise transparent huge pages are requested.
+ *
+ * @return 0 on success
+ * @return -1 on failure
+ */
+int mmap_load_anonymous(const char* path, int flags, mmap_handle_t* mmap);
+
 /**
  * @return 0 on success
  * @return -1 on failure
@@ -38,7 +38,7 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 
 // Local includes
 #include "MwsCrawler.hpp"
-#include "rest/types/MwsConnection.hpp"
+#include "common/socket/ConnectionPool.hpp"
 #include "crawler/types/Robotstxt.hpp"
 #include "crawler/types/SharedQueue.hpp"
 #include "crawler/utils/MwsGetMath.hpp"
@@ -223,11 +223,17 @@ void Crawler::run(SharedQueue *sq,const char* dataDir)
  */
 void Crawler::storeMath(const char *xml)
 {
-
-    MwsConnection mwsConn;
-    mwsConn.connect();
-    mwsConn.write((void*) xml, strlen(xml) );
-    mwsConn.signalEnd();
+    // one pool for all crawlers, whose connections stay open between pages
+    static ConnectionPool mwsPool((ConnectionPool::Config()));
+    Frame harvest, answer;
+
+    harvest.type = FRAME_HARVEST;
+    harvest.body = xml;
+    if (mwsPool.request(&harvest, &answer) != 0 ||
+            answer.status != FRAME_STATUS_OK)
+    {
+        cerr << "Cannot send harvest to MWSD" << endl;
+    }
 
     stringstream strs;
     strs << data_directory << "/harvest" << time(NULL) << ".xml";
@@ -0,0 +1,355 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+  * @file MwsBroker.cpp
+  * @brief Daemon answering the queries of mwsd clients from several shards
+  * @date 19 Oct 2026
+  */
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include <string>
+#include <vector>
+
+#include "MwsBroker.hpp"
+#include "common/socket/Frame.hpp"
+#include "common/socket/InSocket.hpp"
+#include "common/socket/OutSocket.hpp"
+#include "common/thread/ThreadWrapper.hpp"
+#include "common/types/ControlSequence.hpp"
+#include "common/utils/TimeStamp.hpp"
+#include "common/utils/ToString.hpp"
+#include "common/utils/macro_func.h"
+#include "mws/index/Partition.hpp"
+#include "mws/types/MwsQuery.hpp"
+#include "mws/xmlparser/readMwsQueryFromFd.hpp"
+#include "MwsQueryConf.hpp"
+
+using namespace std;
+
+namespace mws { namespace broker {
+
+/// Largest query document forwarded to the shards
+static const size_t MAX_QUERY_SIZE = 1 << 20;
+/// Time an idle framed connection waits before checking for exit
+static const int FRAME_IDLE_POLL_MS = 500;
+
+static const Config* brokerConfig;
+static InSocket* serverSocket;
+static volatile sig_atomic_t run = 1;
+
+static void
+graceful_exit(int signum)
+{
+    UNUSED(signum);
+    run = 0;
+    serverSocket->shutdown();
+}
+
+/**
+ * @brief Read the query sent on fd, until the client shuts down its end
+ * @return 0 on success, -1 on failure
+ */
+static int
+readQuery(OutSocket* outSocket, string* query)
+{
+    char buf[4096];
+    int n;
+
+    while ((n = outSocket->read(buf, sizeof(buf))) > 0) {
+        query->append(buf, n);
+        if (query->size() > MAX_QUERY_SIZE) return -1;
+    }
+
+    return (n == 0) ? 0 : -1;
+}
+
+/**
+ * @brief Rewrite a query to get the solutions of a shard from the first one
+ * to the last one the query asks for, such that the page is cut from the
+ * merged solutions, as binary answer sets which are cheap to read
+ * @param offset set to the offset of the solutions the query asks for
+ * @param size set to the number of solutions the query asks for
+ * @return 0 on success, -1 if query is not a mws:query document or its
+ * last solution is beyond UINT_MAX
+ */
+static int
+rewriteQuery(const string& query, string* shardQuery,
+             unsigned* offset, unsigned* size)
+{
+    xmlDocPtr doc;
+    xmlNodePtr root;
+    xmlChar* attr;
+    unsigned long limitMin, answSize;
+    xmlChar* dump;
+    int dumpSize;
+
+    doc = xmlReadMemory(query.data(), query.size(), NULL, NULL,
+                        XML_PARSE_NONET);
+    if (doc == NULL) return -1;
+    root = xmlDocGetRootElement(doc);
+    if (root == NULL || strcmp((const char*) root->name, "query") != 0) {
+        xmlFreeDoc(doc);
+        return -1;
+    }
+
+    limitMin = 0;
+    if ((attr = xmlGetProp(root, BAD_CAST "limitmin")) != NULL) {
+        limitMin = strtoul((const char*) attr, NULL, 10);
+        xmlFree(attr);
+    }
+    answSize = DEFAULT_MWSQUERY_MAXSIZE;
+    if ((attr = xmlGetProp(root, BAD_CAST "answsize")) != NULL) {
+        answSize = strtoul((const char*) attr, NULL, 10);
+        xmlFree(attr);
+    }
+    // the shards are asked for the solutions up to offset + size
+    if (limitMin > UINT_MAX || answSize > UINT_MAX - limitMin) {
+        xmlFreeDoc(doc);
+        return -1;
+    }
+    *offset = limitMin;
+    *size = answSize;
+    xmlSetProp(root, BAD_CAST "limitmin", BAD_CAST "0");
+    xmlSetProp(root, BAD_CAST "answsize",
+               BAD_CAST ToString(*offset + *size).c_str());
+    xmlSetProp(root, BAD_CAST "output", BAD_CAST "binary");
+
+    xmlDocDumpMemory(doc, &dump, &dumpSize);
+    shardQuery->assign((const char*) dump, dumpSize);
+    xmlFree(dump);
+    xmlFreeDoc(doc);
+
+    return 0;
+}
+
+/**
+ * @brief Choose the shards a query is sent to: the partition of its first
+ * tokens if the shards are partitions, all of them otherwise
+ */
+static vector<bool>
+routeQuery(const string& query)
+{
+    const vector<Shard>& shards = brokerConfig->shards;
+    vector<bool> routed(shards.size(), true);
+
+    if (brokerConfig->partitionTokens == 0) return routed;
+    MwsQuery* mwsQuery = readMwsQueryFromMemory(query.data(), query.size());
+    if (mwsQuery != NULL && !mwsQuery->tokens.empty()) {
+        int partition = index::Partition::route(mwsQuery->tokens[0],
+                                                shards.size(),
+                                                brokerConfig->partitionTokens);
+        if (partition >= 0) {
+            routed.assign(shards.size(), false);
+            routed[partition] = true;
+        }
+    }
+    delete mwsQuery;
+
+    return routed;
+}
+
+/**
+ * @brief Answer a query from the shards
+ * @param answer set to the merged JSON answer set
+ * @return 0 on success, 1 if the query is not valid, -1 if no shard
+ * answered
+ */
+static int
+answerQuery(const string& query, string* answer)
+{
+    vector<ShardAnswset> answsets;
+    string               shardQuery;
+    unsigned             offset, size;
+    vector<bool>         routed;
+    size_t               numQueried = 0, numAnswered = 0, numParsed = 0;
+    double               start = MonotonicMs();
+    int                  ret;
+
+    if (rewriteQuery(query, &shardQuery, &offset, &size) != 0) {
+        fprintf(stderr, "Bad query\n");
+        return 1;
+    }
+
+    routed = routeQuery(shardQuery);
+    queryShards(brokerConfig->shards, shardQuery, routed,
+                brokerConfig->shardTimeoutMs, &answsets);
+    for (const ShardAnswset& answset : answsets) {
+        if (!answset.skipped) numQueried++;
+        if (answset.answered) numAnswered++;
+        if (answset.parsed) numParsed++;
+    }
+
+    if (numParsed > 0) {
+        *answer = mergeJsonAnswsets(answsets, offset, size);
+        ret = 0;
+    } else {
+        // the shards could not parse the query, or none answered
+        ret = (numAnswered > 0) ? 1 : -1;
+    }
+
+    printf("%s %zu/%zu shards answered in %.0f ms\n",
+           TimeStamp().c_str(), numAnswered, numQueried,
+           MonotonicMs() - start);
+    fflush(stdout);
+
+    return ret;
+}
+
+/**
+ * @brief Answer the queries framed on a connection, one after the other,
+ * until the client closes it or the broker exits
+ */
+static void
+HandleFrames(OutSocket* outSocket)
+{
+    Frame         request;
+    struct pollfd pollFd;
+    int           ret;
+
+    pollFd.fd = outSocket->getFd();
+    pollFd.events = POLLIN;
+    while (run) {
+        // idle connections do not hold up exiting
+        ret = poll(&pollFd, 1, FRAME_IDLE_POLL_MS);
+        if (ret < 0 && errno != EINTR) break;
+        if (ret <= 0) continue;
+        if (readFrame(outSocket->getFd(), &request) != 1) break;
+
+        Frame answer;
+        answer.type = request.type;
+        answer.requestId = request.requestId;
+        answer.status = FRAME_STATUS_ERROR;
+        if (request.type == FRAME_QUERY &&
+                request.body.size() <= MAX_QUERY_SIZE) {
+            // queries no shard answered get an error too, and the
+            // connection is kept for the next ones
+            ret = answerQuery(request.body, &answer.body);
+            if (ret == 0) {
+                answer.status = FRAME_STATUS_OK;
+                answer.format = DATAFORMAT_JSON;
+            }
+        }
+        if (writeFrame(outSocket->getFd(), answer) != 0) {
+            fprintf(stderr, "Error while writing the Answer Set\n");
+            break;
+        }
+    }
+}
+
+static void*
+HandleConnection(void* dataPtr)
+{
+    OutSocket*           outSocket = (OutSocket*) dataPtr;
+    ControlSequence      controlSequence;
+    string               query, answer;
+    char                 start[FRAME_MAGIC_SIZE];
+    ssize_t              n;
+    int                  ret;
+
+    n = recv(outSocket->getFd(), start, sizeof(start), MSG_PEEK | MSG_WAITALL);
+    if (n > 0 && isFrameStart(start, n)) {
+        HandleFrames(outSocket);
+        delete outSocket;
+        return NULL;
+    }
+
+    if (readQuery(outSocket, &query) != 0) {
+        fprintf(stderr, "Bad query\n");
+        controlSequence.send(outSocket->getFd());
+        delete outSocket;
+        return NULL;
+    }
+
+    ret = answerQuery(query, &answer);
+    if (ret == 0) {
+        controlSequence.setFormat(DATAFORMAT_JSON);
+        controlSequence.send(outSocket->getFd());
+        if (outSocket->write(answer.data(), answer.size()) < 0) {
+            fprintf(stderr, "Error while writing the Answer Set\n");
+        }
+    } else if (ret > 0) {
+        controlSequence.send(outSocket->getFd());
+    }
+    // otherwise the client sees the connection closed without an answer
+
+    delete outSocket;
+
+    return NULL;
+}
+
+int mwsBrokerLoop(const Config& config)
+{
+    struct sigaction sa;
+    OutSocket* acceptedSock;
+
+    brokerConfig = &config;
+    xmlInitParser();
+    if (ThreadWrapper::init() != 0) {
+        fprintf(stderr, "Error while initializing thread module\n");
+        return EXIT_FAILURE;
+    }
+
+    serverSocket = new InSocket(config.brokerPort);
+    if (serverSocket->enable() != 0) {
+        fprintf(stderr, "Error while listening on port %d\n",
+                config.brokerPort);
+        delete serverSocket;
+        return EXIT_FAILURE;
+    }
+
+    // accept() is interrupted rather than restarted
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = graceful_exit;
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("Forwarding the queries on port %d to %zu %s\n",
+           config.brokerPort, config.shards.size(),
+           (config.partitionTokens > 0) ? "partitions" : "shards");
+    fflush(stdout);
+    while (run) {
+        acceptedSock = serverSocket->accept();
+        if (acceptedSock == NULL) continue;
+        ThreadWrapper::run(HandleConnection, acceptedSock);
+    }
+
+    // waits for the queries in flight, and the shards they wait for
+    ThreadWrapper::clean();
+    for (const Shard& shard : config.shards) delete shard.pool;
+    delete serverSocket;
+    xmlCleanupParser();
+
+    return EXIT_SUCCESS;
+}
+
+} }
@@ -0,0 +1,59 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef _MWS_BROKER_MWSBROKER_HPP
+#define _MWS_BROKER_MWSBROKER_HPP
+
+/**
+  * @file MwsBroker.hpp
+  * @brief Daemon answering the queries of mwsd clients from several shards
+  * @date 19 Oct 2026
+  */
+
+#include <stdint.h>
+#include <vector>
+
+#include "ShardClient.hpp"
+
+namespace mws { namespace broker {
+
+struct Config {
+    /// port the queries are accepted on, as by mwsd
+    uint16_t            brokerPort;
+    /// shards the queries are forwarded to, in the order of their solutions
+    std::vector<Shard>  shards;
+    /// time the shards have to answer before a partial answer set is sent
+    unsigned            shardTimeoutMs;
+    /// if the shards are the partitions of a split index (see
+    /// index::Partition), number of tokens they are chosen by, or 0
+    unsigned            partitionTokens;
+};
+
+/**
+ * @brief Forward the queries accepted on the broker port to the shards
+ * which can answer them (all of them unless they are partitions), and answer them with the merged answer sets of the shards, until SIGINT
+ * or SIGTERM
+ * @return EXIT_SUCCESS or EXIT_FAILURE
+ */
+int mwsBrokerLoop(const Config& config);
+
+} }
+
+#endif  // _MWS_BROKER_MWSBROKER_HPP
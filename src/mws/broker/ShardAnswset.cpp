@@ -0,0 +1,174 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+  * @file ShardAnswset.cpp
+  * @brief Answer sets of the shards of a broker, and how they are merged
+  * @date 19 Oct 2026
+  */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <sstream>
+
+#include "ShardAnswset.hpp"
+#include "mws/types/MwsAnswset.hpp"
+#include "mws/xmlparser/writeBinaryAnswsetToFd.hpp"
+
+using namespace std;
+
+namespace mws { namespace broker {
+
+namespace {
+
+/**
+ * @return position after the JSON array starting at begin, skipping the
+ * brackets within strings, or string::npos if it does not end
+ */
+size_t skipJsonArray(const string& json, size_t begin) {
+    int depth = 0;
+    bool inString = false;
+
+    for (size_t i = begin; i < json.size(); i++) {
+        char c = json[i];
+        if (inString) {
+            if (c == '\\') {
+                i++;
+            } else if (c == '"') {
+                inString = false;
+            }
+        } else if (c == '"') {
+            inString = true;
+        } else if (c == '[') {
+            depth++;
+        } else if (c == ']' && --depth == 0) {
+            return i + 1;
+        }
+    }
+
+    return string::npos;
+}
+
+/// @return position of the value of key, or string::npos if it is missing
+size_t findJsonValue(const string& json, const char* key) {
+    size_t pos = json.find(string("\"") + key + "\":");
+    return (pos != string::npos) ? pos + strlen(key) + 3 : string::npos;
+}
+
+}  // namespace
+
+int readJsonAnswset(const string& json, ShardAnswset* answset) {
+    size_t pos;
+    char* end;
+
+    if ((pos = findJsonValue(json, "total")) == string::npos) return -1;
+    answset->total = strtoul(json.c_str() + pos, &end, 10);
+    if (end == json.c_str() + pos) return -1;
+
+    if ((pos = findJsonValue(json, "qvars")) == string::npos) return -1;
+    size_t qvarsEnd = skipJsonArray(json, pos);
+    if (qvarsEnd == string::npos) return -1;
+    answset->qvars = json.substr(pos, qvarsEnd - pos);
+
+    if ((pos = findJsonValue(json, "data")) == string::npos ||
+            json[pos] != '[') {
+        return -1;
+    }
+    answset->formulaIds.clear();
+    const char* data = json.c_str() + pos + 1;
+    while (*data != ']') {
+        answset->formulaIds.push_back(strtoul(data, &end, 10));
+        if (end == data) return -1;
+        data = end;
+        if (*data == ',') data++;
+    }
+
+    return 0;
+}
+
+int readBinaryAnswset(const string& data, ShardAnswset* answset) {
+    MwsAnswset binaryAnswset;
+
+    if (mws::readBinaryAnswset(data.data(), data.size(),
+                               &binaryAnswset) != 0) {
+        return -1;
+    }
+    answset->total = binaryAnswset.total;
+    answset->formulaIds.clear();
+    answset->formulaIds.reserve(binaryAnswset.answers.size());
+    for (auto answer : binaryAnswset.answers) {
+        answset->formulaIds.push_back(answer->formulaId);
+    }
+
+    // the qvars are merged as written by writeJsonAnswsetToFd()
+    stringstream qvars;
+    qvars << "[";
+    for (size_t i = 0; i < binaryAnswset.qvars.size(); i++) {
+        const Qvar& qvar = binaryAnswset.qvars[i];
+        qvars << (i ? "," : "") << "{\"name\":\"" << qvar.name
+              << "\",\"xpath\":\"" << qvar.xpath << "\"}";
+    }
+    qvars << "]";
+    answset->qvars = qvars.str();
+
+    return 0;
+}
+
+string mergeJsonAnswsets(const vector<ShardAnswset>& answsets,
+                         unsigned offset, unsigned size) {
+    stringstream data, shards, failed;
+    const string* qvars = NULL;
+    uint64_t total = 0;
+    unsigned numReturned = 0;
+
+    for (size_t shard = 0; shard < answsets.size(); shard++) {
+        const ShardAnswset& answset = answsets[shard];
+        if (answset.skipped) continue;
+        if (!answset.answered || !answset.parsed) {
+            failed << (failed.tellp() > 0 ? "," : "") << shard;
+            continue;
+        }
+        if (qvars == NULL) qvars = &answset.qvars;
+
+        // solutions of this shard follow the ones of the previous shards
+        for (size_t i = 0; i < answset.formulaIds.size(); i++) {
+            uint64_t rank = total + i;
+            if (rank < offset || numReturned >= size) continue;
+            data << (numReturned ? "," : "") << answset.formulaIds[i];
+            shards << (numReturned ? "," : "") << shard;
+            numReturned++;
+        }
+        total += answset.total;
+    }
+
+    stringstream ss;
+    ss << "{\"size\":" << numReturned
+       << ",\"total\":" << total
+       << ",\"qvars\":" << ((qvars != NULL) ? *qvars : "[]")
+       << ",\"data\":[" << data.str() << "]"
+       << ",\"shards\":[" << shards.str() << "]"
+       << ",\"partial\":" << (failed.tellp() > 0 ? "true" : "false")
+       << ",\"failed\":[" << failed.str() << "]}";
+
+    return ss.str();
+}
+
+} }
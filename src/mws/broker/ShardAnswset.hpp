@@ -0,0 +1,84 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef _MWS_BROKER_SHARDANSWSET_HPP
+#define _MWS_BROKER_SHARDANSWSET_HPP
+
+/**
+  * @file ShardAnswset.hpp
+  * @brief Answer sets of the shards of a broker, and how they are merged
+  * @date 19 Oct 2026
+  */
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "mws/types/NodeInfo.hpp"
+
+namespace mws { namespace broker {
+
+/// Answer set returned by one shard (see writeBinaryAnswsetToFd())
+struct ShardAnswset {
+    /// true if the query was not sent to the shard, which cannot match it
+    bool                    skipped;
+    /// false if the shard could not be reached or did not answer in time
+    bool                    answered;
+    /// false if the shard could not parse the query
+    bool                    parsed;
+    uint32_t                total;
+    /// JSON array of the query variables
+    std::string             qvars;
+    /// solutions from the first one to the last one requested
+    std::vector<FormulaId>  formulaIds;
+
+    ShardAnswset() : skipped(false), answered(false), parsed(false),
+                     total(0) {}
+};
+
+/**
+ * @brief Read the JSON answer set written by writeJsonAnswsetToFd()
+ * @return 0 on success, -1 if json is not such an answer set
+ */
+int readJsonAnswset(const std::string& json, ShardAnswset* answset);
+
+/**
+ * @brief Read the binary answer set written by writeBinaryAnswsetToFd()
+ * @return 0 on success, -1 if data is not such an answer set
+ */
+int readBinaryAnswset(const std::string& data, ShardAnswset* answset);
+
+/**
+ * @brief Merge the answer sets of the shards into one, as if the solutions
+ * of the shards followed each other in the order of the shards
+ * @param answsets answer sets of the shards, each with its solutions up to
+ * offset + size
+ * @param offset offset where to start returning the solutions
+ * @param size maximum number of solutions to return
+ * @return JSON answer set with the total of all shards, the shard of each
+ * solution ("shards"), and the shards which did not answer ("failed",
+ * with "partial" set if there are any); skipped shards are left out
+ */
+std::string mergeJsonAnswsets(const std::vector<ShardAnswset>& answsets,
+                              unsigned offset, unsigned size);
+
+} }
+
+#endif  // _MWS_BROKER_SHARDANSWSET_HPP
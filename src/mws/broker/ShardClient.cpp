@@ -0,0 +1,189 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+  * @file ShardClient.cpp
+  * @brief Queries sent to all the shards of a broker at once
+  * @date 19 Oct 2026
+  */
+
+#include <errno.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <memory>
+
+#include "ShardClient.hpp"
+#include "common/socket/Frame.hpp"
+#include "common/thread/ThreadWrapper.hpp"
+#include "common/types/DataFormat.hpp"
+#include "common/utils/TimeStamp.hpp"
+#include "common/utils/ToString.hpp"
+
+using namespace std;
+
+namespace mws { namespace broker {
+
+namespace {
+
+/// Query sent to the shards, shared with the threads querying them, which
+/// may outlive queryShards() if their shard times out
+struct ShardQuery {
+    pthread_mutex_t         mutex;
+    pthread_cond_t          answered;
+    string                  query;
+    vector<ShardAnswset>    answsets;
+    vector<bool>            done;
+    size_t                  numPending;
+
+    ShardQuery() : numPending(0) {
+        pthread_mutex_init(&mutex, NULL);
+        pthread_cond_init(&answered, NULL);
+    }
+
+    ~ShardQuery() {
+        pthread_cond_destroy(&answered);
+        pthread_mutex_destroy(&mutex);
+    }
+};
+
+/// Request of a thread querying a shard
+struct ShardRequest {
+    shared_ptr<ShardQuery>  shardQuery;
+    size_t                  shardIndex;
+    ConnectionPool*         pool;
+};
+
+/// Read the answer set sent back by a shard
+void readAnswer(const Frame& answer, ShardAnswset* answset) {
+    answset->answered = true;
+    if (answer.status != FRAME_STATUS_OK) return;
+    if (answer.format == DATAFORMAT_BINARY) {
+        answset->parsed = (readBinaryAnswset(answer.body, answset) == 0);
+    } else {
+        answset->parsed = (readJsonAnswset(answer.body, answset) == 0);
+    }
+}
+
+void* QueryShard(void* requestPtr) {
+    ShardRequest* request = (ShardRequest*) requestPtr;
+    ShardQuery* shardQuery = request->shardQuery.get();
+    ShardAnswset answset;
+    Frame frame, answer;
+
+    frame.type = FRAME_QUERY;
+    frame.body = shardQuery->query;
+    if (request->pool->request(&frame, &answer) == 0) {
+        readAnswer(answer, &answset);
+    }
+
+    pthread_mutex_lock(&shardQuery->mutex);
+    shardQuery->answsets[request->shardIndex] = answset;
+    shardQuery->done[request->shardIndex] = true;
+    if (--shardQuery->numPending == 0) {
+        pthread_cond_signal(&shardQuery->answered);
+    }
+    pthread_mutex_unlock(&shardQuery->mutex);
+    delete request;
+
+    return NULL;
+}
+
+}  // namespace
+
+int openShard(Shard* shard, unsigned timeoutMs) {
+    struct addrinfo hints;
+    struct addrinfo* result;
+    ConnectionPool::Config poolConfig;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(shard->host.c_str(), ToString(shard->port).c_str(),
+                    &hints, &result) != 0) {
+        return -1;
+    }
+    freeaddrinfo(result);
+
+    poolConfig.host = shard->host;
+    poolConfig.port = shard->port;
+    poolConfig.timeoutMs = timeoutMs;
+    shard->pool = new ConnectionPool(poolConfig);
+
+    return 0;
+}
+
+void queryShards(const vector<Shard>& shards,
+                 const string& query,
+                 const vector<bool>& routed,
+                 unsigned timeoutMs,
+                 vector<ShardAnswset>* answsets) {
+    shared_ptr<ShardQuery> shardQuery = make_shared<ShardQuery>();
+    double deadline = MonotonicMs() + timeoutMs;
+    struct timeval now;
+    struct timespec until;
+
+    shardQuery->query = query;
+    shardQuery->answsets.assign(shards.size(), ShardAnswset());
+    shardQuery->done.assign(shards.size(), false);
+    answsets->assign(shards.size(), ShardAnswset());
+
+    pthread_mutex_lock(&shardQuery->mutex);
+    for (size_t i = 0; i < shards.size(); i++) {
+        if (!routed[i]) {
+            (*answsets)[i].skipped = true;
+            continue;
+        }
+        ShardRequest* request = new ShardRequest;
+        request->shardQuery = shardQuery;
+        request->shardIndex = i;
+        request->pool = shards[i].pool;
+        if (ThreadWrapper::run(QueryShard, request) != 0) {
+            delete request;
+            continue;
+        }
+        shardQuery->numPending++;
+    }
+
+    // the condition clock is the real time one
+    gettimeofday(&now, NULL);
+    until.tv_sec = now.tv_sec + timeoutMs / 1000;
+    until.tv_nsec = now.tv_usec * 1000 + (timeoutMs % 1000) * 1000000;
+    if (until.tv_nsec >= 1000000000) {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000;
+    }
+    while (shardQuery->numPending > 0 && MonotonicMs() < deadline) {
+        if (pthread_cond_timedwait(&shardQuery->answered, &shardQuery->mutex,
+                                   &until) == ETIMEDOUT) {
+            break;
+        }
+    }
+
+    // the shards still pending timed out
+    for (size_t i = 0; i < shards.size(); i++) {
+        if (shardQuery->done[i]) (*answsets)[i] = shardQuery->answsets[i];
+    }
+    pthread_mutex_unlock(&shardQuery->mutex);
+}
+
+} }
@@ -0,0 +1,74 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef _MWS_BROKER_SHARDCLIENT_HPP
+#define _MWS_BROKER_SHARDCLIENT_HPP
+
+/**
+  * @file ShardClient.hpp
+  * @brief Queries sent to all the shards of a broker at once
+  * @date 19 Oct 2026
+  */
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "ShardAnswset.hpp"
+#include "common/socket/ConnectionPool.hpp"
+
+namespace mws { namespace broker {
+
+/// mwsd serving a part of the corpus
+struct Shard {
+    std::string             host;
+    uint16_t                port;
+    /// persistent framed connections to the shard (see openShard())
+    ConnectionPool*         pool;
+};
+
+/**
+ * @brief Check that the host of a shard resolves, and create the pool of
+ * connections the queries are sent on
+ * @param timeoutMs time the shard has to answer a query
+ * @return 0 on success, -1 on failure
+ */
+int openShard(Shard* shard, unsigned timeoutMs);
+
+/**
+ * @brief Send a query to the routed shards concurrently and read their
+ * answer sets, until all of them answered or the timeout expires. Each
+ * shard is queried from its own thread, on a connection of its pool.
+ * @param query mws:query document
+ * @param routed shards the query is sent to, the others are skipped
+ * @param timeoutMs time the shards have to answer
+ * @param answsets set to the answer sets of the shards (in the order of
+ * shards), the ones which did not answer in time are not answered
+ */
+void queryShards(const std::vector<Shard>& shards,
+                 const std::string& query,
+                 const std::vector<bool>& routed,
+                 unsigned timeoutMs,
+                 std::vector<ShardAnswset>* answsets);
+
+} }
+
+#endif  // _MWS_BROKER_SHARDCLIENT_HPP
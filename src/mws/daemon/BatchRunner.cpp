@@ -0,0 +1,451 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+  * @file BatchRunner.cpp
+  * @brief Queries of a file answered offline by mwsd --batch
+  * @date 19 Oct 2026
+  */
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "BatchRunner.hpp"
+#include "common/socket/Frame.hpp"
+#include "common/types/DataFormat.hpp"
+#include "common/utils/TimeStamp.hpp"
+#include "common/utils/ToString.hpp"
+
+using namespace std;
+
+namespace mws { namespace daemon {
+
+/// Queries read ahead of the oldest one not written, for each thread
+#define BATCH_WINDOW_PER_THREAD     64
+/// Tag ending the queries of an XML input
+#define QUERY_END_TAG               "</mws:query>"
+
+namespace {
+
+/// Query of the batch, from being read to its answer being written
+struct BatchSlot {
+    string  id;
+    Frame   request;
+    /// answer line, set once answered
+    string  line;
+    bool    answered;
+};
+
+/// State shared by the reader, the workers and the writer
+struct Batch {
+    pthread_mutex_t  mutex;
+    pthread_cond_t   workAvailable;
+    pthread_cond_t   slotDone;
+    pthread_cond_t   spaceAvailable;
+    vector<BatchSlot> slots;
+    /// queries read, answered in order by the workers
+    uint64_t         numRead;
+    uint64_t         numStarted;
+    uint64_t         numWritten;
+    uint64_t         numFailed;
+    bool             endOfInput;
+    bool             writeFailed;
+    FILE*            out;
+};
+
+void appendUtf8(uint32_t codePoint, string* str) {
+    if (codePoint < 0x80) {
+        *str += (char) codePoint;
+    } else if (codePoint < 0x800) {
+        *str += (char) (0xc0 | (codePoint >> 6));
+        *str += (char) (0x80 | (codePoint & 0x3f));
+    } else if (codePoint < 0x10000) {
+        *str += (char) (0xe0 | (codePoint >> 12));
+        *str += (char) (0x80 | ((codePoint >> 6) & 0x3f));
+        *str += (char) (0x80 | (codePoint & 0x3f));
+    } else {
+        *str += (char) (0xf0 | (codePoint >> 18));
+        *str += (char) (0x80 | ((codePoint >> 12) & 0x3f));
+        *str += (char) (0x80 | ((codePoint >> 6) & 0x3f));
+        *str += (char) (0x80 | (codePoint & 0x3f));
+    }
+}
+
+bool readHex4(const string& line, size_t pos, uint32_t* value) {
+    if (pos + 4 > line.size()) return false;
+    *value = 0;
+    for (size_t i = pos; i < pos + 4; i++) {
+        char c = line[i];
+        *value <<= 4;
+        if (c >= '0' && c <= '9') *value |= c - '0';
+        else if (c >= 'a' && c <= 'f') *value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') *value |= c - 'A' + 10;
+        else return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Read the JSON string starting at line[*pos], and move *pos past it
+ * @return 0 on success, -1 if it is not a valid string
+ */
+int readJsonString(const string& line, size_t* pos, string* str) {
+    size_t i = *pos;
+
+    if (i >= line.size() || line[i] != '"') return -1;
+    str->clear();
+    for (i++; i < line.size() && line[i] != '"'; i++) {
+        if (line[i] != '\\') {
+            *str += line[i];
+            continue;
+        }
+        if (++i >= line.size()) return -1;
+        switch (line[i]) {
+        case '"':  *str += '"'; break;
+        case '\\': *str += '\\'; break;
+        case '/':  *str += '/'; break;
+        case 'b':  *str += '\b'; break;
+        case 'f':  *str += '\f'; break;
+        case 'n':  *str += '\n'; break;
+        case 'r':  *str += '\r'; break;
+        case 't':  *str += '\t'; break;
+        case 'u': {
+            uint32_t codePoint, low;
+            if (!readHex4(line, i + 1, &codePoint)) return -1;
+            i += 4;
+            // characters out of the BMP are escaped as surrogate pairs
+            if (codePoint >= 0xd800 && codePoint < 0xdc00 &&
+                    i + 2 < line.size() && line[i + 1] == '\\' &&
+                    line[i + 2] == 'u' && readHex4(line, i + 3, &low) &&
+                    low >= 0xdc00 && low < 0xe000) {
+                codePoint = 0x10000 + ((codePoint - 0xd800) << 10) +
+                            (low - 0xdc00);
+                i += 6;
+            }
+            appendUtf8(codePoint, str);
+            break;
+        }
+        default:
+            return -1;
+        }
+    }
+    if (i >= line.size()) return -1;
+    *pos = i + 1;
+
+    return 0;
+}
+
+/**
+ * @brief Find the value of a member of the JSON object of line
+ * @return position of the value, or string::npos if there is no such member
+ */
+size_t findJsonMember(const string& line, const string& name) {
+    const string quoted = "\"" + name + "\"";
+    size_t pos = 0;
+
+    while ((pos = line.find(quoted, pos)) != string::npos) {
+        pos += quoted.size();
+        while (pos < line.size() && isspace(line[pos])) pos++;
+        if (pos < line.size() && line[pos] == ':') {
+            pos++;
+            while (pos < line.size() && isspace(line[pos])) pos++;
+            return pos;
+        }
+    }
+
+    return string::npos;
+}
+
+/**
+ * @return the raw JSON value starting at line[pos], or empty if it is not a
+ * string, a number, true, false or null (ids are copied to the answers as
+ * they are)
+ */
+string readJsonScalar(const string& line, size_t pos) {
+    size_t end = pos;
+    string str;
+
+    if (line[pos] == '"') {
+        if (readJsonString(line, &end, &str) != 0) return "";
+    } else {
+        while (end < line.size() && line[end] != ',' && line[end] != '}' &&
+               !isspace(line[end])) {
+            end++;
+        }
+        str = line.substr(pos, end - pos);
+        if (str != "true" && str != "false" && str != "null" &&
+                (str.empty() ||
+                 str.find_first_not_of("+-.0123456789eE") != string::npos)) {
+            return "";
+        }
+    }
+
+    return line.substr(pos, end - pos);
+}
+
+/**
+ * @brief Read the next query of the input
+ * @param query set to the query document, empty if it could not be read
+ * or its id is not a JSON scalar
+ * @param id set to the id of the answer line if the query has one
+ * @return false at the end of the input
+ */
+bool readQuery(FILE* in, bool isJsonl, string* query, string* id) {
+    char* buf = NULL;
+    size_t bufSize = 0;
+    ssize_t length;
+    bool found = false;
+
+    query->clear();
+    id->clear();
+    if (isJsonl) {
+        while (!found && (length = getline(&buf, &bufSize, in)) != -1) {
+            string line(buf, length);
+            if (line.find_first_not_of(" \t\r\n") == string::npos) continue;
+            found = true;
+            size_t pos = findJsonMember(line, "query");
+            if (pos == string::npos ||
+                    readJsonString(line, &pos, query) != 0) {
+                query->clear();
+            }
+            pos = findJsonMember(line, "id");
+            if (pos != string::npos) {
+                *id = readJsonScalar(line, pos);
+                if (id->empty()) query->clear();
+            }
+        }
+    } else {
+        while ((length = getline(&buf, &bufSize, in)) != -1) {
+            query->append(buf, length);
+            if (query->find(QUERY_END_TAG) != string::npos) break;
+        }
+        found = (query->find_first_not_of(" \t\r\n") != string::npos);
+    }
+    free(buf);
+
+    return found;
+}
+
+void* answerQueries(void* batchPtr) {
+    Batch* batch = (Batch*) batchPtr;
+    Frame answer;
+
+    pthread_mutex_lock(&batch->mutex);
+    while (true) {
+        while (batch->numStarted == batch->numRead && !batch->endOfInput) {
+            pthread_cond_wait(&batch->workAvailable, &batch->mutex);
+        }
+        if (batch->numStarted == batch->numRead) break;
+        BatchSlot& slot = batch->slots[batch->numStarted %
+                                       batch->slots.size()];
+        batch->numStarted++;
+        pthread_mutex_unlock(&batch->mutex);
+
+        string line = "{\"id\":" + slot.id + ",";
+        bool failed = true;
+        if (slot.request.body.empty()) {
+            line += "\"error\":\"invalid query\"}";
+        } else {
+            answerRequest(slot.request, &answer);
+            if (answer.status != FRAME_STATUS_OK) {
+                line += "\"error\":\"query not answered\"}";
+            } else if (answer.format != DATAFORMAT_JSON) {
+                line += "\"error\":\"output format not supported\"}";
+            } else {
+                line += "\"answset\":" + answer.body + "}";
+                failed = false;
+            }
+        }
+        slot.request.body.clear();
+
+        pthread_mutex_lock(&batch->mutex);
+        slot.line.swap(line);
+        slot.answered = true;
+        if (failed) batch->numFailed++;
+        pthread_cond_signal(&batch->slotDone);
+    }
+    pthread_mutex_unlock(&batch->mutex);
+
+    return NULL;
+}
+
+/// Write the answers in the order of the queries
+void* writeAnswers(void* batchPtr) {
+    Batch* batch = (Batch*) batchPtr;
+    string line;
+
+    pthread_mutex_lock(&batch->mutex);
+    while (true) {
+        BatchSlot& slot = batch->slots[batch->numWritten %
+                                       batch->slots.size()];
+        while (batch->numWritten < batch->numRead && !slot.answered) {
+            pthread_cond_wait(&batch->slotDone, &batch->mutex);
+        }
+        if (batch->numWritten == batch->numRead) {
+            if (batch->endOfInput) break;
+            pthread_cond_wait(&batch->slotDone, &batch->mutex);
+            continue;
+        }
+        line.swap(slot.line);
+        slot.answered = false;
+        pthread_mutex_unlock(&batch->mutex);
+
+        line += '\n';
+        bool failed = (fwrite(line.data(), 1, line.size(), batch->out) !=
+                       line.size());
+
+        pthread_mutex_lock(&batch->mutex);
+        if (failed) batch->writeFailed = true;
+        batch->numWritten++;
+        pthread_cond_signal(&batch->spaceAvailable);
+    }
+    pthread_mutex_unlock(&batch->mutex);
+
+    return NULL;
+}
+
+}  // namespace
+
+int mwsBatchLoop(const Config& config, const BatchConfig& batchConfig) {
+    Batch batch;
+    FILE* in;
+    FILE* out;
+    string query, id;
+    int c;
+
+    in = (batchConfig.inputPath == "-") ? stdin
+                                        : fopen(batchConfig.inputPath.c_str(),
+                                                "r");
+    if (in == NULL) {
+        fprintf(stderr, "Error while opening %s\n",
+                batchConfig.inputPath.c_str());
+        return EXIT_FAILURE;
+    }
+    if (batchConfig.outputPath == "-") {
+        // the messages of mwsd go to stderr, out of the answers' way
+        int fd = dup(STDOUT_FILENO);
+        out = (fd >= 0) ? fdopen(fd, "w") : NULL;
+        if (out != NULL) dup2(STDERR_FILENO, STDOUT_FILENO);
+    } else {
+        out = fopen(batchConfig.outputPath.c_str(), "w");
+    }
+    if (out == NULL) {
+        fprintf(stderr, "Error while opening %s\n",
+                batchConfig.outputPath.c_str());
+        if (in != stdin) fclose(in);
+        return EXIT_FAILURE;
+    }
+
+    if (startEmbeddedMws(config) != 0) {
+        fprintf(stderr, "Error while loading the index\n");
+        if (in != stdin) fclose(in);
+        fclose(out);
+        return EXIT_FAILURE;
+    }
+
+    // JSON lines start with an object, XML queries with a tag
+    while ((c = getc(in)) != EOF && isspace(c)) {}
+    if (c != EOF) ungetc(c, in);
+    bool isJsonl = (c == '{');
+
+    unsigned numThreads = max(batchConfig.threads, 1u);
+    pthread_mutex_init(&batch.mutex, NULL);
+    pthread_cond_init(&batch.workAvailable, NULL);
+    pthread_cond_init(&batch.slotDone, NULL);
+    pthread_cond_init(&batch.spaceAvailable, NULL);
+    batch.slots.resize(numThreads * BATCH_WINDOW_PER_THREAD);
+    for (BatchSlot& slot : batch.slots) slot.answered = false;
+    batch.numRead = batch.numStarted = batch.numWritten = 0;
+    batch.numFailed = 0;
+    batch.endOfInput = batch.writeFailed = false;
+    batch.out = out;
+
+    fprintf(stderr, "Answering %s queries with %u threads\n",
+            isJsonl ? "JSON lines" : "XML", numThreads);
+    double start = MonotonicMs();
+    vector<pthread_t> threads(numThreads + 1);
+    pthread_create(&threads[0], NULL, writeAnswers, &batch);
+    for (unsigned i = 1; i <= numThreads; i++) {
+        pthread_create(&threads[i], NULL, answerQueries, &batch);
+    }
+
+    while (readQuery(in, isJsonl, &query, &id)) {
+        pthread_mutex_lock(&batch.mutex);
+        while (batch.numRead - batch.numWritten == batch.slots.size()) {
+            pthread_cond_wait(&batch.spaceAvailable, &batch.mutex);
+        }
+        BatchSlot& slot = batch.slots[batch.numRead % batch.slots.size()];
+        pthread_mutex_unlock(&batch.mutex);
+
+        // the slot is free until numRead is increased
+        slot.id = id.empty() ? ToString(batch.numRead) : id;
+        slot.request.type = FRAME_QUERY;
+        slot.request.body.swap(query);
+
+        pthread_mutex_lock(&batch.mutex);
+        batch.numRead++;
+        pthread_cond_signal(&batch.workAvailable);
+        pthread_mutex_unlock(&batch.mutex);
+    }
+    bool readFailed = ferror(in);
+
+    pthread_mutex_lock(&batch.mutex);
+    batch.endOfInput = true;
+    pthread_cond_broadcast(&batch.workAvailable);
+    pthread_cond_broadcast(&batch.slotDone);
+    pthread_mutex_unlock(&batch.mutex);
+    for (pthread_t thread : threads) pthread_join(thread, NULL);
+    double elapsed = (MonotonicMs() - start) / 1000;
+
+    bool writeFailed = batch.writeFailed || fflush(out) != 0;
+    fprintf(stderr, "%llu queries (%llu failed) in %.3f s: %.0f queries/s\n",
+            (unsigned long long) batch.numRead,
+            (unsigned long long) batch.numFailed, elapsed,
+            (elapsed > 0) ? batch.numRead / elapsed : 0.0);
+    if (readFailed) {
+        fprintf(stderr, "Error while reading %s\n",
+                batchConfig.inputPath.c_str());
+    }
+    if (writeFailed) {
+        fprintf(stderr, "Error while writing %s\n",
+                batchConfig.outputPath.c_str());
+    }
+
+    pthread_cond_destroy(&batch.spaceAvailable);
+    pthread_cond_destroy(&batch.slotDone);
+    pthread_cond_destroy(&batch.workAvailable);
+    pthread_mutex_destroy(&batch.mutex);
+    if (in != stdin) fclose(in);
+    fclose(out);
+    stopEmbeddedMws();
+
+    return (readFailed || writeFailed) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+} }
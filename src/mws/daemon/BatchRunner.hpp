@@ -0,0 +1,62 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef _MWS_DAEMON_BATCHRUNNER_HPP
+#define _MWS_DAEMON_BATCHRUNNER_HPP
+
+/**
+  * @file BatchRunner.hpp
+  * @brief Queries of a file answered offline by mwsd --batch
+  * @date 19 Oct 2026
+  */
+
+#include <string>
+
+#include "MwsDaemon.hpp"
+
+namespace mws { namespace daemon {
+
+struct BatchConfig {
+    /// queries read, "-" for stdin
+    std::string inputPath;
+    /// answers written, "-" for stdout
+    std::string outputPath;
+    /// threads answering the queries
+    unsigned    threads;
+};
+
+/**
+ * @brief Load the index, answer the queries read from a file, and exit.
+ *
+ * The queries are either mws:query documents, each ending with its
+ * </mws:query> tag, or JSON lines with the query document as "query" and an
+ * optional "id". Each query is answered by a line of JSON, in the order of
+ * the queries: {"id":...,"answset":{...}}, or {"id":...,"error":"..."} if
+ * it could not be answered. The id is the one of the JSON line, or the
+ * number of the query (from 0).
+ *
+ * @return EXIT_SUCCESS if all the queries were read and their answers
+ * written, EXIT_FAILURE otherwise
+ */
+int mwsBatchLoop(const Config& config, const BatchConfig& batchConfig);
+
+}}
+
+#endif // _MWS_DAEMON_BATCHRUNNER_HPP
@@ -0,0 +1,259 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+  * @file IndexSnapshot.cpp
+  * @brief Consistent view of the indexes served by mwsd
+  * @date 19 Oct 2026
+  */
+
+#include <assert.h>
+
+#include <map>
+#include <vector>
+
+#include "IndexSnapshot.hpp"
+#include "mws/dbc/DbQueryManger.hpp"
+#include "mws/index/IndexManager.hpp"
+#include "mws/query/EngineSearchContext.hpp"
+#include "mws/query/SearchContext.hpp"
+#include "mws/xmlparser/loadMwsHarvestFromFd.hpp"
+
+using namespace std;
+using namespace mws::types;
+
+namespace mws { namespace daemon {
+
+/// Snapshot new queries are answered from (only accessed atomically)
+static shared_ptr<IndexSnapshot> currentSnapshot;
+
+IndexSnapshot::IndexSnapshot(MwsIndexNode* base,
+                             shared_ptr<const memsector_handle_t> memsector,
+                             const MeaningDictionary& meaningDictionary,
+                             shared_ptr<index::Tombstones> tombstones,
+                             dbc::CrawlDb* crawlDb,
+                             dbc::FormulaDb* formulaDb,
+                             const index::Partition& partition) :
+    m_base(base), m_memsector(memsector), m_numFrozenDeltas(0),
+    m_numDeltaExpressions(0),
+    m_meaningDictionary(new MeaningDictionary(meaningDictionary)),
+    m_tombstones(tombstones), m_deadHits(tombstones->copyDeadHits()),
+    m_crawlDb(crawlDb), m_formulaDb(formulaDb), m_partition(partition) {
+    assert((base == NULL) != (memsector == NULL));
+    assert(tombstones != NULL);
+}
+
+IndexSnapshot*
+IndexSnapshot::ingest(FILE* file, int* numLoaded) const {
+    MwsIndexNode* delta;
+    IndexSnapshot* snapshot = new IndexSnapshot(*this);
+
+    // ingest into the last delta, unless it is being merged, copying the
+    // nodes it shares with this snapshot on write
+    if (m_deltas.size() > m_numFrozenDeltas) {
+        delta = m_deltas.back()->share();
+        snapshot->m_deltas.back().reset(delta);
+    } else {
+        delta = new MwsIndexNode();
+        snapshot->m_deltas.push_back(shared_ptr<const MwsIndexNode>(delta));
+    }
+
+    index::IndexManager indexManager(m_formulaDb, m_crawlDb, delta,
+                                     m_meaningDictionary.get(),
+                                     m_tombstones.get());
+    indexManager.setPartition(&m_partition);
+    map<FormulaId, vector<FormulaDocId> > loggedFormulae;
+    indexManager.mloggedFormulae = &loggedFormulae;
+
+    pair<int, int> loadReturn = loadMwsHarvestFromFd(&indexManager, file);
+    *numLoaded = loadReturn.second;
+    if (loadReturn.first != 0 && loadReturn.second == 0) {
+        delete snapshot;
+        return NULL;
+    }
+    snapshot->m_numDeltaExpressions += loadReturn.second;
+
+    return snapshot;
+}
+
+IndexSnapshot*
+IndexSnapshot::removeDocuments(const vector<string>& uris,
+                               vector<int>* numHits) const {
+    for (const string& uri : uris) {
+        numHits->push_back(m_tombstones->removeDocument(uri));
+    }
+    IndexSnapshot* snapshot = new IndexSnapshot(*this);
+    snapshot->m_deadHits = m_tombstones->copyDeadHits();
+
+    return snapshot;
+}
+
+IndexSnapshot*
+IndexSnapshot::freeze() const {
+    IndexSnapshot* snapshot = new IndexSnapshot(*this);
+    snapshot->m_numFrozenDeltas = m_deltas.size();
+    snapshot->m_frozenDeadHits = make_shared<const map<FormulaId, uint32_t> >(
+            m_tombstones->getDeadHits());
+
+    return snapshot;
+}
+
+MwsIndexNode*
+IndexSnapshot::mergeIndexes(map<FormulaId, FormulaId>* renamed) const {
+    MwsIndexNode* merged = (m_memsector != NULL) ?
+            MwsIndexNode::importFromMemsector(&m_memsector->index) :
+            m_base->clone();
+
+    for (auto& delta : m_deltas) {
+        merged->merge(delta.get(), renamed);
+    }
+
+    if (m_frozenDeadHits != NULL && !m_frozenDeadHits->empty()) {
+        map<FormulaId, uint32_t> deadHits;
+        for (auto& entry : *m_frozenDeadHits) {
+            auto it = renamed->find(entry.first);
+            FormulaId formulaId = (it != renamed->end()) ? it->second
+                                                         : entry.first;
+            deadHits[formulaId] += entry.second;
+        }
+        (void) merged->removeHits(deadHits);
+    }
+
+    return merged;
+}
+
+IndexSnapshot*
+IndexSnapshot::rebase(shared_ptr<const memsector_handle_t> memsector,
+                      const IndexSnapshot& merged,
+                      const map<FormulaId, FormulaId>& renamed) const {
+    IndexSnapshot* snapshot = new IndexSnapshot(*this);
+    size_t numMerged = merged.m_deltas.size();
+
+    // deltas are only appended while the merged ones are frozen
+    assert(m_numFrozenDeltas >= numMerged);
+    assert(m_deltas.size() >= numMerged);
+    snapshot->m_base = NULL;
+    snapshot->m_memsector = memsector;
+    snapshot->m_deltas.erase(snapshot->m_deltas.begin(),
+                             snapshot->m_deltas.begin() + numMerged);
+    snapshot->m_numFrozenDeltas = m_numFrozenDeltas - numMerged;
+    snapshot->m_numDeltaExpressions -= merged.m_numDeltaExpressions;
+
+    snapshot->m_frozenDeadHits.reset();
+    // the snapshots on the old base keep counting the merged hits as dead
+    snapshot->m_tombstones = make_shared<index::Tombstones>(*m_tombstones);
+    snapshot->m_tombstones->compact(
+            (merged.m_frozenDeadHits != NULL) ? *merged.m_frozenDeadHits
+                                              : map<FormulaId, uint32_t>(),
+            renamed);
+    snapshot->m_deadHits = snapshot->m_tombstones->copyDeadHits();
+
+    return snapshot;
+}
+
+int
+IndexSnapshot::saveDocuments(ostream& out) const {
+    FormulaId maxFormulaId = 0;
+
+    if (m_memsector == NULL) return -1;
+    // formulae of the deltas are not in the memsector
+    for (uint32_t i = 0; i < m_memsector->index.num_leaves; i++) {
+        maxFormulaId = max(maxFormulaId,
+                           (FormulaId) m_memsector->index.leaves[i].dbid);
+    }
+
+    return m_tombstones->save(out, maxFormulaId);
+}
+
+MwsAnswset*
+IndexSnapshot::search(CmmlToken* expression,
+                      unsigned int offset,
+                      unsigned int size,
+                      unsigned int maxTotal) const {
+    MwsAnswset* result;
+    MeaningDictionary* meaningDictionary = m_meaningDictionary.get();
+    dbc::DbQueryManager dbQueryManager(m_crawlDb, m_formulaDb);
+
+    if (m_memsector != NULL) {
+        EngineSearchContext ctxt(expression, meaningDictionary);
+        ctxt.setDeadHits(m_deadHits.get());
+        result = ctxt.getResult(const_cast<index_handle_t*>(
+                                    &m_memsector->index),
+                                offset, size, maxTotal);
+    } else {
+        SearchContext ctxt(expression, meaningDictionary);
+        ctxt.setDeadHits(m_deadHits.get());
+        result = ctxt.getResult(m_base, &dbQueryManager, offset, size,
+                                maxTotal);
+    }
+
+    // the delta solutions follow the base ones
+    for (auto& delta : m_deltas) {
+        unsigned int found = result->total;
+        if (found >= maxTotal) break;
+
+        SearchContext ctxt(expression, meaningDictionary);
+        ctxt.setDeadHits(m_deadHits.get());
+        MwsAnswset* deltaResult =
+                ctxt.getResult(const_cast<MwsIndexNode*>(delta.get()),
+                               &dbQueryManager,
+                               (offset > found) ? offset - found : 0,
+                               size - result->answers.size(),
+                               maxTotal - found);
+
+        result->answers.insert(result->answers.end(),
+                               deltaResult->answers.begin(),
+                               deltaResult->answers.end());
+        result->total += deltaResult->total;
+        deltaResult->answers.clear();
+        delete deltaResult;
+    }
+
+    return result;
+}
+
+MwsAnswset*
+IndexSnapshot::search(const EncodedQuery& query) const {
+    // the other indexes are searched from CmmlTokens
+    if (m_memsector == NULL || !m_deltas.empty()) {
+        CmmlToken* expression = query.toCmmlToken();
+        MwsAnswset* result = search(expression, query.offset, query.size,
+                                    query.maxTotal);
+        delete expression;
+        return result;
+    }
+
+    EngineSearchContext ctxt(query, m_meaningDictionary.get());
+    ctxt.setDeadHits(m_deadHits.get());
+    return ctxt.getResult(const_cast<index_handle_t*>(&m_memsector->index),
+                          query.offset, query.size, query.maxTotal);
+}
+
+shared_ptr<IndexSnapshot>
+IndexSnapshot::current() {
+    return atomic_load(&currentSnapshot);
+}
+
+void
+IndexSnapshot::publish(shared_ptr<IndexSnapshot> snapshot) {
+    atomic_store(&currentSnapshot, snapshot);
+}
+
+} }
@@ -0,0 +1,202 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef _MWS_DAEMON_INDEXSNAPSHOT_HPP
+#define _MWS_DAEMON_INDEXSNAPSHOT_HPP
+
+/**
+  * @file IndexSnapshot.hpp
+  * @brief Consistent view of the indexes served by mwsd
+  * @date 19 Oct 2026
+  */
+
+#include <stdio.h>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "mws/dbc/CrawlDb.hpp"
+#include "mws/dbc/FormulaDb.hpp"
+#include "mws/index/MwsIndexNode.hpp"
+#include "mws/index/Partition.hpp"
+#include "mws/index/Tombstones.hpp"
+#include "mws/index/memsector.h"
+#include "mws/query/EncodedQuery.hpp"
+#include "mws/types/CmmlToken.hpp"
+#include "mws/types/MeaningDictionary.hpp"
+#include "mws/types/MwsAnswset.hpp"
+
+namespace mws { namespace daemon {
+
+/**
+ * @brief Base index of mwsd and the delta indexes of the harvests ingested
+ * while serving.
+ *
+ * Snapshots are immutable once published: ingesting a harvest shares the
+ * last delta index with a new snapshot, copying only the nodes on the paths
+ * to the ingested formulae (see MwsIndexNode::share()), and the new
+ * snapshot is then swapped in atomically (see publish()). The meanings are
+ * shared by all the snapshots: their ids never change, and the meanings an
+ * older snapshot does not know simply match nothing in its indexes. Queries hold a reference to
+ * the snapshot they started with, which is freed when its last query
+ * finishes, together with the indexes no other snapshot uses.
+ *
+ * The deltas are folded into a new memsector base in the background: the
+ * deltas being merged are frozen (see freeze()), such that harvests
+ * ingested meanwhile go to a new delta, and the snapshot is rebased on the
+ * new memsector once it is written (see rebase()).
+ *
+ * Deleted documents are tombstoned in the documents shared by the
+ * snapshots, and a new snapshot is published with a copy of the hits they
+ * took out, which queries read without locking (see removeDocuments()).
+ * Their formulae are dropped from the index by the next merge.
+ */
+class IndexSnapshot {
+    /// base index, either in memory (not owned) or a memsector
+    MwsIndexNode*                                   m_base;
+    std::shared_ptr<const memsector_handle_t>       m_memsector;
+    /// formulae ingested after the base was built, oldest first
+    std::vector<std::shared_ptr<const MwsIndexNode> > m_deltas;
+    /// number of deltas being merged, which are not ingested into
+    size_t                                          m_numFrozenDeltas;
+    uint32_t                                        m_numDeltaExpressions;
+    /// meanings of the base and the deltas, shared with the next snapshots
+    std::shared_ptr<types::MeaningDictionary>       m_meaningDictionary;
+    /// documents of the base and the deltas, shared with the next snapshots
+    std::shared_ptr<index::Tombstones>              m_tombstones;
+    /// hits of the documents deleted when this snapshot was made
+    std::shared_ptr<const index::DeadHits>          m_deadHits;
+    /// hits deleted when the deltas were frozen, removed by mergeIndexes()
+    std::shared_ptr<const std::map<FormulaId, uint32_t> > m_frozenDeadHits;
+    dbc::CrawlDb*                                   m_crawlDb;
+    dbc::FormulaDb*                                 m_formulaDb;
+    /// part of the index ingested by this mwsd
+    index::Partition                                m_partition;
+
+public:
+    /**
+     * @param base in-memory base index or NULL if memsector is given
+     * @param memsector memsector base index or NULL if base is given
+     * @param meaningDictionary meanings of the base index (copied)
+     * @param tombstones documents of the base index
+     * @param partition part of the harvests which is ingested
+     */
+    IndexSnapshot(MwsIndexNode* base,
+                  std::shared_ptr<const memsector_handle_t> memsector,
+                  const types::MeaningDictionary& meaningDictionary,
+                  std::shared_ptr<index::Tombstones> tombstones,
+                  dbc::CrawlDb* crawlDb,
+                  dbc::FormulaDb* formulaDb,
+                  const index::Partition& partition = index::Partition());
+
+    /**
+     * @brief Copy this snapshot, adding the harvest read from file to the
+     * last delta index
+     * @param file harvest to ingest (closed)
+     * @param numLoaded set to the number of expressions loaded
+     * @return new snapshot or NULL if the harvest could not be parsed
+     */
+    IndexSnapshot* ingest(FILE* file, int* numLoaded) const;
+
+    /**
+     * @brief Delete documents from the documents shared with the other
+     * snapshots (callers serialize it with ingest() and rebase())
+     * @param numHits set to the number of hits deleted for each uri, or -1
+     * if the document is unknown or already deleted
+     * @return copy of this snapshot, without the hits of the documents
+     */
+    IndexSnapshot* removeDocuments(const std::vector<std::string>& uris,
+                                   std::vector<int>* numHits) const;
+
+    /**
+     * @return copy of this snapshot whose deltas are all frozen, to be
+     * merged by mergeIndexes()
+     */
+    IndexSnapshot* freeze() const;
+
+    /**
+     * @param renamed set to the id the formulae of the deltas already in
+     * the base (or an older delta) are merged into
+     * @return base index merged with the delta indexes, without the hits
+     * deleted when the deltas were frozen, to be deleted by the caller
+     */
+    MwsIndexNode* mergeIndexes(std::map<FormulaId, FormulaId>* renamed) const;
+
+    /**
+     * @brief Copy this snapshot, replacing the base and the deltas merged
+     * into memsector
+     * @param merged frozen snapshot this one (or one of its ancestors) was
+     * ingested from
+     * @param renamed formulae renamed by merged.mergeIndexes()
+     */
+    IndexSnapshot* rebase(std::shared_ptr<const memsector_handle_t> memsector,
+                          const IndexSnapshot& merged,
+                          const std::map<FormulaId, FormulaId>& renamed) const;
+
+    /**
+     * @brief Save the documents of the base memsector, to be loaded with it
+     * @return 0 on success, -1 on failure
+     */
+    int saveDocuments(std::ostream& out) const;
+
+    /**
+     * @brief Search the base index, then the delta indexes
+     * @param offset offset where to start returning the solutions
+     * @param size maximum number of solutions to return
+     * @param maxTotal maximum number of solutions to count
+     * @return an answer set with the solutions of all indexes
+     */
+    MwsAnswset* search(types::CmmlToken* expression,
+                       unsigned int offset,
+                       unsigned int size,
+                       unsigned int maxTotal) const;
+
+    /**
+     * @brief Answer an encoded query, straight from its tokens if only the
+     * memsector is to be searched
+     */
+    MwsAnswset* search(const EncodedQuery& query) const;
+
+    /// @return number of expressions ingested into the delta indexes
+    uint32_t getNumDeltaExpressions() const {
+        return m_numDeltaExpressions;
+    }
+
+    /// @return meanings of the base and the deltas
+    const types::MeaningDictionary& getMeaningDictionary() const {
+        return *m_meaningDictionary;
+    }
+
+    /// @return snapshot new queries are answered from
+    static std::shared_ptr<IndexSnapshot> current();
+
+    /// @brief make snapshot the one new queries are answered from
+    static void publish(std::shared_ptr<IndexSnapshot> snapshot);
+
+private:
+    IndexSnapshot(const IndexSnapshot&) = default;
+    IndexSnapshot& operator=(const IndexSnapshot&);
+};
+
+} }
+
+#endif  // _MWS_DAEMON_INDEXSNAPSHOT_HPP
@@ -35,6 +35,8 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 
 // System includes
 
+#include <errno.h>
+#include <poll.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -42,30 +44,49 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 #include <sys/stat.h>           // POSIX File characteristics
 #include <fcntl.h>              // File control operations
 #include <signal.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
 #include <stdlib.h>
+#include <inttypes.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
 #include <stack>
+#include <fstream>
+#include <map>
 
 // Local includes
 
 #include "MwsDaemon.hpp"
+#include "IndexSnapshot.hpp"
+#include "common/socket/Frame.hpp"
 #include "common/socket/InSocket.hpp"
 #include "common/socket/OutSocket.hpp"
 #include "mws/dbc/NullCrawlDb.hpp"
 #include "mws/dbc/NullFormulaDb.hpp"
 #include "mws/xmlparser/loadMwsHarvestFromFd.hpp"
 #include "mws/xmlparser/readMwsQueryFromFd.hpp"
+#include "mws/xmlparser/readMwsDeleteFromFd.hpp"
 #include "mws/xmlparser/initxmlparser.hpp"
 #include "mws/xmlparser/clearxmlparser.hpp"
+#include "mws/xmlparser/writeBinaryAnswsetToFd.hpp"
 #include "mws/xmlparser/writeJsonAnswsetToFd.hpp"
 #include "mws/index/MwsIndexNode.hpp"
+#include "mws/query/EncodedQuery.hpp"
 #include "mws/query/SearchContext.hpp"
+#include "mws/index/memsector.h"
 #include "common/types/ControlSequence.hpp"
 #include "common/thread/ThreadWrapper.hpp"
 #include "common/utils/DebugMacros.hpp"   // MWS Debug Macro Utilities
 #include "common/utils/Path.hpp"
 #include "common/utils/TimeStamp.hpp"     // MWS TimeStamp utility function
+#include "common/utils/ToString.hpp"
+#include "common/utils/macro_func.h"
+#include "common/utils/util.hpp"
 #include "mws/dbc/DbQueryManger.hpp"
 #include "mws/index/IndexManager.hpp"
+#include "mws/index/Tombstones.hpp"
 
 using namespace std;
 using namespace mws;
@@ -73,9 +94,46 @@ using namespace mws::types;
 
 static MwsIndexNode* data;
 static InSocket* serverSocket;
-static sig_atomic_t run = 1;
+/// Listens on the Unix domain socket, if any
+static InSocket* unixServerSocket;
+static volatile sig_atomic_t run = 1;
+/// Memsector loaded at startup, until the first snapshot takes it over
+static shared_ptr<const memsector_handle_t> memsector;
+/// Documents of the index loaded at startup, until the first snapshot takes
+/// them over
+static shared_ptr<index::Tombstones> tombstones;
+/// Memsector whose documents are saved at exit (empty if none)
+static string documentsMemsectorPath;
+static volatile sig_atomic_t stopReadahead = 0;
+static volatile sig_atomic_t stopMerge = 0;
+/// Serializes the harvests ingested while serving
+static pthread_mutex_t ingestMutex = PTHREAD_MUTEX_INITIALIZER;
+/// Serializes the replacements of the base index (merges and reloads)
+static pthread_mutex_t baseMutex = PTHREAD_MUTEX_INITIALIZER;
+/// SIGHUP writes to this pipe to wake up the reload thread
+static int reloadPipe[2] = { -1, -1 };
 const string HarvestType = "mws:harvest";
 const string QueryType = "mws:query";
+const string DeleteType = "mws:delete";
+/// The meaning dictionary of a memsector is saved next to it
+const string MeaningDictionarySuffix = ".meanings";
+/// So are its documents, with the ones deleted since it was built
+const string DocumentsSuffix = ".documents";
+/// Idle framed connections check this often whether mwsd is exiting
+const int FRAME_IDLE_POLL_MS = 500;
+/// Requests of a framed connection answered at once, beyond which no more
+/// frames are read from it
+const unsigned FRAME_MAX_PENDING = 64;
+/// Bytes of the requests of a framed connection answered at once, beyond
+/// which no more frames are read from it
+const size_t FRAME_MAX_PENDING_BYTES = 64 << 20;
+/// Seconds an answer may wait for the client to read it, after which the
+/// framed connection is closed
+const int FRAME_SEND_TIMEOUT_S = 30;
+/// Start of this mwsd, such that generations are not reused by the next one
+static const time_t startTime = time(NULL);
+/// Changes to the index contents since the start (see FRAME_GENERATION)
+static atomic<uint32_t> indexGeneration(0);
 
 dbc::CrawlDb* crawlDb;
 dbc::FormulaDb* formulaDb;
@@ -85,16 +143,473 @@ index::IndexManager* indexManager;
 
 namespace mws { namespace daemon {
 
+/// Copy of the config the reload and merge threads run with, which outlives
+/// the caller's (the threads only stop in cleanupMws(), at exit)
+static Config threadConfig;
+
+/**
+ * @brief Stop accepting connections, such that the daemon loop returns and
+ * the queries in flight are answered before exiting (see cleanupMws())
+ */
 static void
 graceful_exit(int signum)
 {
-    switch (signum)
-    {
-        case SIGINT:
-            exit(EXIT_SUCCESS);
-        case SIGTERM:
-            exit(EXIT_SUCCESS);
+    UNUSED(signum);
+    run = 0;
+    serverSocket->shutdown();
+    if (unixServerSocket != NULL) unixServerSocket->shutdown();
+}
+
+static void
+request_reload(int signum)
+{
+    char request = 1;
+
+    UNUSED(signum);
+    if (write(reloadPipe[1], &request, 1) < 0) {
+        // a reload is already pending
+    }
+}
+
+/// Documents mwsd is sent
+enum DocumentType {
+    DOCUMENT_QUERY,
+    DOCUMENT_HARVEST,
+    DOCUMENT_DELETE
+};
+
+/**
+ * @brief Peek at the beginning of the document sent on fd to tell harvests
+ * and deletions from queries, without consuming it.
+ * @return type of the document (DOCUMENT_QUERY if unknown)
+ */
+static DocumentType
+peekDocumentType(int fd)
+{
+    const size_t maxPeek = 4096;
+    const pair<string, DocumentType> roots[] = {
+        make_pair("<" + QueryType, DOCUMENT_QUERY),
+        make_pair("<" + HarvestType, DOCUMENT_HARVEST),
+        make_pair("<" + DeleteType, DOCUMENT_DELETE)
+    };
+    char buf[maxPeek + 1];
+    size_t peek = 64;
+
+    while (true) {
+        ssize_t n = recv(fd, buf, peek, MSG_PEEK | MSG_WAITALL);
+        if (n <= 0) return DOCUMENT_QUERY;
+        buf[n] = '\0';
+
+        const char* first = NULL;
+        DocumentType type = DOCUMENT_QUERY;
+        for (auto& root : roots) {
+            const char* found = strstr(buf, root.first.c_str());
+            if (found != NULL && (first == NULL || found < first)) {
+                first = found;
+                type = root.second;
+            }
+        }
+        if (first != NULL) return type;
+        // the whole document was peeked or the root is too far
+        if ((size_t) n < peek || peek == maxPeek) return DOCUMENT_QUERY;
+        peek = min(2 * peek, maxPeek);
+    }
+}
+
+/**
+ * @brief Ingest the harvest read from file into a new snapshot of the index,
+ * while the queries already running keep their snapshot.
+ * @return 0 on success, -1 on failure
+ */
+static int
+ingestHarvest(FILE* file)
+{
+    int             numLoaded = 0;
+    double          start;
+
+    pthread_mutex_lock(&ingestMutex);
+    start = MonotonicMs();
+    shared_ptr<IndexSnapshot> snapshot(
+            IndexSnapshot::current()->ingest(file, &numLoaded));
+    if (snapshot) {
+        IndexSnapshot::publish(snapshot);
+        indexGeneration++;
+        printf("%d expressions ingested in %.0f ms "
+               "(%" PRIu32 " since the index was built)\n",
+               numLoaded, MonotonicMs() - start,
+               snapshot->getNumDeltaExpressions());
+    } else {
+        fprintf(stderr, "Error while ingesting the harvest\n");
     }
+    fflush(stdout);
+    pthread_mutex_unlock(&ingestMutex);
+
+    return snapshot ? 0 : -1;
+}
+
+static void
+IngestHarvest(OutSocket* outSocket)
+{
+    ControlSequence controlSequence;
+    int             fd;
+    FILE*           file;
+
+    fd = dup(outSocket->getFd());
+    if (fd < 0 || (file = fdopen(fd, "r")) == NULL) {
+        fprintf(stderr, "Error while reading the harvest\n");
+        if (fd >= 0) (void) close(fd);
+        controlSequence.send(outSocket->getFd());
+        return;
+    }
+
+    (void) ingestHarvest(file);
+    controlSequence.send(outSocket->getFd());
+}
+
+/**
+ * @brief Delete documents from the index. Their formulae stop matching
+ * for the queries started from now on, and are dropped by the next merge.
+ */
+static void
+deleteDocuments(const vector<string>& urls)
+{
+    int             numDeleted = 0;
+    int             numHits = 0;
+    double          start;
+    vector<string>  uris;
+    vector<int>     deleted;
+
+    for (const string& url : urls) {
+        uris.push_back(url.substr(0, url.find('#')));
+    }
+    pthread_mutex_lock(&ingestMutex);
+    start = MonotonicMs();
+    shared_ptr<IndexSnapshot> snapshot(
+            IndexSnapshot::current()->removeDocuments(uris, &deleted));
+    for (size_t i = 0; i < urls.size(); i++) {
+        if (deleted[i] < 0) {
+            fprintf(stderr, "Document %s not found or already deleted\n",
+                    urls[i].c_str());
+        } else {
+            numDeleted++;
+            numHits += deleted[i];
+        }
+    }
+    if (numDeleted > 0) {
+        IndexSnapshot::publish(snapshot);
+        indexGeneration++;
+    }
+    printf("%d documents deleted in %.3f ms (%d formula hits)\n",
+           numDeleted, MonotonicMs() - start, numHits);
+    fflush(stdout);
+    pthread_mutex_unlock(&ingestMutex);
+}
+
+static void
+DeleteDocuments(OutSocket* outSocket)
+{
+    ControlSequence controlSequence;
+    vector<string>  urls;
+
+    if (readMwsDeleteFromFd(outSocket->getFd(), &urls) != 0) {
+        fprintf(stderr, "Error while reading the deleted documents\n");
+        controlSequence.send(outSocket->getFd());
+        return;
+    }
+
+    deleteDocuments(urls);
+    controlSequence.send(outSocket->getFd());
+}
+
+/**
+ * @brief Answer a query from the current snapshot of the index
+ * @return the answer set, or NULL if the query has no expression
+ */
+static MwsAnswset*
+answerQuery(MwsQuery* mwsQuery)
+{
+    if (mwsQuery == NULL || mwsQuery->tokens.empty()) return NULL;
+#ifdef _APPLYRESTRICT
+    mwsQuery->applyRestrictions();
+#endif
+    // the snapshot stays alive until the query is answered
+    shared_ptr<IndexSnapshot> snapshot = IndexSnapshot::current();
+
+    return snapshot->search(mwsQuery->tokens[0],
+                            mwsQuery->attrResultLimitMin,
+                            mwsQuery->attrResultMaxSize,
+                            mwsQuery->attrResultTotalReqNr);
+}
+
+/**
+ * @brief Answer an encoded query from the current snapshot of the index
+ * @return the answer set
+ */
+static MwsAnswset*
+answerEncodedQuery(EncodedQuery* query)
+{
+#ifdef _APPLYRESTRICT
+    query->size = min<uint32_t>(query->size, _MAX_QUERY_RESULTSIZE);
+    query->offset = min<uint32_t>(query->offset, _MAX_QUERY_OFFSET);
+    query->maxTotal = min<uint32_t>(query->maxTotal, _MAX_QUERY_TOTALREQNR);
+#endif
+    shared_ptr<IndexSnapshot> snapshot = IndexSnapshot::current();
+
+    return snapshot->search(*query);
+}
+
+/**
+ * @brief Answer each expression of a query from the same snapshot of the
+ * index, the ones repeated in the batch only once
+ * @param results set to the answer set of each expression
+ * @param distinct set to the answer sets to delete, which the repeated
+ * expressions share
+ * @return 0 on success, -1 if the query has no expression
+ */
+static int
+answerBatchQuery(MwsQuery* mwsQuery, vector<const MwsAnswset*>* results,
+                 vector<MwsAnswset*>* distinct)
+{
+    map<string, const MwsAnswset*> answered;
+    EncodedQuery query;
+
+    if (mwsQuery == NULL || mwsQuery->tokens.empty()) return -1;
+#ifdef _APPLYRESTRICT
+    mwsQuery->applyRestrictions();
+#endif
+    query.offset = mwsQuery->attrResultLimitMin;
+    query.size = mwsQuery->attrResultMaxSize;
+    query.maxTotal = mwsQuery->attrResultTotalReqNr;
+    shared_ptr<IndexSnapshot> snapshot = IndexSnapshot::current();
+
+    for (CmmlToken* expression : mwsQuery->tokens) {
+        // the tokens are searched as they are, and tell repeated ones
+        query.setExpression(expression);
+        string key = writeEncodedQuery(query);
+        map<string, const MwsAnswset*>::iterator it = answered.find(key);
+        if (it == answered.end()) {
+            MwsAnswset* result = snapshot->search(query);
+            distinct->push_back(result);
+            it = answered.insert(make_pair(key, result)).first;
+        }
+        results->push_back(it->second);
+    }
+
+    return 0;
+}
+
+/// Set the body of answer to result, in the format asked for
+static void
+setAnswerBody(const MwsAnswset* result, DataFormat format, Frame* answer)
+{
+    if (format == DATAFORMAT_BINARY) {
+        answer->format = DATAFORMAT_BINARY;
+        answer->body = writeBinaryAnswsetToString(result);
+    } else {
+        answer->format = DATAFORMAT_JSON;
+        answer->body = writeJsonAnswsetToString(result);
+    }
+}
+
+/// Connection speaking the framed protocol
+struct FrameConnection {
+    OutSocket*      outSocket;
+    /// answers are written whole, by the threads answering the requests
+    pthread_mutex_t writeMutex;
+    pthread_mutex_t pendingMutex;
+    pthread_cond_t  pendingDone;
+    unsigned        numPending;
+    size_t          pendingBytes;
+    /// set once an answer could not be written (under writeMutex)
+    bool            broken;
+};
+
+/// Request read from a FrameConnection
+struct FrameRequest {
+    FrameConnection* connection;
+    Frame            frame;
+};
+
+void
+answerRequest(const Frame& frame, Frame* answer)
+{
+    int ret = -1;
+
+    answer->type = frame.type;
+    answer->requestId = frame.requestId;
+    answer->body.clear();
+    switch (frame.type) {
+    case FRAME_QUERY: {
+        MwsQuery* mwsQuery = readMwsQueryFromMemory(frame.body.data(),
+                                                    frame.body.size());
+        MwsAnswset* result = answerQuery(mwsQuery);
+        if (result != NULL) {
+            setAnswerBody(result, mwsQuery->attrResultOutputFormat, answer);
+            ret = 0;
+        }
+        delete result;
+        delete mwsQuery;
+        break;
+    }
+    case FRAME_ENCODED_QUERY: {
+        EncodedQuery query;
+        if (readEncodedQuery(frame.body.data(), frame.body.size(),
+                             &query) == 0) {
+            MwsAnswset* result = answerEncodedQuery(&query);
+            setAnswerBody(result, query.outputFormat, answer);
+            delete result;
+            ret = 0;
+        }
+        break;
+    }
+    case FRAME_BATCH_QUERY: {
+        MwsQuery* mwsQuery = readMwsQueryFromMemory(frame.body.data(),
+                                                    frame.body.size());
+        vector<const MwsAnswset*> results;
+        vector<MwsAnswset*> distinct;
+        if (answerBatchQuery(mwsQuery, &results, &distinct) == 0) {
+            if (mwsQuery->attrResultOutputFormat == DATAFORMAT_BINARY) {
+                answer->format = DATAFORMAT_BINARY;
+                answer->body = writeBinaryAnswsetsToString(results);
+            } else {
+                answer->format = DATAFORMAT_JSON;
+                answer->body = writeJsonAnswsetsToString(results);
+            }
+            ret = 0;
+        }
+        for (MwsAnswset* result : distinct) delete result;
+        delete mwsQuery;
+        break;
+    }
+    case FRAME_HARVEST: {
+        FILE* file = fmemopen((void*) frame.body.data(), frame.body.size(),
+                              "r");
+        if (file != NULL) ret = ingestHarvest(file);
+        break;
+    }
+    case FRAME_DELETE: {
+        vector<string> urls;
+        ret = readMwsDeleteFromMemory(frame.body.data(), frame.body.size(),
+                                      &urls);
+        if (ret == 0) deleteDocuments(urls);
+        break;
+    }
+    case FRAME_GENERATION:
+        answer->body = ToString(startTime) + "." +
+                       ToString(indexGeneration.load());
+        ret = 0;
+        break;
+    default:
+        fprintf(stderr, "Unknown frame type %d\n", frame.type);
+        break;
+    }
+    answer->status = (ret == 0) ? FRAME_STATUS_OK : FRAME_STATUS_ERROR;
+}
+
+/**
+ * @brief Carry out a framed request, and send its answer with the same
+ * request id
+ */
+static void*
+AnswerFrame(void* dataPtr)
+{
+    FrameRequest*    request = (FrameRequest*) dataPtr;
+    FrameConnection* connection = request->connection;
+    const Frame&     frame = request->frame;
+    const size_t     size = frame.body.size();
+    Frame            answer;
+
+    answerRequest(frame, &answer);
+
+    pthread_mutex_lock(&connection->writeMutex);
+    if (!connection->broken &&
+            writeFrame(connection->outSocket->getFd(), answer) != 0) {
+        fprintf(stderr, "Error while writing the answer of request %u\n",
+                frame.requestId);
+        // the other answers are not written to a client which does not
+        // read them, and the connection is closed
+        connection->broken = true;
+        (void) shutdown(connection->outSocket->getFd(), SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&connection->writeMutex);
+
+    delete request;
+    pthread_mutex_lock(&connection->pendingMutex);
+    connection->numPending--;
+    connection->pendingBytes -= size;
+    pthread_cond_signal(&connection->pendingDone);
+    pthread_mutex_unlock(&connection->pendingMutex);
+
+    return NULL;
+}
+
+/**
+ * @brief Read the requests framed on a connection until the client closes
+ * it or mwsd exits. Each request is answered in its own thread, so the
+ * answers come back as soon as they are ready rather than in order. At most
+ * FRAME_MAX_PENDING requests (or FRAME_MAX_PENDING_BYTES) are answered at
+ * once: the next frames wait in the socket, such that the client is held
+ * back by TCP. Answers the client does not read within FRAME_SEND_TIMEOUT_S
+ * close the connection.
+ */
+static void
+HandleFrames(OutSocket* outSocket)
+{
+    FrameConnection connection;
+    struct pollfd   pollFd;
+    int             ret;
+
+    connection.outSocket = outSocket;
+    connection.numPending = 0;
+    connection.pendingBytes = 0;
+    connection.broken = false;
+    pthread_mutex_init(&connection.writeMutex, NULL);
+    pthread_mutex_init(&connection.pendingMutex, NULL);
+    pthread_cond_init(&connection.pendingDone, NULL);
+
+    struct timeval sendTimeout = { FRAME_SEND_TIMEOUT_S, 0 };
+    (void) setsockopt(outSocket->getFd(), SOL_SOCKET, SO_SNDTIMEO,
+                      &sendTimeout, sizeof(sendTimeout));
+
+    pollFd.fd = outSocket->getFd();
+    pollFd.events = POLLIN;
+    while (run) {
+        pthread_mutex_lock(&connection.pendingMutex);
+        while (connection.numPending >= FRAME_MAX_PENDING ||
+               connection.pendingBytes >= FRAME_MAX_PENDING_BYTES) {
+            pthread_cond_wait(&connection.pendingDone,
+                              &connection.pendingMutex);
+        }
+        pthread_mutex_unlock(&connection.pendingMutex);
+
+        // idle connections do not hold up exiting
+        ret = poll(&pollFd, 1, FRAME_IDLE_POLL_MS);
+        if (ret < 0 && errno != EINTR) break;
+        if (ret <= 0) continue;
+
+        FrameRequest* request = new FrameRequest;
+        request->connection = &connection;
+        if (readFrame(outSocket->getFd(), &request->frame) != 1) {
+            delete request;
+            break;
+        }
+        pthread_mutex_lock(&connection.pendingMutex);
+        connection.numPending++;
+        connection.pendingBytes += request->frame.body.size();
+        pthread_mutex_unlock(&connection.pendingMutex);
+        if (ThreadWrapper::run(AnswerFrame, request) != 0) {
+            (void) AnswerFrame(request);
+        }
+    }
+
+    pthread_mutex_lock(&connection.pendingMutex);
+    while (connection.numPending > 0) {
+        pthread_cond_wait(&connection.pendingDone, &connection.pendingMutex);
+    }
+    pthread_mutex_unlock(&connection.pendingMutex);
+    pthread_cond_destroy(&connection.pendingDone);
+    pthread_mutex_destroy(&connection.pendingMutex);
+    pthread_mutex_destroy(&connection.writeMutex);
 }
 
 static void*
@@ -104,7 +619,6 @@ HandleConnection(void* dataPtr)
     MwsAnswset*       result;
     OutSocket*        outSocket;
     SocketInfo        sockInfo;
-    SearchContext*    ctxt;
     int               ret;
     ControlSequence   controlSequence;
     int               fd;
@@ -119,33 +633,48 @@ HandleConnection(void* dataPtr)
             sockInfo.service.c_str());
     fflush(stdout);
 
-    // Reading the MwsQuery
     fd = outSocket->getFd();
-    mwsQuery = readMwsQueryFromFd(fd);
-
-    if (mwsQuery && mwsQuery->tokens.size())
-    {
-#ifdef _APPLYRESTRICT
-        mwsQuery->applyRestrictions();
-#endif
-        dbc::DbQueryManager dbQueryManger(crawlDb, formulaDb);
-        ctxt   = new SearchContext(mwsQuery->tokens[0], meaningDictionary);
+    // clients of the framed protocol start with a frame, the others with
+    // an XML document
+    char start[FRAME_MAGIC_SIZE];
+    ssize_t n = recv(fd, start, sizeof(start), MSG_PEEK | MSG_WAITALL);
+    if (n > 0 && isFrameStart(start, n)) {
+        HandleFrames(outSocket);
+        delete outSocket;
+        return NULL;
+    }
 
-        result = ctxt->getResult(data,
-                                 &dbQueryManger,
-                                 mwsQuery->attrResultLimitMin,
-                                 mwsQuery->attrResultMaxSize,
-                                 mwsQuery->attrResultTotalReqNr);
+    switch (peekDocumentType(fd)) {
+    case DOCUMENT_HARVEST:
+        IngestHarvest(outSocket);
+        delete outSocket;
+        return NULL;
+    case DOCUMENT_DELETE:
+        DeleteDocuments(outSocket);
+        delete outSocket;
+        return NULL;
+    default:
+        break;
+    }
 
-        delete ctxt;
+    // Reading the MwsQuery
+    mwsQuery = readMwsQueryFromFd(fd);
 
+    if ((result = answerQuery(mwsQuery)) != NULL)
+    {
         // Sending the control sequence
-        controlSequence.setFormat(DATAFORMAT_JSON);
+        controlSequence.setFormat(
+                (mwsQuery->attrResultOutputFormat == DATAFORMAT_BINARY) ?
+                DATAFORMAT_BINARY : DATAFORMAT_JSON);
         controlSequence.send(outSocket->getFd());
 
         // Sending the answer with the proper format
         switch (mwsQuery->attrResultOutputFormat)
         {
+            case DATAFORMAT_BINARY:
+                ret = writeBinaryAnswsetToFd(result,
+                                             outSocket->getFd());
+                break;
             case DATAFORMAT_JSON:
                 ret = writeJsonAnswsetToFd(result,
                                            outSocket->getFd());
@@ -176,7 +705,508 @@ HandleConnection(void* dataPtr)
 }
 
 
-int initMws(const Config& config)
+static int
+reportReadahead(void* lastPercentPtr, uint64_t done, uint64_t total)
+{
+    int* lastPercent = (int*) lastPercentPtr;
+    int percent = (int) (100 * done / total);
+
+    if (percent / 10 != *lastPercent / 10) {
+        printf("Memsector readahead: %d%% (%" PRIu64 " MB)\n",
+               percent, done >> 20);
+        fflush(stdout);
+        *lastPercent = percent;
+    }
+
+    return stopReadahead;
+}
+
+static void*
+ReadaheadMemsector(void* memsectorPtr)
+{
+    shared_ptr<const memsector_handle_t>* ms =
+            (shared_ptr<const memsector_handle_t>*) memsectorPtr;
+    int lastPercent = 0;
+    double start = MonotonicMs();
+
+    if (memsector_warmup(ms->get(), reportReadahead, &lastPercent) == 0) {
+        printf("Memsector readahead done in %.0f ms\n", MonotonicMs() - start);
+        fflush(stdout);
+    }
+    delete ms;
+
+    return NULL;
+}
+
+static void
+unloadMemsector(memsector_handle_t* ms)
+{
+    (void) memsector_unload(ms);
+    delete ms;
+}
+
+/**
+ * @brief Load a memsector, which is unloaded when its last user drops it
+ * @return the memsector or NULL on failure
+ */
+static shared_ptr<const memsector_handle_t>
+loadMemsector(const string& path, int flags)
+{
+    memsector_handle_t* ms = new memsector_handle_t;
+
+    if (memsector_load_flags(ms, path.c_str(), flags) != 0) {
+        fprintf(stderr, "Error while loading memsector %s\n", path.c_str());
+        delete ms;
+        return nullptr;
+    }
+
+    return shared_ptr<const memsector_handle_t>(ms, unloadMemsector);
+}
+
+/**
+ * @brief Make formulae ingested while serving get ids after those of ms
+ */
+static void
+reserveMemsectorIds(const memsector_handle_t* ms)
+{
+    FormulaId maxId = 0;
+
+    for (uint32_t i = 0; i < ms->index.num_leaves; i++) {
+        maxId = max(maxId, (FormulaId) ms->index.leaves[i].dbid);
+    }
+    MwsIndexNode::reserveIds(maxId);
+}
+
+/**
+ * @brief Load the documents saved next to the memsector at path
+ * @return the documents (none if they were not saved) or NULL on failure
+ */
+static shared_ptr<index::Tombstones>
+loadDocuments(const string& path)
+{
+    const string documentsPath = path + DocumentsSuffix;
+    shared_ptr<index::Tombstones> documents =
+            make_shared<index::Tombstones>();
+
+    ifstream in(documentsPath.c_str(), ios::binary);
+    if (!in) {
+        printf("No documents saved at %s, only the harvests ingested "
+               "from now on can be deleted\n", documentsPath.c_str());
+        return documents;
+    }
+    if (documents->load(in) != 0) {
+        fprintf(stderr, "Error while loading %s\n", documentsPath.c_str());
+        return nullptr;
+    }
+
+    return documents;
+}
+
+/**
+ * @brief Save the documents of the base memsector of snapshot next to the
+ * memsector at path
+ * @return 0 on success, -1 on failure
+ */
+static int
+saveDocuments(const string& path, const IndexSnapshot& snapshot)
+{
+    const string documentsPath = path + DocumentsSuffix;
+    const string tmpPath = documentsPath + ".tmp";
+
+    ofstream out(tmpPath.c_str(), ios::binary);
+    if (!out || snapshot.saveDocuments(out) != 0 || !out.flush()) {
+        fprintf(stderr, "Error while saving %s\n", documentsPath.c_str());
+        (void) unlink(tmpPath.c_str());
+        return -1;
+    }
+    out.close();
+    if (rename(tmpPath.c_str(), documentsPath.c_str()) != 0) {
+        fprintf(stderr, "Error while saving %s\n", documentsPath.c_str());
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Export index to a new memsector at path, and its meanings next to it
+ * @param syncCb paces the writes of the memsector (can be NULL)
+ * @return 0 on success, -1 on failure
+ */
+static int
+writeMemsector(const Config& config,
+               MwsIndexNode* index,
+               const MeaningDictionary& dict,
+               const string& path,
+               const AccessCounts* accessCounts,
+               memsector_progress_cb_t syncCb,
+               void* syncArg)
+{
+    const string dictPath = path + MeaningDictionarySuffix;
+    memsector_writer_t mswr;
+
+    if (memsector_create(&mswr, path.c_str(), 0) != 0) {
+        fprintf(stderr, "Error while creating memsector %s "
+                "(remove it to rebuild)\n", path.c_str());
+        return -1;
+    }
+    if (index->exportToMemsector(&mswr, config.memsectorLayout,
+                                 accessCounts,
+                                 config.memsectorEncoding) != 0) {
+        fprintf(stderr, "Error while exporting to %s\n", path.c_str());
+        (void) memsector_discard(&mswr);
+        return -1;
+    }
+    uint64_t used = memsector_size_inuse(mswr_get_alloc(&mswr));
+    uint32_t numFormulas = index->countLeaves();
+    if ((syncCb != NULL && memsector_sync(&mswr, syncCb, syncArg) != 0) ||
+            memsector_save(&mswr) != 0) {
+        fprintf(stderr, "Error while exporting to %s\n", path.c_str());
+        (void) memsector_discard(&mswr);
+        return -1;
+    }
+    ofstream dictOut(dictPath.c_str(), ios::binary);
+    if (!dictOut || dict.save(dictOut) != 0 || !dictOut.flush()) {
+        fprintf(stderr, "Error while saving %s\n", dictPath.c_str());
+        return -1;
+    }
+    printf("Index exported to %s (%.1f bytes per formula)\n",
+           path.c_str(), (double) used / max(numFormulas, (uint32_t) 1));
+
+    return 0;
+}
+
+/**
+ * @brief Replay the queries found under path against the harvests index,
+ * counting the accesses to its nodes
+ * @return number of queries replayed or -1 on failure
+ */
+static int
+replayLayoutQueries(const string& path, AccessCounts* accessCounts)
+{
+    int numQueries = 0;
+    dbc::DbQueryManager dbQueryManger(crawlDb, formulaDb);
+
+    auto fileCallback = [&](const string& fullPath, const string&) {
+        int fd = open(fullPath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            fprintf(stderr, "Error while opening %s\n", fullPath.c_str());
+            return -1;
+        }
+        MwsQuery* mwsQuery = readMwsQueryFromFd(fd);
+        (void) close(fd);
+
+        if (mwsQuery && mwsQuery->tokens.size()) {
+            SearchContext ctxt(mwsQuery->tokens[0], meaningDictionary);
+            ctxt.setAccessCounts(accessCounts);
+            delete ctxt.getResult(data, &dbQueryManger,
+                                  mwsQuery->attrResultLimitMin,
+                                  mwsQuery->attrResultMaxSize,
+                                  mwsQuery->attrResultTotalReqNr);
+            numQueries++;
+        }
+        delete mwsQuery;
+
+        return 0;
+    };
+    if (common::utils::foreachEntryInDirectory(path, fileCallback) != 0) {
+        return -1;
+    }
+
+    return numQueries;
+}
+
+/**
+ * @brief Export the index built from the harvests to the memsector (or load
+ * the meaning dictionary of an existing one), then load the memsector to
+ * serve queries from.
+ */
+static int
+initMemsector(const Config& config)
+{
+    const string& path = config.memsectorPath;
+    const string dictPath = path + MeaningDictionarySuffix;
+    double start;
+
+    if (!config.harvestLoadPaths.empty()) {
+        AccessCounts accessCounts;
+
+        if (config.memsectorLayout == EXPORT_LAYOUT_HOT) {
+            int numQueries = replayLayoutQueries(config.layoutQueryPath,
+                                                 &accessCounts);
+            if (numQueries < 0) {
+                fprintf(stderr, "Error while replaying queries from %s\n",
+                        config.layoutQueryPath.c_str());
+                return -1;
+            }
+            printf("%d queries replayed, %zu index nodes accessed\n",
+                   numQueries, accessCounts.size());
+        }
+
+        if (writeMemsector(config, data, *meaningDictionary, path,
+                           &accessCounts, NULL, NULL) != 0) {
+            return -1;
+        }
+    } else {
+        ifstream dictIn(dictPath.c_str(), ios::binary);
+        if (!dictIn || meaningDictionary->load(dictIn) != 0) {
+            fprintf(stderr, "Error while loading %s\n", dictPath.c_str());
+            return -1;
+        }
+        if ((tombstones = loadDocuments(path)) == NULL) {
+            return -1;
+        }
+    }
+
+    // queries are answered from the memsector from now on
+    delete data;
+    data = NULL;
+
+    start = MonotonicMs();
+    memsector = loadMemsector(path, config.memsectorLoadFlags);
+    if (memsector == NULL) {
+        return -1;
+    }
+    if (config.harvestLoadPaths.empty()) {
+        reserveMemsectorIds(memsector.get());
+    }
+    printf("Memsector %s loaded in %.0f ms (%zu MB)\n", path.c_str(),
+           MonotonicMs() - start, memsector->mmap_handle.size >> 20);
+    fflush(stdout);
+
+    if (config.memsectorReadahead &&
+            ThreadWrapper::run(ReadaheadMemsector,
+                               new shared_ptr<const memsector_handle_t>(
+                                   memsector)) != 0) {
+        fprintf(stderr, "Error while starting memsector readahead\n");
+    }
+
+    return 0;
+}
+
+
+/// Pace of the writes of a merged memsector
+struct MergeThrottle {
+    double   start;
+    uint64_t bytesPerMs;
+};
+
+static int
+throttleMerge(void* throttlePtr, uint64_t done, uint64_t total)
+{
+    MergeThrottle* throttle = (MergeThrottle*) throttlePtr;
+    double ahead = (double) done / throttle->bytesPerMs -
+            (MonotonicMs() - throttle->start);
+
+    UNUSED(total);
+    if (ahead > 0 && !stopMerge) {
+        usleep((useconds_t) (ahead * 1000));
+    }
+
+    return stopMerge;
+}
+
+/**
+ * @brief Merge the deltas ingested so far and the base memsector into a new
+ * memsector, which replaces the base once written. Queries keep running on
+ * the old base, which is unloaded when the last of them finishes.
+ * @return 0 on success, -1 on failure
+ */
+static int
+mergeDeltas(const Config& config)
+{
+    const string& path = config.memsectorPath;
+    const string mergePath = path + ".merge";
+    MergeThrottle throttle;
+    // the merged nodes were never accessed: hot layouts fall back to DFS
+    AccessCounts accessCounts;
+    double start = MonotonicMs();
+    int ret;
+
+    pthread_mutex_lock(&baseMutex);
+    // harvests ingested from now on go to a new delta
+    pthread_mutex_lock(&ingestMutex);
+    shared_ptr<IndexSnapshot> merged(IndexSnapshot::current()->freeze());
+    IndexSnapshot::publish(merged);
+    pthread_mutex_unlock(&ingestMutex);
+
+    map<FormulaId, FormulaId> renamed;
+    MwsIndexNode* index = merged->mergeIndexes(&renamed);
+    throttle.start = MonotonicMs();
+    throttle.bytesPerMs = max(config.mergeRateLimit * 1024 * 1024 / 1000,
+                              (uint64_t) 1);
+    ret = writeMemsector(config, index, merged->getMeaningDictionary(),
+                         mergePath, &accessCounts,
+                         (config.mergeRateLimit > 0) ? throttleMerge : NULL,
+                         &throttle);
+    delete index;
+    if (ret != 0) {
+        (void) unlink(mergePath.c_str());
+        (void) unlink((mergePath + MeaningDictionarySuffix).c_str());
+        goto fail;
+    }
+
+    // the meanings only grow, so they stay valid for the old memsector
+    if (rename((mergePath + MeaningDictionarySuffix).c_str(),
+               (path + MeaningDictionarySuffix).c_str()) != 0 ||
+            rename(mergePath.c_str(), path.c_str()) != 0) {
+        fprintf(stderr, "Error while replacing %s\n", path.c_str());
+        goto fail;
+    }
+    {
+        shared_ptr<const memsector_handle_t> ms =
+                loadMemsector(path, config.memsectorLoadFlags);
+        if (ms == NULL) goto fail;
+
+        pthread_mutex_lock(&ingestMutex);
+        shared_ptr<IndexSnapshot> rebased(
+                IndexSnapshot::current()->rebase(ms, *merged, renamed));
+        IndexSnapshot::publish(rebased);
+        // folded duplicates and the merged order change the answers
+        indexGeneration++;
+        pthread_mutex_unlock(&ingestMutex);
+        // deletions until the next save are lost if mwsd crashes
+        (void) saveDocuments(path, *rebased);
+    }
+    pthread_mutex_unlock(&baseMutex);
+    printf("%" PRIu32 " ingested expressions merged into %s in %.0f ms\n",
+           merged->getNumDeltaExpressions(), path.c_str(),
+           MonotonicMs() - start);
+    fflush(stdout);
+
+    return 0;
+
+fail:
+    pthread_mutex_unlock(&baseMutex);
+    return -1;
+}
+
+static void*
+MergeDeltasPeriodically(void* configPtr)
+{
+    const Config* config = (const Config*) configPtr;
+
+    while (!stopMerge) {
+        for (unsigned i = 0; i < config->mergeInterval && !stopMerge; i++) {
+            sleep(1);
+        }
+        if (stopMerge) break;
+
+        if (IndexSnapshot::current()->getNumDeltaExpressions() > 0 &&
+                mergeDeltas(*config) != 0) {
+            fprintf(stderr, "Error while merging the ingested harvests\n");
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Replace the index by the memsector found at the memsector path
+ * (typically rebuilt offline), warmed up before queries are switched to it.
+ * Queries in flight finish on the old index, which is unloaded after them.
+ * The harvests ingested since the old index was built are dropped.
+ * @return 0 on success, -1 on failure
+ */
+static int
+reloadMemsector(const Config& config)
+{
+    const string& path = config.memsectorPath;
+    const string dictPath = path + MeaningDictionarySuffix;
+    MeaningDictionary dict(CONST_ID_MIN);
+    int lastPercent = 0;
+    double start = MonotonicMs();
+
+    ifstream dictIn(dictPath.c_str(), ios::binary);
+    if (!dictIn || dict.load(dictIn) != 0) {
+        fprintf(stderr, "Error while loading %s\n", dictPath.c_str());
+        return -1;
+    }
+
+    pthread_mutex_lock(&baseMutex);
+    shared_ptr<const memsector_handle_t> ms =
+            loadMemsector(path, config.memsectorLoadFlags);
+    if (ms == NULL) {
+        pthread_mutex_unlock(&baseMutex);
+        return -1;
+    }
+    if (memsector_warmup(ms.get(), reportReadahead, &lastPercent) != 0) {
+        pthread_mutex_unlock(&baseMutex);
+        return -1;
+    }
+    reserveMemsectorIds(ms.get());
+    shared_ptr<index::Tombstones> documents = loadDocuments(path);
+    if (documents == NULL) {
+        pthread_mutex_unlock(&baseMutex);
+        return -1;
+    }
+
+    pthread_mutex_lock(&ingestMutex);
+    uint32_t numDropped = IndexSnapshot::current()->getNumDeltaExpressions();
+    IndexSnapshot::publish(make_shared<IndexSnapshot>(
+            (MwsIndexNode*) NULL, ms, dict, documents, crawlDb, formulaDb,
+            config.partition));
+    indexGeneration++;
+    pthread_mutex_unlock(&ingestMutex);
+    pthread_mutex_unlock(&baseMutex);
+
+    printf("Memsector %s reloaded in %.0f ms (%zu MB, "
+           "%" PRIu32 " ingested expressions dropped)\n",
+           path.c_str(), MonotonicMs() - start,
+           ms->mmap_handle.size >> 20, numDropped);
+    fflush(stdout);
+
+    return 0;
+}
+
+static void*
+ReloadOnSignal(void* configPtr)
+{
+    const Config* config = (const Config*) configPtr;
+    char request;
+
+    while (read(reloadPipe[0], &request, 1) == 1 && run) {
+        if (config->memsectorPath.empty()) {
+            fprintf(stderr, "Reload requested, but no memsector is served\n");
+        } else if (reloadMemsector(*config) != 0) {
+            fprintf(stderr, "Error while reloading, "
+                    "still serving the previous index\n");
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Accept the connections on the Unix domain socket, while the daemon
+ * loop accepts the TCP ones
+ */
+static void*
+AcceptUnixConnections(void* dataPtr)
+{
+    UNUSED(dataPtr);
+    OutSocket* acceptedSock;
+
+    while (run) {
+        acceptedSock = unixServerSocket->accept();
+        if (acceptedSock == NULL) continue;
+        if (ThreadWrapper::run(HandleConnection, acceptedSock) != 0) {
+            delete acceptedSock;
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * @brief Load the index and start the background threads
+ * @param acceptConnections whether to accept connections (and exit on
+ * SIGTERM), or only answer the requests passed to answerRequest()
+ */
+static int
+initMws(const Config& config, bool acceptConnections)
 {
     int ret;
 
@@ -191,10 +1221,15 @@ int initMws(const Config& config)
     formulaDb = new dbc::NullFormulaDb();
 
     data = new MwsIndexNode();
-    meaningDictionary = new MeaningDictionary();
+    // constant ids after the variable ids, as expected by the memsector
+    meaningDictionary = new MeaningDictionary(CONST_ID_MIN);
+
+    tombstones = make_shared<index::Tombstones>();
 
     indexManager = new index::IndexManager(formulaDb, crawlDb, data,
-                                           meaningDictionary);
+                                           meaningDictionary,
+                                           tombstones.get());
+    indexManager->setPartition(&config.partition);
 
     ret = ThreadWrapper::init();
     if (ret)
@@ -219,30 +1254,109 @@ int initMws(const Config& config)
         fflush(stdout);
     }
 
+    if (!config.memsectorPath.empty() && initMemsector(config) != 0) {
+        clearxmlparser();
+        return 1;
+    }
+
+    IndexSnapshot::publish(make_shared<IndexSnapshot>(
+            data, memsector, *meaningDictionary, tombstones, crawlDb,
+            formulaDb, config.partition));
+    memsector.reset();
+    tombstones.reset();
+    if (!config.memsectorPath.empty()) {
+        documentsMemsectorPath = config.memsectorPath;
+        if (!config.harvestLoadPaths.empty() &&
+                saveDocuments(documentsMemsectorPath,
+                              *IndexSnapshot::current()) != 0) {
+            clearxmlparser();
+            return 1;
+        }
+    }
+
     if (!config.exitAfterLoad) {
-        // Starting the network side and accepting connections
-        serverSocket = new InSocket(config.mwsPort);
-        // TODO check return
-        serverSocket->enable();
-
-        // Registering the signal handler
-        signal(SIGTERM, graceful_exit);
-        signal(SIGINT, graceful_exit);
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sigemptyset(&sa.sa_mask);
+
+        if (acceptConnections) {
+            // Starting the network side and accepting connections
+            serverSocket = new InSocket(config.mwsPort);
+            if (serverSocket->enable() != 0) {
+                fprintf(stderr, "Error while listening on port %d\n",
+                        config.mwsPort);
+                clearxmlparser();
+                return 1;
+            }
+            if (!config.socketPath.empty()) {
+                unixServerSocket = new InSocket(config.socketPath);
+                if (unixServerSocket->enable() != 0) {
+                    fprintf(stderr, "Error while listening on %s\n",
+                            config.socketPath.c_str());
+                    clearxmlparser();
+                    return 1;
+                }
+            }
+
+            // Registering the signal handlers, such that accept() is
+            // interrupted rather than restarted
+            sa.sa_handler = graceful_exit;
+            sigaction(SIGTERM, &sa, NULL);
+            sigaction(SIGINT, &sa, NULL);
+        }
         signal(SIGPIPE, SIG_IGN);
+
+        threadConfig = config;
+        if (pipe(reloadPipe) != 0 ||
+                fcntl(reloadPipe[1], F_SETFL, O_NONBLOCK) != 0 ||
+                ThreadWrapper::run(ReloadOnSignal,
+                                   (void*) &threadConfig) != 0) {
+            fprintf(stderr, "Error while starting the reload thread\n");
+        } else {
+            sa.sa_handler = request_reload;
+            sigaction(SIGHUP, &sa, NULL);
+        }
+
+        if (!config.memsectorPath.empty() && config.mergeInterval > 0 &&
+                ThreadWrapper::run(MergeDeltasPeriodically,
+                                   (void*) &threadConfig) != 0) {
+            fprintf(stderr, "Error while starting the merge thread\n");
+        }
+
+        if (unixServerSocket != NULL &&
+                ThreadWrapper::run(AcceptUnixConnections, NULL) != 0) {
+            fprintf(stderr, "Error while accepting connections on %s\n",
+                    config.socketPath.c_str());
+        }
     }
 
     return ret;
 }
 
 
-void cleanupMws()
+static void
+cleanupMws()
 {
     // Important to clean thread module first,
     // to wait for last connection threads to exit gracefully
+    stopReadahead = 1;
+    stopMerge = 1;
+    if (reloadPipe[1] >= 0) {
+        // wakes up the reload thread
+        (void) close(reloadPipe[1]);
+    }
     ThreadWrapper::clean();
+    if (!documentsMemsectorPath.empty() && IndexSnapshot::current() &&
+            saveDocuments(documentsMemsectorPath,
+                          *IndexSnapshot::current()) == 0) {
+        printf("Documents saved to %s%s\n", documentsMemsectorPath.c_str(),
+               DocumentsSuffix.c_str());
+    }
+    IndexSnapshot::publish(nullptr);
 
     clearxmlparser();
     delete serverSocket;
+    delete unixServerSocket;
     delete data;
 }
 
@@ -251,18 +1365,33 @@ int mwsDaemonLoop(const Config& config)
 {
     OutSocket* acceptedSock;
 
-    initMws(config);
+    if (initMws(config, /* acceptConnections = */ true) != 0) {
+        return EXIT_FAILURE;
+    }
 
     atexit(cleanupMws);
 
     if (!config.exitAfterLoad) {
         while (run) {
             acceptedSock = serverSocket->accept();
+            if (acceptedSock == NULL) continue;
             ThreadWrapper::run(HandleConnection, acceptedSock);
         }
+        printf("Exiting after the queries in flight\n");
+        fflush(stdout);
     }
  
     return EXIT_SUCCESS;
 }
 
+int startEmbeddedMws(const Config& config)
+{
+    return initMws(config, /* acceptConnections = */ false);
+}
+
+void stopEmbeddedMws()
+{
+    cleanupMws();
+}
+
 } /* daemon */ } /* mws */
@@ -35,6 +35,10 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 #include <vector>
 #include <inttypes.h>
 
+#include "common/socket/Frame.hpp"
+#include "mws/index/MwsIndexNode.hpp"
+#include "mws/index/Partition.hpp"
+
 
 // TODO Doc and clean up implementation
 
@@ -44,13 +48,53 @@ struct Config {
     std::vector<std::string> harvestLoadPaths;
     bool                     recursive;
     uint16_t                 mwsPort;
+    /// Unix domain socket listened on besides mwsPort (none if empty)
+    std::string              socketPath;
     std::string              dataPath;
     std::string              outDir;
     bool                     exitAfterLoad;
+    /// serve queries from this memsector (exported from the harvests if any)
+    std::string              memsectorPath;
+    /// or-ed memsector_load_flags_t
+    int                      memsectorLoadFlags;
+    /// read the whole memsector in a background thread after loading
+    bool                     memsectorReadahead;
+    /// node order of the exported memsector
+    ExportLayout             memsectorLayout;
+    /// queries replayed to find the hot nodes of EXPORT_LAYOUT_HOT
+    std::string              layoutQueryPath;
+    /// node encoding of the exported memsector
+    ExportEncoding           memsectorEncoding;
+    /// seconds between merges of the ingested harvests into the memsector
+    /// (0 to never merge)
+    unsigned                 mergeInterval;
+    /// MB per second written by a merge (0 for no limit)
+    uint64_t                 mergeRateLimit;
+    /// part of the harvests indexed by this mwsd
+    index::Partition         partition;
 };
 
 int mwsDaemonLoop(const Config& config);
 
+/**
+ * @brief Load the index and serve it in the calling process, which passes
+ * the requests to answerRequest() instead of connecting to a mwsd
+ * @return 0 on success
+ */
+int startEmbeddedMws(const Config& config);
+
+/**
+ * @brief Wait for the requests in flight and release the index loaded by
+ * startEmbeddedMws()
+ */
+void stopEmbeddedMws();
+
+/**
+ * @brief Carry out a request of the framed protocol (see Frame), as mwsd
+ * does for its clients. Thread safe.
+ */
+void answerRequest(const Frame& request, Frame* answer);
+
 }}
 
 #endif // _MWSDAEMON_HPP
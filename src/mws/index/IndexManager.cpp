@@ -38,9 +38,16 @@ namespace mws { namespace index {
 IndexManager::IndexManager(dbc::FormulaDb* formulaDb,
                            dbc::CrawlDb* crawlDb,
                            MwsIndexNode* index,
-                           MeaningDictionary* meaningDictionary) :
+                           MeaningDictionary* meaningDictionary,
+                           Tombstones* tombstones) :
     m_formulaDb(formulaDb), m_crawlDb(crawlDb), m_index(index),
-    m_meaningDictionary(meaningDictionary) { }
+    m_meaningDictionary(meaningDictionary), m_tombstones(tombstones),
+    m_partition(NULL) { }
+
+void
+IndexManager::setPartition(const Partition* partition) {
+    m_partition = partition;
+}
 
 int
 IndexManager::indexContentMath(const types::CmmlToken* cmmlToken,
@@ -52,6 +59,10 @@ IndexManager::indexContentMath(const types::CmmlToken* cmmlToken,
     stack<const CmmlToken*> subtermStack;
     int numSubExpressions = 0;
     const CrawlId crawlId = m_crawlDb->putData(crawlData);
+    // expressions of a document only differ by their fragment
+    const string documentUri =
+            crawlData.expressionUri.substr(0,
+                                           crawlData.expressionUri.find('#'));
 
     subtermStack.push(cmmlToken);
     while (!subtermStack.empty()) {
@@ -63,6 +74,10 @@ IndexManager::indexContentMath(const types::CmmlToken* cmmlToken,
              rIt ++) {
             subtermStack.push(*rIt);
         }
+        // the subexpressions of other partitions are indexed by other mwsd
+        if (m_partition != NULL && !m_partition->contains(currentSubterm)) {
+            continue;
+        }
 
         MwsIndexNode* leaf = m_index->insertData(currentSubterm,
                                                  m_meaningDictionary);
@@ -78,6 +93,10 @@ IndexManager::indexContentMath(const types::CmmlToken* cmmlToken,
             docId.xmlId = crawlData.expressionUri;
             docId.xpath = currentSubterm->getXpath();
             (*mloggedFormulae)[formulaId].push_back(docId);
+
+            if (m_tombstones != NULL) {
+                m_tombstones->addOccurrence(documentUri, formulaId);
+            }
         }
     }
 
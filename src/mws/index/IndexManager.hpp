@@ -34,6 +34,8 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 #include "mws/dbc/FormulaDb.hpp"
 #include "mws/dbc/CrawlDb.hpp"
 #include "mws/index/MwsIndexNode.hpp"
+#include "mws/index/Partition.hpp"
+#include "mws/index/Tombstones.hpp"
 #include "mws/types/GenericTypes.hpp"
 
 namespace mws { namespace index {
@@ -46,12 +48,25 @@ private:
     dbc::CrawlDb* m_crawlDb;
     MwsIndexNode* m_index;
     types::MeaningDictionary* m_meaningDictionary;
+    Tombstones* m_tombstones;
+    const Partition* m_partition;
 
 public:
+    /**
+     * @param tombstones where to record the documents of the indexed
+     * formulae, or NULL
+     */
     IndexManager(dbc::FormulaDb* formulaDb,
                  dbc::CrawlDb* crawlDb,
                  MwsIndexNode* index,
-                 types::MeaningDictionary* meaningDictionary);
+                 types::MeaningDictionary* meaningDictionary,
+                 Tombstones* tombstones = NULL);
+
+    /**
+     * @brief only index the subexpressions of a partition
+     * @param partition is the partition to index (NULL to index all).
+     */
+    void setPartition(const Partition* partition);
 
     /**
      * @brief index content math formula
@@ -25,8 +25,13 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
   * @date   03 May 2011
   */
 
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <queue>
 #include <stack>
 #include <string>
+#include <vector>
 
 #include "MwsIndexNode.hpp"
 #include "mws/dbc/DbQueryManger.hpp"
@@ -42,15 +47,23 @@ using namespace std;
 
 // Static members declaration
 
-unsigned long long MwsIndexNode::nextNodeId = 0;
+atomic<unsigned long long> MwsIndexNode::nextNodeId(0);
 
 
 namespace mws
 {
 
 MwsIndexNode::MwsIndexNode() :
-    id          ( ++MwsIndexNode::nextNodeId ),
-    solutions   ( 0 )
+    id          ( MwsIndexNode::nextNodeId.fetch_add(1) + 1 ),
+    solutions   ( 0 ),
+    refs        ( 1 )
+{ }
+
+
+MwsIndexNode::MwsIndexNode(unsigned long long id) :
+    id          ( id ),
+    solutions   ( 0 ),
+    refs        ( 1 )
 { }
 
 
@@ -64,7 +77,7 @@ MwsIndexNode::~MwsIndexNode()
     
     for (it = children.begin(); it != children.end(); it ++)
     {
-        delete it->second;
+        release(it->second);
     }
 
 #ifdef TRACE_FUNC_CALLS
@@ -73,6 +86,163 @@ MwsIndexNode::~MwsIndexNode()
 }
 
 
+MwsIndexNode*
+MwsIndexNode::clone() const {
+    MwsIndexNode* copy = new MwsIndexNode(id);
+    copy->solutions = solutions;
+
+    _MapType::const_iterator it;
+    for (it = children.begin(); it != children.end(); it++) {
+        copy->children.insert(make_pair(it->first, it->second->clone()));
+    }
+
+    return copy;
+}
+
+
+MwsIndexNode*
+MwsIndexNode::share() const {
+    MwsIndexNode* copy = new MwsIndexNode(id);
+    copy->solutions = solutions;
+    copy->children = children;
+
+    _MapType::const_iterator it;
+    for (it = children.begin(); it != children.end(); it++) {
+        it->second->refs.fetch_add(1, memory_order_relaxed);
+    }
+
+    return copy;
+}
+
+
+void
+MwsIndexNode::release(MwsIndexNode* node) {
+    if (node->refs.fetch_sub(1, memory_order_acq_rel) == 1) {
+        delete node;
+    }
+}
+
+
+void
+MwsIndexNode::reserveIds(unsigned long long maxId) {
+    unsigned long long current = nextNodeId.load();
+    while (current < maxId &&
+           !nextNodeId.compare_exchange_weak(current, maxId)) { }
+}
+
+
+MwsIndexNode*
+MwsIndexNode::importFromMemsector(const index_handle_t* index) {
+    return importNode(index, index->root);
+}
+
+
+MwsIndexNode*
+MwsIndexNode::importNode(const index_handle_t* index, const inode_t* inode) {
+    switch (inode->type) {
+    case INTERNAL_NODE: {
+        MwsIndexNode* node = new MwsIndexNode(0);
+        // wide nodes store their children in Eytzinger order: sort them
+        // first, such that inserting a child does not move the others
+        vector<pair<NodeInfo, memsector_off_t> > entries;
+        inode_iter_t it;
+        encoded_token_t token;
+        memsector_off_t off;
+        inode_iter_init(&it, index, inode);
+        while (inode_iter_next(&it, &token, &off)) {
+            entries.push_back(make_pair(make_pair((MeaningId) token.id,
+                                                  (Arity) token.arity), off));
+        }
+        sort(entries.begin(), entries.end(),
+             [](const pair<NodeInfo, memsector_off_t>& a,
+                const pair<NodeInfo, memsector_off_t>& b) {
+            return Comparator<NodeInfo>::compare(a.first, b.first) < 0;
+        });
+
+        for (auto& entry : entries) {
+            const inode_t* child = (const inode_t*)
+                    memsector_off2addr(index->alloc, entry.second);
+            node->children.insert(make_pair(entry.first,
+                                            importNode(index, child)));
+        }
+        return node;
+    }
+    case PATH_NODE: {
+        // the run is stored in query stack order (first token last)
+        const pnode_t* path = (const pnode_t*) inode;
+        vector<encoded_token_t> buf(path->size);
+        const encoded_token_t* tokens = pnode_get_tokens(index, path,
+                                                         buf.data());
+        const inode_t* next = (const inode_t*)
+                memsector_off2addr(index->alloc, path->next);
+        MwsIndexNode* node = importNode(index, next);
+        for (uint32_t i = 0; i < path->size; i++) {
+            MwsIndexNode* parent = new MwsIndexNode(0);
+            parent->children.insert(
+                    make_pair(make_pair((MeaningId) tokens[i].id,
+                                        (Arity) tokens[i].arity), node));
+            node = parent;
+        }
+        return node;
+    }
+    case LEAF_NODE: {
+        const leaf_t* leaf = (const leaf_t*) inode;
+        MwsIndexNode* node = new MwsIndexNode(leaf->dbid);
+        node->solutions = leaf->num_hits;
+        return node;
+    }
+    default:
+        assert(false);
+        return NULL;
+    }
+}
+
+
+void
+MwsIndexNode::merge(const MwsIndexNode* other,
+                    map<FormulaId, FormulaId>* renamed) {
+    solutions += other->solutions;
+    if (renamed != NULL && children.size() == 0 && other->id != id) {
+        (*renamed)[(FormulaId) other->id] = (FormulaId) id;
+    }
+
+    _MapType::const_iterator it;
+    for (it = other->children.begin(); it != other->children.end(); it++) {
+        _MapType::iterator mine = children.find(it->first);
+        if (mine == children.end()) {
+            children.insert(make_pair(it->first, it->second->clone()));
+        } else {
+            mine->second->merge(it->second, renamed);
+        }
+    }
+}
+
+
+bool
+MwsIndexNode::removeHits(const map<FormulaId, uint32_t>& hits) {
+    if (children.size() == 0) {
+        map<FormulaId, uint32_t>::const_iterator it =
+                hits.find((FormulaId) id);
+        if (it != hits.end()) {
+            solutions = (solutions > it->second) ? solutions - it->second : 0;
+        }
+        return solutions > 0;
+    }
+
+    _MapType::iterator it = children.begin();
+    while (it != children.end()) {
+        if (it->second->removeHits(hits)) {
+            it++;
+        } else {
+            release(it->second);
+            it = children.erase(it);
+        }
+    }
+
+    return children.size() > 0;
+}
+
+
 MwsIndexNode*
 MwsIndexNode::insertData(const CmmlToken* expression,
                          MeaningDictionary* meaningDictionary) {
@@ -108,6 +278,13 @@ MwsIndexNode::insertData(const CmmlToken* expression,
         }
         else
         {
+            // the nodes shared with other indexes are copied on write
+            if (mapIt->second->refs.load(memory_order_acquire) > 1)
+            {
+                MwsIndexNode* shared = mapIt->second;
+                mapIt->second = shared->share();
+                release(shared);
+            }
             currentNode = mapIt->second;
         }
 
@@ -129,91 +306,513 @@ struct mws_data {
     unsigned      arity;
 };
 
-void
-MwsIndexNode::exportToMemsector(memsector_writer_t* mswr) {
+uint32_t
+MwsIndexNode::countLeaves() {
+    uint32_t num_leaves = 0;
+
+    // walking the MWS index in DFS order, keeping track of the arity
+    stack<pair<MwsIndexNode*, int> > nodes_stack;
+    nodes_stack.push(make_pair(this, 1));
+
+    while (!nodes_stack.empty()) {
+        MwsIndexNode* node = nodes_stack.top().first;
+        int arity = nodes_stack.top().second;
+        nodes_stack.pop();
+
+        _MapType::iterator it;
+        for (it = node->children.begin(); it != node->children.end(); it++) {
+            int new_arity = arity + it->first.second - 1;
+            if (new_arity == 0) {
+                num_leaves++;
+            } else {
+                nodes_stack.push(make_pair(it->second, new_arity));
+            }
+        }
+    }
+
+    return num_leaves;
+}
+
+uint32_t
+MwsIndexNode::getUnaryChainLength(MwsIndexNode* node, int arity) {
+    uint32_t length = 0;
+
+    while (arity > 0 && node->children.size() == 1 &&
+           length < PNODE_MAX_SIZE) {
+        _MapType::iterator it = node->children.begin();
+        if (it->first.first <= VAR_ID_MAX) break;   // keep hvars in inodes
+        arity += it->first.second - 1;
+        node = it->second;
+        length++;
+    }
+
+    return length;
+}
+
+struct MwsIndexNode::ExportNode {
+    MwsIndexNode*   head;           // node linked from the parent
+    MwsIndexNode*   node;           // node following the path (head if none)
+    uint32_t        run;            // length of the path node (0 if none)
+    bool            isLeaf;
+    uint32_t        leavesBegin;
+    uint32_t        leavesEnd;
+    uint32_t        firstChild;     // ExportNode children in DFS order
+    uint32_t        nextSibling;
+    memsector_off_t off;            // linked from the parent
+    memsector_off_t nodeOff;        // of the inode or leaf following the path
+    uint32_t        numVars;        // of the inode
+    bool            compact;        // inode with INODE_LAYOUT_COMPACT
+    uint64_t        inodeSize;
+    uint64_t        pathSize;
+
+    /// bytes allocated for the node and its path node
+    uint64_t space() const {
+        return ((run > 0) ? memsector_align(pathSize) : 0) +
+               (isLeaf ? 0 : memsector_align(inodeSize));
+    }
+
+    /// set the offsets of the node as if allocated at *offset, advancing it
+    void place(uint64_t* offset) {
+        off = (memsector_off_t) (*offset >> MEMSECTOR_OFF_SHIFT);
+        if (!isLeaf) {
+            nodeOff = off;
+            if (run > 0) {
+                nodeOff = memsector_off_add(nodeOff, memsector_align(pathSize));
+            }
+        }
+        *offset += space();
+    }
+
+    /// ref of a child of this compact inode (NULL child for leaf links)
+    uint64_t compactRef(const ExportNode* child, uint32_t leaf) const {
+        return (child != NULL) ? inode_compact_node_ref(nodeOff, child->off) :
+                                 inode_compact_leaf_ref(leaf - leavesBegin);
+    }
+};
+
+/// Entry of an inode, pointing to an ExportNode or directly to a leaf
+struct ExportLink {
+    uint32_t        parent;
+    uint32_t        slot;
+    encoded_token_t token;
+    uint32_t        child;
+    memsector_off_t leafOff;
+    uint32_t        leaf;
+};
+
+static const uint32_t NO_EXPORT_NODE = (uint32_t) -1;
+
+struct MwsIndexNode::ExportFrame {
+    MwsIndexNode::_MapType::iterator curr;
+    MwsIndexNode::_MapType::iterator end;
+    int      arity;
+    uint32_t exportNode;
+    uint32_t slot;
+    uint32_t lastChild;
+};
+
+int
+MwsIndexNode::allocExportNode(memsector_writer_t* mswr, ExportNode* en,
+                              const map<uint32_t, uint32_t>* ranks) {
     memsector_alloc_header_t* alloc = mswr_get_alloc(mswr);
+    pnode_t* path = NULL;
+    memsector_off_t pathOff = 0;
+
+    if (en->run > 0) {
+        pathOff = mswr_alloc(mswr, en->pathSize);
+        if (pathOff == 0) return -1;
+        path = (pnode_t*) memsector_off2addr(alloc, pathOff);
+        path->type = PATH_NODE;
+        path->size = en->run;
+        path->compact = (ranks != NULL);
+        path->leaves_begin = en->leavesBegin;
+        path->leaves_end = en->leavesEnd;
+
+        // tokens in query stack order (first token of the run on top)
+        vector<encoded_token_t> tokens(en->run);
+        MwsIndexNode* node = en->head;
+        for (uint32_t i = 0; i < en->run; i++) {
+            MwsIndexNode::_MapType::iterator it = node->children.begin();
+            tokens[en->run - 1 - i] = encoded_token(it->first.first,
+                                                    it->first.second);
+            node = it->second;
+        }
+        if (ranks != NULL) {
+            uint8_t* out = (uint8_t*) path->tokens;
+            for (uint32_t i = 0; i < en->run; i++) {
+                out += varint_encode(out, ranks->find(
+                                     encoded_token_key(tokens[i]))->second);
+            }
+        } else {
+            memcpy(path->tokens, tokens.data(),
+                   en->run * sizeof(encoded_token_t));
+        }
+    }
 
-    (void) mswr_index_begin(mswr);
+    if (!en->isLeaf) {
+        en->nodeOff = mswr_alloc(mswr, en->inodeSize);
+        if (en->nodeOff == 0) return -1;
+        inode_t* inode = (inode_t*) memsector_off2addr(alloc, en->nodeOff);
+        inode->type = INTERNAL_NODE;
+        inode->layout = en->compact ? INODE_LAYOUT_COMPACT :
+                                      INODE_LAYOUT_SORTED;
+        inode->num_vars = en->numVars;
+        inode->num_consts = en->node->children.size() - en->numVars;
+        inode->leaves_begin = en->leavesBegin;
+        inode->leaves_end = en->leavesEnd;
+    }
 
-    typedef MwsIndexNode::_MapType::iterator iterator;
+    // link the path node to the node it leads to
+    if (path != NULL) {
+        path->next = en->nodeOff;
+        en->off = pathOff;
+    } else {
+        en->off = en->nodeOff;
+    }
 
-    // walking the MWS index in DFS order
-    // using a stack to hold nodes and arities at the respective depth
-    stack<pair<pair<iterator, iterator>,int> > nodes_stack;
-    stack<pair<inode_t*, int> > ms_nodes_stack;
+    return 0;
+}
 
-    MwsIndexNode::_MapType map;
-    map.insert(make_pair(NodeInfo(0,1), this)); // TODO explain
-    nodes_stack.push(make_pair(make_pair(map.begin(), map.end()), 1));
+static uint64_t
+getAccessCount(const AccessCounts* accessCounts, const MwsIndexNode* node) {
+    AccessCounts::const_iterator it = accessCounts->find(node);
+    return (it != accessCounts->end()) ? it->second : 0;
+}
 
-    while (!nodes_stack.empty()) {
-        assert(nodes_stack.size() == ms_nodes_stack.size() + 1);
+int
+MwsIndexNode::exportToMemsector(memsector_writer_t* mswr,
+                                ExportLayout layout,
+                                const AccessCounts* accessCounts,
+                                ExportEncoding encoding) {
+    memsector_alloc_header_t* alloc = mswr_get_alloc(mswr);
+    vector<ExportNode> nodes;
+    vector<ExportLink> links;
+
+    // leaves are stored in a dense array, in DFS order, such that the leaves
+    // of every subtree are a contiguous range of it
+    uint32_t num_leaves = countLeaves();
+    memsector_off_t leaves_off = mswr_alloc(mswr,
+                                            leaf_array_sizeof(num_leaves));
+    if (leaves_off == 0) return -1;
+    uint32_t next_leaf = 0;
+
+    index_header_t* index_header = mswr_index_begin(mswr);
+    if (index_header == NULL) return -1;
+    index_header->leaves_off = leaves_off;
+    index_header->num_leaves = num_leaves;
+
+    // plan the export walking the MWS index in DFS order: leaves are written
+    // right away, other nodes are allocated afterwards in layout order
+    ExportNode root = { this, this, 0, false, 0, 0, NO_EXPORT_NODE,
+                        NO_EXPORT_NODE, 0, 0, 0, false, 0, 0 };
+    nodes.push_back(root);
+    stack<ExportFrame> frames;
+    ExportFrame rootFrame = { children.begin(), children.end(), 1, 0, 0,
+                              NO_EXPORT_NODE };
+    frames.push(rootFrame);
+
+    while (!frames.empty()) {
+        ExportFrame& top = frames.top();
+
+        if (top.curr == top.end) {
+            nodes[top.exportNode].leavesEnd = next_leaf;
+            frames.pop();
+            continue;
+        }
 
-        iterator& top_curr = nodes_stack.top().first.first;
-        iterator& top_end  = nodes_stack.top().first.second;
-        int arity = nodes_stack.top().second;
+        MwsIndexNode* node = top.curr->second;
+        encoded_token_t token = encoded_token(top.curr->first.first,
+                                              top.curr->first.second);
+        int new_arity = top.arity + top.curr->first.second - 1;
+        ExportLink link = { top.exportNode, top.slot, token, NO_EXPORT_NODE,
+                            0, 0 };
+        top.curr++;
+        top.slot++;
+
+        // collapse a chain of nodes with a single constant child into a
+        // path node (the root follows the index header, so it has none)
+        uint32_t run = getUnaryChainLength(node, new_arity);
+        MwsIndexNode* target = node;
+        for (uint32_t i = 0; i < run; i++) {
+            _MapType::iterator it = target->children.begin();
+            new_arity += it->first.second - 1;
+            target = it->second;
+        }
 
-        if (top_curr == top_end) {
-            nodes_stack.pop();
-            ms_nodes_stack.pop();
+        memsector_off_t leaf_off = 0;
+        if (new_arity == 0) {   // leaf node
+            assert(next_leaf < num_leaves);
+
+            // copy leaf node to the next slot of the leaf array
+            leaf_off = memsector_off_add(leaves_off,
+                                         next_leaf * sizeof(leaf_t));
+            leaf_t *leaf_ms = (leaf_t*) memsector_off2addr(alloc, leaf_off);
+            leaf_ms->type = LEAF_NODE;
+            leaf_ms->num_hits = target->solutions;
+            leaf_ms->dbid = target->id;
+            next_leaf++;
+
+            if (run == 0) {
+                link.leafOff = leaf_off;
+                link.leaf = next_leaf - 1;
+                links.push_back(link);
+                continue;
+            }
+        }
+
+        ExportNode en = { node, target, run, (new_arity == 0),
+                          next_leaf - (new_arity == 0), next_leaf,
+                          NO_EXPORT_NODE, NO_EXPORT_NODE, 0, leaf_off,
+                          0, false, 0, 0 };
+        link.child = nodes.size();
+        links.push_back(link);
+        if (top.lastChild == NO_EXPORT_NODE) {
+            nodes[top.exportNode].firstChild = link.child;
         } else {
-            inode_t *parent_inode = NULL;
-            int parent_slot;
-            memsector_off_t off;
-            int tok_arity = top_curr->first.second;
-            int new_arity = arity + tok_arity - 1;
-
-            // check if a parent inode exists
-            if (!ms_nodes_stack.empty()) {
-                parent_inode = ms_nodes_stack.top().first;
-                parent_slot = ms_nodes_stack.top().second;
-                ms_nodes_stack.top().second++;
+            nodes[top.lastChild].nextSibling = link.child;
+        }
+        top.lastChild = link.child;
+        nodes.push_back(en);
+
+        if (new_arity > 0) {
+            ExportFrame frame = { target->children.begin(),
+                                  target->children.end(), new_arity,
+                                  link.child, 0, NO_EXPORT_NODE };
+            frames.push(frame);
+        }
+    }
+    assert(next_leaf == num_leaves);
+
+    // rank the tokens of the path nodes by frequency for the token table of
+    // compact path nodes
+    const bool compact = (encoding == EXPORT_ENCODING_COMPACT);
+    map<uint32_t, uint32_t> ranks;
+    if (compact) {
+        for (size_t i = 0; i < nodes.size(); i++) {
+            MwsIndexNode* node = nodes[i].head;
+            for (uint32_t j = 0; j < nodes[i].run; j++) {
+                _MapType::iterator it = node->children.begin();
+                ranks[encoded_token_key(encoded_token(it->first.first,
+                                                      it->first.second))]++;
+                node = it->second;
             }
+        }
+        vector<pair<uint32_t, uint32_t> > byFrequency;
+        map<uint32_t, uint32_t>::iterator it;
+        for (it = ranks.begin(); it != ranks.end(); it++) {
+            byFrequency.push_back(make_pair(it->second, it->first));
+        }
+        sort(byFrequency.rbegin(), byFrequency.rend());
+        for (uint32_t rank = 0; rank < byFrequency.size(); rank++) {
+            ranks[byFrequency[rank].second] = rank;
+        }
+    }
+
+    // size the nodes: compact inodes start from an upper bound, which
+    // shrinks once the offsets of their children are known
+    uint8_t entry[INODE_COMPACT_ENTRY_MAX_SIZE];
+    for (size_t i = 0; i < nodes.size(); i++) {
+        ExportNode& en = nodes[i];
+        en.pathSize = pnode_sizeof(en.run);
+        if (compact && en.run > 0) {
+            uint64_t runSize = 0;
+            MwsIndexNode* node = en.head;
+            for (uint32_t j = 0; j < en.run; j++) {
+                _MapType::iterator it = node->children.begin();
+                runSize += varint_encode(entry, ranks[encoded_token_key(
+                        encoded_token(it->first.first, it->first.second))]);
+                node = it->second;
+            }
+            en.pathSize = pnode_compact_sizeof(runSize);
+        }
+        if (en.isLeaf) continue;
+
+        // variables (arity 0, smallest ids) come first
+        _MapType::iterator it;
+        for (it = en.node->children.begin();
+             it != en.node->children.end() && it->first.first <= VAR_ID_MAX;
+             it++) {
+            en.numVars++;
+        }
+        uint32_t num_consts = en.node->children.size() - en.numVars;
+        en.compact = (compact && num_consts <= INODE_COMPACT_MAX_SIZE);
+        en.inodeSize = en.compact ?
+                inode_compact_sizeof(en.numVars, num_consts *
+                                     INODE_COMPACT_ENTRY_MAX_SIZE) :
+                inode_sizeof(en.node->children.size());
+    }
 
-            if (new_arity == 0) {   // leaf node
-                MwsIndexNode* leaf = top_curr->second;
-
-                assert(new_arity == 0);
-
-                // copy leaf node to memsector
-                off = leaf_alloc(alloc);
-                leaf_t *leaf_ms = (leaf_t*) memsector_off2addr(alloc, off);
-                leaf_ms->type = LEAF_NODE;
-                leaf_ms->num_hits = leaf->solutions;
-                leaf_ms->dbid = leaf->id;
-
-            } else {                // intermediary node
-                MwsIndexNode* node = top_curr->second;
-
-                assert(new_arity > 0);
-
-                // copy index node to memsector
-                off = inode_alloc(alloc, node->children.size());
-                inode_t *inode = (inode_t*) memsector_off2addr(alloc, off);
-                inode->type = INTERNAL_NODE;
-                inode->size = node->children.size();
-                
-                // save in stacks
-                ms_nodes_stack.push(make_pair(inode, 0));
-                nodes_stack.push(make_pair(make_pair(node->children.begin(),
-                                                     node->children.end()),
-                                           new_arity));
+    // order the nodes, starting with the root which has to follow the index
+    // header
+    vector<uint32_t> order;
+    order.reserve(nodes.size());
+    switch (layout) {
+    case EXPORT_LAYOUT_DFS: {
+        // the plan is in DFS order
+        for (size_t i = 0; i < nodes.size(); i++) {
+            order.push_back(i);
+        }
+        break;
+    }
+
+    case EXPORT_LAYOUT_BLOCKS: {
+        // breadth first from the root of each block, until the block fills
+        // its page; the nodes left over become the roots of the next blocks
+        uint64_t offset = alloc->curr_offset;
+        deque<uint32_t> blockRoots(1, 0);
+        while (!blockRoots.empty()) {
+            deque<uint32_t> queue(1, blockRoots.front());
+            blockRoots.pop_front();
+            uint64_t page = offset / MEMSECTOR_LAYOUT_BLOCK_SIZE;
+
+            while (!queue.empty()) {
+                if (offset / MEMSECTOR_LAYOUT_BLOCK_SIZE != page) {
+                    blockRoots.insert(blockRoots.end(), queue.begin(),
+                                      queue.end());
+                    break;
+                }
+                uint32_t n = queue.front();
+                queue.pop_front();
+                order.push_back(n);
+                offset += nodes[n].space();
+                for (uint32_t c = nodes[n].firstChild; c != NO_EXPORT_NODE;
+                     c = nodes[c].nextSibling) {
+                    queue.push_back(c);
+                }
             }
+        }
+        break;
+    }
+
+    case EXPORT_LAYOUT_HOT: {
+        // best first by access count, such that the hottest nodes share the
+        // first pages; nodes no query reached stay in DFS order at the end
+        assert(accessCounts != NULL);
+        vector<bool> ordered(nodes.size(), false);
+        priority_queue<pair<uint64_t, uint32_t> > queue;
+        queue.push(make_pair(getAccessCount(accessCounts, this), 0));
+        while (!queue.empty()) {
+            uint32_t n = queue.top().second;
+            queue.pop();
+            order.push_back(n);
+            ordered[n] = true;
+            for (uint32_t c = nodes[n].firstChild; c != NO_EXPORT_NODE;
+                 c = nodes[c].nextSibling) {
+                uint64_t count = getAccessCount(accessCounts, nodes[c].head);
+                if (count > 0) queue.push(make_pair(count, c));
+            }
+        }
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (!ordered[i]) order.push_back(i);
+        }
+        break;
+    }
+    }
 
-            // store link in parent
-            if (parent_inode != NULL) {
-                encoded_token_dict_entry_t entry;
+    // compact inodes refer to their children relative to their own offset,
+    // so their sizes depend on the offsets: shrink them until the offsets are
+    // stable (children follow their parents, so offset deltas only shrink)
+    vector<uint64_t> entriesSize(nodes.size());
+    vector<uint32_t> prevKey(nodes.size());
+    bool resized = true;
+    uint64_t offset = 0;
+    while (resized) {
+        offset = alloc->curr_offset;
+        for (size_t i = 0; i < order.size(); i++) {
+            nodes[order[i]].place(&offset);
+        }
 
-                entry.token = encoded_token(top_curr->first.first,
-                                            top_curr->first.second);
-                entry.off = off;
+        fill(entriesSize.begin(), entriesSize.end(), 0);
+        fill(prevKey.begin(), prevKey.end(), 0);
+        for (size_t i = 0; i < links.size(); i++) {
+            const ExportLink& link = links[i];
+            const ExportNode& parent = nodes[link.parent];
+            if (!parent.compact || encoded_token_is_var(link.token)) continue;
+
+            uint64_t ref = parent.compactRef((link.child != NO_EXPORT_NODE) ?
+                                             &nodes[link.child] : NULL,
+                                             link.leaf);
+            entriesSize[link.parent] += inode_compact_encode_entry(
+                        entry, prevKey[link.parent], link.token, ref);
+            prevKey[link.parent] = encoded_token_key(link.token);
+        }
 
-                parent_inode->data[parent_slot] = entry;
+        resized = false;
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (!nodes[i].compact) continue;
+            uint64_t size = inode_compact_sizeof(nodes[i].numVars,
+                                                 entriesSize[i]);
+            if (memsector_align(size) != memsector_align(nodes[i].inodeSize)) {
+                resized = true;
             }
+            nodes[i].inodeSize = size;
+        }
+    }
+
+    // offsets past the largest memsector were truncated when planned
+    if (offset > MEMSECTOR_MAX_SIZE) return -1;
+
+    // allocate the nodes at the offsets planned
+    for (size_t i = 0; i < order.size(); i++) {
+        ExportNode* en = &nodes[order[i]];
+        memsector_off_t planned = en->off;
+        if (allocExportNode(mswr, en, compact ? &ranks : NULL) != 0 ||
+                en->off != planned) {
+            return -1;
+        }
+    }
+
+    // store the links in the parents
+    fill(entriesSize.begin(), entriesSize.end(), 0);
+    fill(prevKey.begin(), prevKey.end(), 0);
+    for (size_t i = 0; i < links.size(); i++) {
+        const ExportLink& link = links[i];
+        const ExportNode& parent = nodes[link.parent];
+        inode_t* inode = (inode_t*)
+                memsector_off2addr(alloc, parent.nodeOff);
+
+        if (parent.compact && !encoded_token_is_var(link.token)) {
+            // links of a parent are in slot order
+            uint8_t* out = (uint8_t*) inode_compact_entries(inode) +
+                    entriesSize[link.parent];
+            uint64_t ref = parent.compactRef((link.child != NO_EXPORT_NODE) ?
+                                             &nodes[link.child] : NULL,
+                                             link.leaf);
+            entriesSize[link.parent] += inode_compact_encode_entry(
+                        out, prevKey[link.parent], link.token, ref);
+            prevKey[link.parent] = encoded_token_key(link.token);
+            continue;
+        }
+
+        inode->data[link.slot].token = link.token;
+        inode->data[link.slot].off = (link.child != NO_EXPORT_NODE) ?
+                nodes[link.child].off : link.leafOff;
+    }
 
-            top_curr++;
+    // all links to children stored => rearrange children for lookup
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (!nodes[i].isLeaf && !nodes[i].compact) {
+            inode_build_layout((inode_t*)
+                               memsector_off2addr(alloc, nodes[i].nodeOff));
         }
     }
+
+    // token table of the compact path nodes
+    index_header->tokens_off = 0;
+    index_header->num_tokens = ranks.size();
+    if (!ranks.empty()) {
+        index_header->tokens_off =
+                mswr_alloc(mswr, ranks.size() * sizeof(encoded_token_t));
+        if (index_header->tokens_off == 0) return -1;
+        encoded_token_t* tokens = (encoded_token_t*)
+                memsector_off2addr(alloc, index_header->tokens_off);
+        map<uint32_t, uint32_t>::iterator it;
+        for (it = ranks.begin(); it != ranks.end(); it++) {
+            tokens[it->second] = encoded_token_from_key(it->first);
+        }
+    }
+
+    return 0;
 }
 
 }
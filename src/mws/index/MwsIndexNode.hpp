@@ -31,6 +31,8 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
   *
   */
 
+#include <atomic>
+#include <map>
 #include <stack>
 #include <utility>
 
@@ -45,20 +47,48 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 namespace mws
 {
 
+class MwsIndexNode;
+
+/// Number of visits of each index node while answering queries
+typedef std::map<const MwsIndexNode*, uint64_t> AccessCounts;
+
+/// Order of the nodes in an exported memsector
+enum ExportLayout {
+    /// depth first, subtrees stored contiguously
+    EXPORT_LAYOUT_DFS,
+    /// breadth first within page sized blocks, such that the top levels of
+    /// every subtree share a few pages
+    EXPORT_LAYOUT_BLOCKS,
+    /// most accessed nodes first, unaccessed subtrees depth first at the end
+    EXPORT_LAYOUT_HOT
+};
+
+/// Encoding of the internal nodes of an exported memsector
+enum ExportEncoding {
+    /// fixed size entries, searched in O(log n)
+    EXPORT_ENCODING_FIXED,
+    /// narrow nodes with varint encoded entries (INODE_LAYOUT_COMPACT)
+    EXPORT_ENCODING_COMPACT
+};
+
 class MwsIndexNode
 {
     // Map to select children based on _MapKeyType
     typedef mws::VectorMap<NodeInfo, MwsIndexNode*> _MapType;
 
 private:
-    /// Id of the next node to be created
-    static unsigned long long nextNodeId;
+    /// Id of the last node created, which nodes are created with from
+    /// several threads (ingests, merges and reloads)
+    static std::atomic<unsigned long long> nextNodeId;
 public:
     /// Id of the MwsIndexNode
     const unsigned long long id;
     /// Number of solutions associated with this node
     unsigned int solutions;
 private:
+    /// Number of parents of this node, in the indexes sharing it (see
+    /// share())
+    std::atomic<uint32_t> refs;
     /// Map of children MwsIndex Nodes
     _MapType children;
 
@@ -73,6 +103,28 @@ public:
       */
     ~MwsIndexNode();
 
+    /**
+      * @brief Deep copy of the index rooted at this node, keeping the ids
+      * @return copy to be deleted by the caller
+      */
+    MwsIndexNode* clone() const;
+
+    /**
+      * @brief Copy of this node sharing its children, which insertData()
+      * copies when it changes them, such that the other indexes sharing
+      * them are left as they are. The shared nodes are freed with the last
+      * index using them. Indexes sharing nodes may be read and freed from
+      * several threads, and changed by one at a time.
+      * @return copy to be deleted by the caller
+      */
+    MwsIndexNode* share() const;
+
+    /**
+      * @brief Make sure nodes created from now on have ids above maxId
+      * @param maxId largest id used by an index loaded from elsewhere
+      */
+    static void reserveIds(unsigned long long maxId);
+
     /**
       * @brief Method to insert data into the Index Tree
       * @param expression is the CmmlToken to be indexed.
@@ -80,12 +132,97 @@ public:
       * into the database
       * @param url is the address to be linked to the respective expression
       * @param xpath is the xpath to be linked to the respective expression
-      * @return leaf node corresponding to the inserted expression
+      * @return leaf node corresponding to the inserted expression, which is
+      * not shared with other indexes (see share())
       */
     MwsIndexNode* insertData(const types::CmmlToken *expression,
                              types::MeaningDictionary *meaningDictionary);
 
-    void exportToMemsector(memsector_writer_t* mswr);
+    /**
+      * @brief Method to export the index to a memsector
+      * @param mswr is the writer of the memsector
+      * @param layout is the order of the nodes in the memsector
+      * @param accessCounts are the node access counts EXPORT_LAYOUT_HOT is
+      * based on (see SearchContext::setAccessCounts)
+      * @param encoding is the encoding of the internal nodes
+      * @return 0 on success, -1 if the memsector could not grow or the
+      * index does not fit in the largest memsector (MEMSECTOR_MAX_SIZE)
+      */
+    int exportToMemsector(memsector_writer_t* mswr,
+                          ExportLayout layout = EXPORT_LAYOUT_DFS,
+                          const AccessCounts* accessCounts = NULL,
+                          ExportEncoding encoding = EXPORT_ENCODING_FIXED);
+
+    /**
+      * @brief Import the index exported to a memsector, keeping the ids of
+      * its formulae
+      * @return index to be deleted by the caller
+      */
+    static MwsIndexNode* importFromMemsector(const index_handle_t* index);
+
+    /**
+      * @brief Merge a copy of another index into the one rooted at this node.
+      * Formulae present in both keep the id they have here and add up their
+      * solutions.
+      * @param renamed is where to record the id the formulae of other
+      * present in both are merged into (or NULL).
+      */
+    void merge(const MwsIndexNode* other,
+               std::map<FormulaId, FormulaId>* renamed = NULL);
+
+    /**
+      * @brief Remove solutions from the leaves of the index rooted at this
+      * node, dropping the leaves left without solutions and the subtrees
+      * left without leaves.
+      * @param hits is the number of solutions to remove from each leaf.
+      * @return false if this node is left without solutions.
+      */
+    bool removeHits(const std::map<FormulaId, uint32_t>& hits);
+
+    /**
+      * @return number of leaves of the index rooted at this node
+      */
+    uint32_t countLeaves();
+
+private:
+    /**
+      * @brief Constructor of a copy of a node
+      */
+    explicit MwsIndexNode(unsigned long long id);
+
+    /**
+      * @brief Drop a reference to a node, which is deleted with its last one
+      */
+    static void release(MwsIndexNode* node);
+
+    /**
+      * @brief Import the subtree rooted at a node of a memsector
+      */
+    static MwsIndexNode* importNode(const index_handle_t* index,
+                                    const inode_t* inode);
+
+    /// Node planned for export (internal node or leaf, maybe behind a path)
+    struct ExportNode;
+    /// DFS step of the export plan
+    struct ExportFrame;
+
+    /**
+      * @brief Allocate an exported node (and the path node leading to it)
+      * @param ranks of the token keys in the token table, if the path node
+      * is compact (NULL otherwise)
+      * @return 0 on success, -1 if the memsector could not grow or the
+      * index does not fit in the largest memsector (MEMSECTOR_MAX_SIZE)
+      */
+    static int allocExportNode(memsector_writer_t* mswr, ExportNode* node,
+                               const std::map<uint32_t, uint32_t>* ranks);
+
+    /**
+      * @return number of nodes with a single constant child below node,
+      * which is reached with the given remaining arity, at most
+      * PNODE_MAX_SIZE
+      */
+    static uint32_t getUnaryChainLength(MwsIndexNode* node, int arity);
+
     // Friend declarations
     friend struct SearchContext;
     friend struct qvarCtxt;
@@ -0,0 +1,108 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+  * @file Partition.cpp
+  * @brief Parts of an index split by the first tokens of the expressions
+  * @date 19 Oct 2026
+  */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <stack>
+
+#include "Partition.hpp"
+#include "common/utils/ToString.hpp"
+
+using namespace std;
+using namespace mws::types;
+
+namespace mws { namespace index {
+
+namespace {
+
+/**
+ * @brief Hash the meaning and arity of the first numTokens tokens of
+ * expression (FNV-1a, to be the same on every host)
+ * @param hasQvar set if one of them is a query variable
+ */
+uint32_t hashPrefix(const CmmlToken* expression, unsigned numTokens,
+                    bool* hasQvar) {
+    stack<const CmmlToken*> tokens;
+    uint32_t hash = 2166136261u;
+
+    *hasQvar = false;
+    tokens.push(expression);
+    for (unsigned i = 0; i < numTokens && !tokens.empty(); i++) {
+        const CmmlToken* token = tokens.top();
+        tokens.pop();
+        for (auto rIt  = token->getChildNodes().rbegin();
+             rIt != token->getChildNodes().rend();
+             rIt++) {
+            tokens.push(*rIt);
+        }
+
+        if (token->isQvar()) *hasQvar = true;
+        const string key = token->getMeaning() + "/" +
+                ToString(token->getChildNodes().size()) + ";";
+        for (char c : key) {
+            hash = (hash ^ (unsigned char) c) * 16777619u;
+        }
+    }
+
+    return hash;
+}
+
+}  // namespace
+
+int
+Partition::parse(const string& str) {
+    char* end;
+
+    index = strtoul(str.c_str(), &end, 10);
+    if (end == str.c_str() || *end != '/') return -1;
+    count = strtoul(end + 1, &end, 10);
+    if (*end != '\0' || count == 0 || index >= count) return -1;
+
+    return 0;
+}
+
+bool
+Partition::contains(const CmmlToken* expression) const {
+    bool hasQvar;
+
+    if (count <= 1) return true;
+    // query variables of the harvests are indexed as constants
+    return hashPrefix(expression, numTokens, &hasQvar) % count == index;
+}
+
+int
+Partition::route(const CmmlToken* query, unsigned count,
+                 unsigned numTokens) {
+    bool hasQvar;
+
+    if (count <= 1) return 0;
+    uint32_t hash = hashPrefix(query, numTokens, &hasQvar);
+
+    return hasQvar ? -1 : (int) (hash % count);
+}
+
+} }
@@ -0,0 +1,76 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef _MWS_INDEX_PARTITION_HPP
+#define _MWS_INDEX_PARTITION_HPP
+
+/**
+  * @file Partition.hpp
+  * @brief Parts of an index split by the first tokens of the expressions
+  * @date 19 Oct 2026
+  */
+
+#include <string>
+
+#include "mws/types/CmmlToken.hpp"
+
+namespace mws { namespace index {
+
+/**
+ * @brief Part of an index which is split between several mwsd, by the
+ * first tokens of the expressions.
+ *
+ * The tokens of an expression are inserted in the index in preorder (the
+ * head symbol, then its first argument), so the subtrees of the different
+ * prefixes are disjoint, and a query only matches the expressions starting
+ * with the same tokens as the query. Such queries are routed to the
+ * partition of their prefix, the ones with a query variable among their
+ * first tokens are sent to all the partitions.
+ */
+struct Partition {
+    /// partition indexed, from 0 to count - 1
+    unsigned index;
+    /// number of partitions (1 if the index is not split)
+    unsigned count;
+    /// number of tokens of the prefix the partitions are chosen by
+    unsigned numTokens;
+
+    Partition() : index(0), count(1), numTokens(1) {}
+
+    /**
+     * @brief parse a partition given as "index/count"
+     * @return 0 on success, -1 on failure
+     */
+    int parse(const std::string& str);
+
+    /// @return true if expression is indexed in this partition
+    bool contains(const types::CmmlToken* expression) const;
+
+    /**
+     * @return the partition holding all the expressions matching query, or
+     * -1 if it can match expressions of any partition
+     */
+    static int route(const types::CmmlToken* query, unsigned count,
+                     unsigned numTokens);
+};
+
+} }
+
+#endif // _MWS_INDEX_PARTITION_HPP
@@ -0,0 +1,248 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+  * @file Tombstones.cpp
+  * @brief Deleted documents and the formula hits they take out of the index
+  * @date 19 Oct 2026
+  */
+
+#include "Tombstones.hpp"
+
+using namespace std;
+
+namespace mws { namespace index {
+
+namespace {
+
+/// Renamed id of a leaf
+FormulaId renamed(const map<FormulaId, FormulaId>& renamedLeaves,
+                  FormulaId formulaId) {
+    map<FormulaId, FormulaId>::const_iterator it =
+            renamedLeaves.find(formulaId);
+    return (it != renamedLeaves.end()) ? it->second : formulaId;
+}
+
+void writeUint32(ostream& out, uint32_t value) {
+    out.write((const char*) &value, sizeof(value));
+}
+
+bool readUint32(istream& in, uint32_t* value) {
+    return (bool) in.read((char*) value, sizeof(*value));
+}
+
+}  // namespace
+
+Tombstones::Tombstones() {
+    pthread_rwlock_init(&m_lock, NULL);
+}
+
+Tombstones::Tombstones(const Tombstones& other) {
+    pthread_rwlock_init(&m_lock, NULL);
+
+    pthread_rwlock_rdlock(&other.m_lock);
+    m_documentIds = other.m_documentIds;
+    m_occurrences = other.m_occurrences;
+    m_dead = other.m_dead;
+    m_deadHits = other.m_deadHits;
+    pthread_rwlock_unlock(&other.m_lock);
+}
+
+Tombstones::~Tombstones() {
+    pthread_rwlock_destroy(&m_lock);
+}
+
+void
+Tombstones::addOccurrence(const string& uri, FormulaId formulaId) {
+    pthread_rwlock_wrlock(&m_lock);
+    pair<map<string, DocumentId>::iterator, bool> ret =
+            m_documentIds.insert(make_pair(uri, m_occurrences.size()));
+    DocumentId documentId = ret.first->second;
+    if (ret.second) {
+        m_occurrences.resize(documentId + 1);
+        m_dead.push_back(false);
+    } else if (m_dead[documentId]) {
+        // the hits of the deleted version stay dead
+        m_occurrences[documentId].clear();
+        m_dead[documentId] = false;
+    }
+    m_occurrences[documentId].push_back(formulaId);
+    pthread_rwlock_unlock(&m_lock);
+}
+
+int
+Tombstones::removeDocument(const string& uri) {
+    int numHits = -1;
+
+    pthread_rwlock_wrlock(&m_lock);
+    map<string, DocumentId>::iterator it = m_documentIds.find(uri);
+    if (it != m_documentIds.end() && !m_dead[it->second]) {
+        vector<FormulaId>& occurrences = m_occurrences[it->second];
+        for (FormulaId formulaId : occurrences) {
+            m_deadHits[formulaId]++;
+        }
+        numHits = occurrences.size();
+        m_dead[it->second] = true;
+    }
+    pthread_rwlock_unlock(&m_lock);
+
+    return numHits;
+}
+
+map<FormulaId, uint32_t>
+Tombstones::getDeadHits() const {
+    pthread_rwlock_rdlock(&m_lock);
+    map<FormulaId, uint32_t> deadHits = m_deadHits;
+    pthread_rwlock_unlock(&m_lock);
+
+    return deadHits;
+}
+
+shared_ptr<const DeadHits>
+Tombstones::copyDeadHits() const {
+    pthread_rwlock_rdlock(&m_lock);
+    shared_ptr<const DeadHits> deadHits = make_shared<DeadHits>(m_deadHits);
+    pthread_rwlock_unlock(&m_lock);
+
+    return deadHits;
+}
+
+void
+Tombstones::compact(const map<FormulaId, uint32_t>& removedHits,
+                    const map<FormulaId, FormulaId>& renamedLeaves) {
+    pthread_rwlock_wrlock(&m_lock);
+    map<FormulaId, uint32_t> deadHits;
+    for (auto& entry : m_deadHits) {
+        map<FormulaId, uint32_t>::const_iterator it =
+                removedHits.find(entry.first);
+        uint32_t removed = (it != removedHits.end()) ? it->second : 0;
+        if (entry.second > removed) {
+            deadHits[renamed(renamedLeaves, entry.first)] +=
+                    entry.second - removed;
+        }
+    }
+    m_deadHits.swap(deadHits);
+
+    for (DocumentId documentId = 0; documentId < m_occurrences.size();
+         documentId++) {
+        vector<FormulaId>& occurrences = m_occurrences[documentId];
+        if (m_dead[documentId]) {
+            // the hits are either removed or counted dead already
+            vector<FormulaId>().swap(occurrences);
+            continue;
+        }
+        for (FormulaId& formulaId : occurrences) {
+            formulaId = renamed(renamedLeaves, formulaId);
+        }
+    }
+    pthread_rwlock_unlock(&m_lock);
+}
+
+int
+Tombstones::load(istream& in) {
+    string uri;
+    uint32_t numDocuments, uriLength, dead, numOccurrences, formulaId;
+    uint32_t numDeadHits, hits;
+
+    // URIs may be empty, so documents are counted rather than terminated
+    if (!readUint32(in, &numDocuments)) return -1;
+    for (uint32_t d = 0; d < numDocuments; d++) {
+        if (!readUint32(in, &uriLength)) return -1;
+        uri.resize(uriLength);
+        if (uriLength > 0 && !in.read(&uri[0], uriLength)) return -1;
+        if (!readUint32(in, &dead) || !readUint32(in, &numOccurrences)) {
+            return -1;
+        }
+        for (uint32_t i = 0; i < numOccurrences; i++) {
+            if (!readUint32(in, &formulaId)) return -1;
+            addOccurrence(uri, formulaId);
+        }
+        if (dead) {
+            if (numOccurrences == 0) addOccurrence(uri, 0);
+            pthread_rwlock_wrlock(&m_lock);
+            m_occurrences[m_documentIds[uri]].clear();
+            m_dead[m_documentIds[uri]] = true;
+            pthread_rwlock_unlock(&m_lock);
+        }
+    }
+    if (!readUint32(in, &numDeadHits)) return -1;
+    pthread_rwlock_wrlock(&m_lock);
+    for (uint32_t i = 0; i < numDeadHits; i++) {
+        if (!readUint32(in, &formulaId) || !readUint32(in, &hits)) {
+            pthread_rwlock_unlock(&m_lock);
+            return -1;
+        }
+        m_deadHits[formulaId] += hits;
+    }
+    pthread_rwlock_unlock(&m_lock);
+
+    return 0;
+}
+
+int
+Tombstones::save(ostream& out, FormulaId maxFormulaId) const {
+    vector<FormulaId> occurrences;
+    uint32_t numDocuments = 0;
+    uint32_t numDeadHits = 0;
+
+    pthread_rwlock_rdlock(&m_lock);
+    for (auto& entry : m_documentIds) {
+        if (isSaved(entry.second, maxFormulaId)) numDocuments++;
+    }
+    writeUint32(out, numDocuments);
+    for (auto& entry : m_documentIds) {
+        if (!isSaved(entry.second, maxFormulaId)) continue;
+        occurrences.clear();
+        for (FormulaId formulaId : m_occurrences[entry.second]) {
+            if (formulaId <= maxFormulaId) occurrences.push_back(formulaId);
+        }
+
+        writeUint32(out, entry.first.size());
+        out.write(entry.first.data(), entry.first.size());
+        writeUint32(out, m_dead[entry.second]);
+        writeUint32(out, occurrences.size());
+        for (FormulaId formulaId : occurrences) writeUint32(out, formulaId);
+    }
+
+    for (auto& entry : m_deadHits) {
+        if (entry.first <= maxFormulaId) numDeadHits++;
+    }
+    writeUint32(out, numDeadHits);
+    for (auto& entry : m_deadHits) {
+        if (entry.first > maxFormulaId) continue;
+        writeUint32(out, entry.first);
+        writeUint32(out, entry.second);
+    }
+    pthread_rwlock_unlock(&m_lock);
+
+    return out ? 0 : -1;
+}
+
+bool
+Tombstones::isSaved(DocumentId documentId, FormulaId maxFormulaId) const {
+    if (m_dead[documentId]) return true;
+    for (FormulaId formulaId : m_occurrences[documentId]) {
+        if (formulaId <= maxFormulaId) return true;
+    }
+
+    return false;
+}
+
+} }
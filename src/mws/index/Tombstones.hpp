@@ -0,0 +1,152 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef _MWS_INDEX_TOMBSTONES_HPP
+#define _MWS_INDEX_TOMBSTONES_HPP
+
+/**
+  * @file Tombstones.hpp
+  * @brief Deleted documents and the formula hits they take out of the index
+  * @date 19 Oct 2026
+  */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <istream>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mws/types/NodeInfo.hpp"
+
+namespace mws { namespace index {
+
+/**
+ * @brief Copy of the hits taken out by deleted documents, which queries
+ * read without locking: it never changes once made, and deleting more
+ * documents makes a new copy (see Tombstones::copyDeadHits()).
+ */
+class DeadHits {
+    std::unordered_map<FormulaId, uint32_t> m_hits;
+
+public:
+    explicit DeadHits(const std::map<FormulaId, uint32_t>& hits) :
+        m_hits(hits.begin(), hits.end()) {}
+
+    /**
+     * @param numHits hits of the leaf in the index
+     * @return hits of the leaf which are not in deleted documents
+     */
+    uint32_t getLiveHits(FormulaId formulaId, uint32_t numHits) const {
+        if (m_hits.empty()) return numHits;
+        std::unordered_map<FormulaId, uint32_t>::const_iterator it =
+                m_hits.find(formulaId);
+        if (it == m_hits.end()) return numHits;
+        return (numHits > it->second) ? numHits - it->second : 0;
+    }
+};
+
+/**
+ * @brief Documents indexed so far, and the ones deleted since the index was
+ * built.
+ *
+ * Every formula hit of the index is an occurrence in a document (identified
+ * by the URI given in the harvest). Deleting a document marks it dead in a
+ * bitmap and takes its occurrences off the hits of their leaves, such that a
+ * leaf whose hits are all dead is no longer a solution. The leaves stay in
+ * the index until compact() is called after they were physically removed
+ * (see MwsIndexNode::removeHits()).
+ *
+ * All the methods are thread safe. Queries do not read the dead hits from
+ * here, but from a DeadHits copy published with the index they search, such
+ * that they never wait for deletions.
+ */
+class Tombstones {
+public:
+    typedef uint32_t DocumentId;
+
+private:
+    mutable pthread_rwlock_t                m_lock;
+    std::map<std::string, DocumentId>       m_documentIds;
+    /// occurrences of each document, by DocumentId
+    std::vector<std::vector<FormulaId> >    m_occurrences;
+    std::vector<bool>                       m_dead;
+    /// hits of the leaves taken out by dead documents
+    std::map<FormulaId, uint32_t>           m_deadHits;
+
+public:
+    Tombstones();
+    Tombstones(const Tombstones& other);
+    ~Tombstones();
+
+    /**
+     * @brief record a hit of formulaId in a document, which is revived if
+     * it was deleted (updated documents are deleted and harvested again)
+     */
+    void addOccurrence(const std::string& uri, FormulaId formulaId);
+
+    /**
+     * @brief delete a document
+     * @return number of hits taken out, or -1 if the document is unknown or
+     * already deleted
+     */
+    int removeDocument(const std::string& uri);
+
+    /// @return hits taken out of each leaf so far
+    std::map<FormulaId, uint32_t> getDeadHits() const;
+
+    /// @return hits taken out so far, to be read by queries without locking
+    std::shared_ptr<const DeadHits> copyDeadHits() const;
+
+    /**
+     * @brief forget the hits which were removed from the index, and rename
+     * the leaves which were folded into others
+     * @param removedHits hits removed from each leaf (by old id)
+     * @param renamedLeaves new id of the leaves folded into others
+     */
+    void compact(const std::map<FormulaId, uint32_t>& removedHits,
+                 const std::map<FormulaId, FormulaId>& renamedLeaves);
+
+    /**
+     * @brief load documents saved by save()
+     * @return 0 on success, -1 on failure
+     */
+    int load(std::istream& in);
+
+    /**
+     * @brief save the documents whose occurrences are in an index with
+     * formula ids up to maxFormulaId
+     * @return 0 on success, -1 on failure
+     */
+    int save(std::ostream& out, FormulaId maxFormulaId) const;
+
+private:
+    /// @return whether save() keeps a document (called with m_lock held)
+    bool isSaved(DocumentId documentId, FormulaId maxFormulaId) const;
+
+    Tombstones& operator=(const Tombstones&);
+};
+
+} }
+
+#endif // _MWS_INDEX_TOMBSTONES_HPP
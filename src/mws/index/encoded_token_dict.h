@@ -48,6 +48,10 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 #define QVAR_ID_MIN     32
 #define QVAR_ID_MAX     63
 #define VAR_ID_MAX      63
+/** Constant ids start after the variable ids */
+#define CONST_ID_MIN    (VAR_ID_MAX + 1)
+/** Largest arity of an encoded_token_t */
+#define ARITY_MAX       255
 
 /*--------------------------------------------------------------------------*/
 /* Type declarations                                                        */
@@ -137,6 +141,20 @@ bool encoded_token_is_var(encoded_token_t token) {
     return (token.id <= VAR_ID_MAX);
 }
 
+/**
+ * @brief numeric sort key of a token, ordered by (arity, id) like the
+ * children of MwsIndexNode
+ */
+static inline
+uint32_t encoded_token_key(encoded_token_t token) {
+    return ((uint32_t) token.arity << 24) | token.id;
+}
+
+static inline
+encoded_token_t encoded_token_from_key(uint32_t key) {
+    return encoded_token(key & 0xFFFFFF, key >> 24);
+}
+
 END_DECLS
 
 #endif // __MWS_INDEX_ENCODED_TOKEN_DICT_H
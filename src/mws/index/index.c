@@ -18,10 +18,66 @@ You should have received a copy of the GNU General Public License
 along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 
 */
-#include "index.h"
+/**
+ * @brief   Compact index data structure
+ * @file    index.c
+ * @date    24 Jan 2013
+ *
+ * License: GPLv3
+ */
 
-int g;
+// System includes
 
-void test(void) {
-    g = 2;
+#include <stdlib.h>
+#include <string.h>
+
+// Local includes
+
+#include "mws/index/index.h"
+
+/*--------------------------------------------------------------------------*/
+/* Implementation                                                           */
+/*--------------------------------------------------------------------------*/
+
+void inode_build_layout(inode_t* inode) {
+    const uint32_t n = inode->num_consts;
+    char* consts = (char*) inode->data +
+            inode->num_vars * sizeof(encoded_token_dict_entry_t);
+    encoded_token_dict_entry_t* sorted;
+    uint32_t* keys;
+    memsector_off_t* offs;
+    uint32_t i, k;
+
+    inode->layout = INODE_LAYOUT_SORTED;
+    if (n < INODE_EYTZINGER_MIN_SIZE) return;
+
+    sorted = malloc(n * sizeof(encoded_token_dict_entry_t));
+    if (sorted == NULL) return;  /* sorted layout is still valid */
+    memcpy(sorted, consts, n * sizeof(encoded_token_dict_entry_t));
+
+    keys = (uint32_t*) consts;  /* nodes are 4-byte aligned */
+    offs = (memsector_off_t*) keys + n;
+    for (i = 0, k = eytzinger_first(n); i < n; i++, k = eytzinger_next(k, n)) {
+        keys[k - 1] = encoded_token_key(sorted[i].token);
+        offs[k - 1] = sorted[i].off;
+    }
+    inode->layout = INODE_LAYOUT_EYTZINGER;
+
+    free(sorted);
+}
+
+uint32_t inode_compact_encode_entry(uint8_t* out, uint32_t prev_key,
+                                    encoded_token_t token, uint64_t ref) {
+    const uint32_t key = encoded_token_key(token);
+    uint32_t size;
+
+    if ((key >> 24) != (prev_key >> 24)) {  /* arity changed */
+        size = varint_encode(out, (uint64_t) (key & 0xFFFFFF) << 1 | 1);
+        out[size++] = (uint8_t) (key >> 24);
+    } else {
+        size = varint_encode(out, (uint64_t) (key - prev_key) << 1);
+    }
+    size += varint_encode(out + size, ref);
+
+    return size;
 }
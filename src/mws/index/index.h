@@ -49,19 +49,84 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
  */
 typedef enum node_type_e {
     INTERNAL_NODE   = 1,
-    LEAF_NODE       = 2
+    LEAF_NODE       = 2,
+    PATH_NODE       = 3
 } node_type_t;
 
+/**
+ * @brief Layout of the constant children of an internal node
+ */
+typedef enum inode_layout_e {
+    /** (token, off) entries sorted by encoded_token_key() */
+    INODE_LAYOUT_SORTED     = 0,
+    /** token keys in Eytzinger (BFS) order, followed by the offsets */
+    INODE_LAYOUT_EYTZINGER  = 1,
+    /** varint encoded entries, see inode_compact_encode_entry() */
+    INODE_LAYOUT_COMPACT    = 2
+} inode_layout_t;
+
+/** Internal nodes with at least this many constant children use Eytzinger */
+#define INODE_EYTZINGER_MIN_SIZE    128
+/** Internal nodes with at most this many constant children may be compact */
+#define INODE_COMPACT_MAX_SIZE      16
+/** Upper bound of the bytes taken by an entry of a compact inode */
+#define INODE_COMPACT_ENTRY_MAX_SIZE    (4 + 1 + 5)
+/** Path nodes hold runs of at most this many tokens, longer chains are split
+ * such that a run always fits on the query engine stacks */
+#define PNODE_MAX_SIZE              64
+
 /**
  * @brief Internal index node
+ *
+ * Leaves are exported in DFS order to a separate dense array, such that the
+ * leaves of the subtree rooted at this node are [leaves_begin, leaves_end).
+ *
+ * data[] holds two sections: first the num_vars index variable children as
+ * sorted entries, then the num_consts constant children stored according to
+ * layout. Wide nodes keep their keys apart from the offsets such that a
+ * lookup only touches the keys, and in Eytzinger order such that the first
+ * levels of the search share cache lines. Narrow nodes may instead be
+ * compact: their constant section is a byte stream of varint encoded entries
+ * which is only scanned in order. Since decoding a compact entry requires
+ * the index it belongs to, use index_get_child() and inode_iter_t rather
+ * than data[] or the inode_get_child*() accessors of fixed size entries.
  */
 struct inode_s {
-    node_type_t type    : 2;  /* should be INTERNAL_NODE */
-    uint32_t    size    : 30;
+    node_type_t    type       : 2;  /* should be INTERNAL_NODE */
+    inode_layout_t layout     : 2;  /* layout of the constant section */
+    uint32_t       num_vars   : 28;
+    uint32_t       num_consts;
+    uint32_t       leaves_begin;
+    uint32_t       leaves_end;
     encoded_token_dict_entry_t data[];
 } PACKED;
 typedef struct inode_s inode_t;
 
+/**
+ * @brief Path index node
+ *
+ * Chain of nodes with a single constant child each, collapsed into the run of
+ * their tokens. The tokens are stored in query stack order (first token of
+ * the run last), such that the run compares in one go against the top of the
+ * query stack. next is the node the run leads to. leaves_begin and
+ * leaves_end are at the same offsets as in inode_t.
+ *
+ * The run of a compact path node is a byte stream of the varint ranks of its
+ * tokens in the token table of the index, which is ordered by decreasing
+ * frequency such that most tokens take a single byte. Use
+ * pnode_get_tokens() rather than tokens[] directly.
+ */
+struct pnode_s {
+    node_type_t     type    : 2;  /* should be PATH_NODE */
+    uint32_t        size    : 29;
+    uint32_t        compact : 1;
+    memsector_off_t next;
+    uint32_t        leaves_begin;
+    uint32_t        leaves_end;
+    encoded_token_t tokens[];
+} PACKED;
+typedef struct pnode_s pnode_t;
+
 /**
  * @brief Leaf index node
  */
@@ -76,12 +141,20 @@ typedef struct leaf_s leaf_t;
  * Index in-memory header
  */
 struct index_header_s {
-    inode_t  root;
+    memsector_off_t leaves_off;   /* offset of the dense leaf array */
+    uint32_t        num_leaves;
+    memsector_off_t tokens_off;   /* offset of the token table */
+    uint32_t        num_tokens;
+    inode_t         root;
 } PACKED;
 typedef struct index_header_s index_header_t;
 
 typedef struct index_handle_s {
     inode_t *root;
+    leaf_t  *leaves;
+    uint32_t num_leaves;
+    encoded_token_t *tokens;
+    uint32_t num_tokens;
     memsector_alloc_header_t *alloc;
 } index_handle_t;
 
@@ -91,60 +164,434 @@ typedef struct index_handle_s {
 
 BEGIN_DECLS
 
+/**
+ * @return bytes taken by an inode with size children
+ */
 static inline
-memsector_off_t inode_alloc(memsector_alloc_header_t* alloc, uint32_t size) {
-    return memsector_alloc(alloc, sizeof(inode_t) +
-                                  size * sizeof(encoded_token_dict_entry_t));
+uint64_t inode_sizeof(uint32_t size) {
+    return sizeof(inode_t) + (uint64_t) size * sizeof(encoded_token_dict_entry_t);
 }
 
+/**
+ * @return bytes taken by a path node with a run of size tokens
+ */
 static inline
-memsector_off_t leaf_alloc(memsector_alloc_header_t* alloc) {
-    return memsector_alloc(alloc, sizeof(leaf_t));
+uint64_t pnode_sizeof(uint32_t size) {
+    return sizeof(pnode_t) + (uint64_t) size * sizeof(encoded_token_t);
 }
 
+/**
+ * @return bytes taken by a compact path node with a run of run_size bytes
+ */
 static inline
-memsector_off_t inode_get_child(const inode_t* inode, encoded_token_t token) {
-    uint32_t left, right;
+uint64_t pnode_compact_sizeof(uint64_t run_size) {
+    return sizeof(pnode_t) + run_size;
+}
+
+/**
+ * @return bytes taken by the dense array of num_leaves leaves
+ */
+static inline
+uint64_t leaf_array_sizeof(uint32_t num_leaves) {
+    return (uint64_t) num_leaves * sizeof(leaf_t);
+}
+
+static inline
+uint32_t inode_get_num_leaves(const inode_t* inode) {
+    return inode->leaves_end - inode->leaves_begin;
+}
+
+/**
+ * @brief first position (1-based) of an in-order walk of an Eytzinger tree
+ */
+static inline
+uint32_t eytzinger_first(uint32_t n) {
+    uint32_t k = (n > 0);
+    while (2 * k <= n) k = 2 * k;
+
+    return k;
+}
+
+/**
+ * @brief in-order successor of position k (1-based) in an Eytzinger tree
+ * @return successor position or 0 if k is the last one
+ */
+static inline
+uint32_t eytzinger_next(uint32_t k, uint32_t n) {
+    if (2 * k + 1 <= n) {
+        k = 2 * k + 1;
+        while (2 * k <= n) k = 2 * k;
+        return k;
+    }
+    while (k & 1) k >>= 1;
+
+    return k >> 1;
+}
+
+static inline
+uint32_t inode_get_size(const inode_t* inode) {
+    return inode->num_vars + inode->num_consts;
+}
+
+/**
+ * @brief variable section: num_vars entries sorted by id
+ */
+static inline
+const encoded_token_dict_entry_t* inode_get_vars(const inode_t* inode) {
+    return inode->data;
+}
+
+/**
+ * @brief constant section, to be interpreted according to layout
+ */
+static inline
+const encoded_token_dict_entry_t* inode_get_consts(const inode_t* inode) {
+    return inode->data + inode->num_vars;
+}
+
+static inline
+const uint32_t* inode_eytzinger_keys(const inode_t* inode) {
+    /* nodes are 4-byte aligned in the memsector */
+    return (const uint32_t*) ((const char*) inode->data +
+            inode->num_vars * sizeof(encoded_token_dict_entry_t));
+}
+
+static inline
+const memsector_off_t* inode_eytzinger_offs(const inode_t* inode) {
+    return (const memsector_off_t*) inode_eytzinger_keys(inode) +
+            inode->num_consts;
+}
+
+/**
+ * @brief token of the i-th child of an inode which is not compact, in
+ * storage order
+ */
+static inline
+encoded_token_t inode_get_child_token(const inode_t* inode, uint32_t i) {
+    if (i < inode->num_vars) return inode->data[i].token;
+    i -= inode->num_vars;
+    if (inode->layout == INODE_LAYOUT_EYTZINGER) {
+        return encoded_token_from_key(inode_eytzinger_keys(inode)[i]);
+    }
+    return inode_get_consts(inode)[i].token;
+}
+
+/**
+ * @brief offset of the i-th child of an inode which is not compact, in
+ * storage order
+ */
+static inline
+memsector_off_t inode_get_child_off(const inode_t* inode, uint32_t i) {
+    if (i < inode->num_vars) return inode->data[i].off;
+    i -= inode->num_vars;
+    if (inode->layout == INODE_LAYOUT_EYTZINGER) {
+        return inode_eytzinger_offs(inode)[i];
+    }
+    return inode_get_consts(inode)[i].off;
+}
 
-    left = 0;
-    right = inode->size - 1;
+/**
+ * @brief binary search of a token among n sorted entries
+ */
+static inline
+memsector_off_t dict_entries_find(const encoded_token_dict_entry_t* data,
+                                  uint32_t n, uint32_t key) {
+    uint32_t left = 0;
+    uint32_t right = n;
 
-    while(left <= right)
-    {
+    while (left < right) {
         uint32_t center = left + (right - left) / 2;
-        int result = memcmp(&inode->data[center].token, &token, sizeof(token));
-        if (result > 0)
-        {
-            right = center - 1;
+        uint32_t center_key = encoded_token_key(data[center].token);
+        if (center_key < key) {
+            left = center + 1;
+        } else if (center_key > key) {
+            right = center;
+        } else {
+            return data[center].off;
         }
-        else if (result == 0)
-        {
-            return inode->data[center].off;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief lookup of a child of an inode which is not compact
+ */
+static inline
+memsector_off_t inode_get_child(const inode_t* inode, encoded_token_t token) {
+    const uint32_t key = encoded_token_key(token);
+    const uint32_t n = inode->num_consts;
+
+    if (encoded_token_is_var(token)) {
+        return dict_entries_find(inode_get_vars(inode), inode->num_vars, key);
+    }
+
+    if (inode->layout == INODE_LAYOUT_EYTZINGER) {
+        const uint32_t* keys = inode_eytzinger_keys(inode);
+        uint32_t k = 1;
+
+        /* branchless descent, prefetching the keys 4 levels below */
+        while (k <= n) {
+            __builtin_prefetch(keys + 16 * k);
+            k = 2 * k + (keys[k - 1] < key);
         }
-        else
-        {
-            left = center + 1;
+        /* undo the right turns since the last left turn (lower bound) */
+        k >>= __builtin_ffs(~k);
+        if (k != 0 && keys[k - 1] == key) {
+            return inode_eytzinger_offs(inode)[k - 1];
+        }
+        return 0;
+    }
+
+    return dict_entries_find(inode_get_consts(inode), n, key);
+}
+
+/**
+ * @brief LEB128 decoding of an unsigned integer, advancing pos past it
+ */
+static inline
+uint64_t varint_decode(const uint8_t** pos) {
+    const uint8_t* p = *pos;
+    uint64_t byte = *p++;
+    uint64_t value = byte & 0x7F;
+    unsigned shift = 7;
+
+    while (byte & 0x80) {
+        byte = *p++;
+        value |= (byte & 0x7F) << shift;
+        shift += 7;
+    }
+    *pos = p;
+
+    return value;
+}
+
+/**
+ * @brief LEB128 encoding of an unsigned integer
+ * @return number of bytes written to out (at most 10)
+ */
+static inline
+uint32_t varint_encode(uint8_t* out, uint64_t value) {
+    uint32_t size = 0;
+
+    while (value >= 0x80) {
+        out[size++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    out[size++] = (uint8_t) value;
+
+    return size;
+}
+
+/**
+ * @brief run of a path node in query stack order
+ * @param buf space for path->size tokens, used if the path node is compact
+ */
+static inline
+const encoded_token_t* pnode_get_tokens(const index_handle_t* index,
+                                        const pnode_t* path,
+                                        encoded_token_t* buf) {
+    const uint8_t* pos = (const uint8_t*) path->tokens;
+    uint32_t i;
+
+    if (!path->compact) return path->tokens;
+    for (i = 0; i < path->size; i++) {
+        buf[i] = index->tokens[varint_decode(&pos)];
+    }
+
+    return buf;
+}
+
+/**
+ * @brief compact section of an inode with INODE_LAYOUT_COMPACT
+ *
+ * Entries are sorted by encoded_token_key(). Each is
+ *  - varint (id delta << 1 | new arity): the id relative to the previous
+ *    entry, or to 0 if the arity differs from the previous one (which is 0
+ *    before the first entry), in which case a byte with the arity follows
+ *  - varint ref: (leaf - leaves_begin) << 1 | 1 for a leaf of the dense
+ *    array, or zigzag(child offset - inode offset) << 1 for a node.
+ * Children mostly follow their parent closely, and leaves are referenced
+ * within the leaf range of their parent, so most entries take 3-4 bytes.
+ */
+static inline
+const uint8_t* inode_compact_entries(const inode_t* inode) {
+    return (const uint8_t*) (inode->data + inode->num_vars);
+}
+
+/**
+ * @return bytes taken by a compact inode with num_vars variables and
+ * entries_size bytes of constant entries
+ */
+static inline
+uint64_t inode_compact_sizeof(uint32_t num_vars, uint64_t entries_size) {
+    return inode_sizeof(num_vars) + entries_size;
+}
+
+/**
+ * @brief ref of a leaf in a compact inode
+ * @param leaf index of the leaf relative to leaves_begin of the inode
+ */
+static inline
+uint64_t inode_compact_leaf_ref(uint32_t leaf) {
+    return ((uint64_t) leaf << 1) | 1;
+}
+
+/**
+ * @brief ref of a node at child_off in a compact inode at inode_off
+ */
+static inline
+uint64_t inode_compact_node_ref(memsector_off_t inode_off,
+                                memsector_off_t child_off) {
+    int64_t delta = (int64_t) child_off - (int64_t) inode_off;
+
+    return ((uint64_t) delta << 2) ^ ((uint64_t) (delta >> 63) << 1);
+}
+
+/**
+ * @brief decode the token key of the next compact entry, advancing pos to
+ * its ref
+ * @param key of the previous entry (0 before the first one)
+ */
+static inline
+uint32_t inode_compact_next_key(const uint8_t** pos, uint32_t key) {
+    uint32_t head = (uint32_t) varint_decode(pos);
+
+    if (head & 1) {
+        key = (uint32_t) *(*pos)++ << 24;
+    }
+
+    return key + (head >> 1);
+}
+
+/**
+ * @brief decode the ref of a compact entry, advancing pos past it
+ * @return offset of the child
+ */
+static inline
+memsector_off_t inode_compact_next_off(const uint8_t** pos,
+                                       const index_handle_t* index,
+                                       const inode_t* inode) {
+    uint64_t ref = varint_decode(pos);
+    const char* base = (const char*) index->alloc;
+
+    if (ref & 1) {
+        const leaf_t* leaf = index->leaves + inode->leaves_begin + (ref >> 1);
+        return (memsector_off_t)
+                (((const char*) leaf - base) >> MEMSECTOR_OFF_SHIFT);
+    }
+    ref >>= 1;
+
+    return (memsector_off_t) ((((const char*) inode - base) >>
+                               MEMSECTOR_OFF_SHIFT) +
+                              (int64_t) ((ref >> 1) ^ -(ref & 1)));
+}
+
+/**
+ * @brief skip the ref of a compact entry
+ */
+static inline
+void inode_compact_skip_off(const uint8_t** pos) {
+    while (*(*pos)++ & 0x80) {}
+}
+
+static inline
+memsector_off_t inode_compact_find(const index_handle_t* index,
+                                   const inode_t* inode, uint32_t key) {
+    const uint8_t* pos = inode_compact_entries(inode);
+    uint32_t curr_key = 0;
+    uint32_t i;
+
+    for (i = 0; i < inode->num_consts; i++) {
+        curr_key = inode_compact_next_key(&pos, curr_key);
+        if (curr_key >= key) {
+            if (curr_key != key) break;
+            return inode_compact_next_off(&pos, index, inode);
         }
+        inode_compact_skip_off(&pos);
     }
 
     return 0;
 }
 
+/**
+ * @brief lookup of a child of an inode of the index, in any layout
+ * @return offset of the child or 0 if there is none for token
+ */
 static inline
-uint32_t inode_get_max_var(const inode_t* inode) {
-    uint32_t i = 0;
-    while (inode->data[i].token.id < VAR_ID_MAX) i++;
+memsector_off_t index_get_child(const index_handle_t* index,
+                                const inode_t* inode, encoded_token_t token) {
+    if (inode->layout == INODE_LAYOUT_COMPACT &&
+            !encoded_token_is_var(token)) {
+        return inode_compact_find(index, inode, encoded_token_key(token));
+    }
 
-    return i;
+    return inode_get_child(inode, token);
 }
 
+/**
+ * @brief Iterator over the children of an inode in storage order
+ */
+typedef struct inode_iter_s {
+    const index_handle_t* index;
+    const inode_t*        inode;
+    uint32_t              next;
+    /* decoding state of compact entries */
+    const uint8_t*        pos;
+    uint32_t              key;
+} inode_iter_t;
+
 static inline
-memsector_off_t inode_get_qvar(const inode_t* inode, uint32_t qvar_id) {
-    assert(inode->data[qvar_id].token.id == qvar_id);
+void inode_iter_init(inode_iter_t* it, const index_handle_t* index,
+                     const inode_t* inode) {
+    it->index = index;
+    it->inode = inode;
+    it->next = 0;
+    it->pos = inode_compact_entries(inode);
+    it->key = 0;
+}
 
-    return inode->data[qvar_id].off;
+/**
+ * @brief get the next child
+ * @return false if there are no more children
+ */
+static inline
+bool inode_iter_next(inode_iter_t* it, encoded_token_t* token,
+                     memsector_off_t* off) {
+    const inode_t* inode = it->inode;
+    uint32_t i = it->next;
+
+    if (i >= inode_get_size(inode)) return false;
+    it->next++;
+
+    if (inode->layout != INODE_LAYOUT_COMPACT || i < inode->num_vars) {
+        *token = inode_get_child_token(inode, i);
+        *off = inode_get_child_off(inode, i);
+    } else {
+        it->key = inode_compact_next_key(&it->pos, it->key);
+        *token = encoded_token_from_key(it->key);
+        *off = inode_compact_next_off(&it->pos, it->index, inode);
+    }
+
+    return true;
 }
 
+/**
+ * @brief Rearrange the constant children of an inode exported with sorted
+ * entries into the layout chosen for their number.
+ */
+void inode_build_layout(inode_t* inode);
+
+/**
+ * @brief Encode an entry of a compact inode (see inode_compact_entries())
+ * @param out buffer of at least INODE_COMPACT_ENTRY_MAX_SIZE bytes
+ * @param prev_key key of the previous entry (0 for the first one)
+ * @param ref from inode_compact_leaf_ref() or inode_compact_node_ref()
+ * @return number of bytes written
+ */
+uint32_t inode_compact_encode_entry(uint8_t* out, uint32_t prev_key,
+                                    encoded_token_t token, uint64_t ref);
+
 END_DECLS
 
 #endif // __MWS_INDEX_INDEX_H
@@ -30,6 +30,8 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <stdint.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 // Local includes
 
@@ -41,13 +43,15 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 
 int memsector_create(memsector_writer_t *msw,
                      const char *path,
-                     uint32_t size) {
+                     uint64_t size) {
     int status;
 
-    /* create and mmap memsector file */
-    status = mmap_create(path, size,
-                         MAP_SHARED,
-                         &msw->mmap_handle);
+    if (size > MEMSECTOR_MAX_SIZE) return -1;
+    if (size < sizeof(memsector_header_t)) size = MEMSECTOR_GROW_STEP;
+
+    /* create and mmap memsector file, reserving space to grow in place */
+    status = mmap_create_growable(path, size, MEMSECTOR_MAX_SIZE,
+                                  &msw->mmap_handle);
     if (status == -1) return -1;
 
     /* initialize memory allocator */
@@ -57,21 +61,113 @@ int memsector_create(memsector_writer_t *msw,
     ms.alloc_header.end_offset = size;
     memcpy(msw->mmap_handle.start_addr, &ms, sizeof(memsector_header_t));
     msw->ms_header = (memsector_header_t*) msw->mmap_handle.start_addr;
+    msw->grow_step = MEMSECTOR_GROW_STEP;
 
     return 0;
 }
 
 int memsector_save(memsector_writer_t *msw) {
+    int status;
+    memsector_alloc_header_t* alloc = mswr_get_alloc(msw);
+
+    /* truncate to the space in use */
+    alloc->end_offset = alloc->curr_offset;
+    status = mmap_resize(&msw->mmap_handle, alloc->curr_offset);
+    if (status == -1) return -1;
+
     return mmap_unload(&msw->mmap_handle);
 }
 
+int memsector_discard(memsector_writer_t *msw) {
+    return mmap_unload(&msw->mmap_handle);
+}
+
+int memsector_sync(memsector_writer_t *msw,
+                   memsector_progress_cb_t cb, void *cb_arg) {
+    char* addr = msw->mmap_handle.start_addr;
+    const uint64_t size = mswr_get_alloc(msw)->curr_offset;
+    uint64_t done = 0;
+    uint64_t end;
+
+    while (done < size) {
+        end = done + MEMSECTOR_SYNC_STEP;
+        if (end > size) end = size;
+        if (msync(addr + done, end - done, MS_SYNC) != 0) return -1;
+        done = end;
+        if (cb != NULL && cb(cb_arg, done, size) != 0) return -1;
+    }
+
+    return 0;
+}
+
+int mswr_grow(memsector_writer_t *msw, uint64_t nbytes) {
+    int status;
+    memsector_alloc_header_t* alloc = mswr_get_alloc(msw);
+    uint64_t needed = alloc->curr_offset + memsector_align(nbytes);
+    uint64_t size;
+
+    /* double, in multiples of the growth step */
+    size = 2 * alloc->end_offset;
+    if (size < needed) size = needed;
+    if (msw->grow_step > 0) {
+        size = (size + msw->grow_step - 1) / msw->grow_step * msw->grow_step;
+    }
+    if (size > MEMSECTOR_MAX_SIZE) size = MEMSECTOR_MAX_SIZE;
+    if (size < needed) return -1;
+
+    status = mmap_resize(&msw->mmap_handle, size);
+    if (status == -1) return -1;
+    alloc->end_offset = size;
+
+    return 0;
+}
+
 int memsector_load(memsector_handle_t *ms, const char *path) {
+    return memsector_load_flags(ms, path, 0);
+}
+
+int memsector_load_flags(memsector_handle_t *ms, const char *path,
+                         int flags) {
     int status;
+    char* addr;
+    size_t size;
 
     // mmap_handle
-    status = mmap_load(path, MAP_SHARED, &ms->mmap_handle);
+    if (flags & MEMSECTOR_LOAD_HUGETLB_COPY) {
+        status = mmap_load_anonymous(path, MAP_HUGETLB, &ms->mmap_handle);
+        if (status == -1) {
+            /* no huge pages reserved */
+            status = mmap_load_anonymous(path, 0, &ms->mmap_handle);
+        }
+    } else if (flags & MEMSECTOR_LOAD_PREFAULT) {
+        status = mmap_load(path, MAP_SHARED | MAP_POPULATE, &ms->mmap_handle);
+    } else {
+        status = mmap_load(path, MAP_SHARED, &ms->mmap_handle);
+    }
     if (status == -1) return -1;
 
+    // memory advice (not every kernel supports every advice)
+    addr = ms->mmap_handle.start_addr;
+    size = ms->mmap_handle.size;
+#ifdef MADV_HUGEPAGE
+    if (flags & MEMSECTOR_LOAD_HUGEPAGE) {
+        (void) madvise(addr, size, MADV_HUGEPAGE);
+    }
+#endif
+    if (flags & MEMSECTOR_LOAD_WILLNEED) {
+        (void) madvise(addr, size, MADV_WILLNEED);
+    }
+    if (flags & MEMSECTOR_LOAD_RANDOM) {
+        (void) madvise(addr, size, MADV_RANDOM);
+    }
+    if (flags & MEMSECTOR_LOAD_MLOCK) {
+        status = mlock(addr, size);
+        if (status == -1) {
+            (void) mmap_unload(&ms->mmap_handle);
+            return -1;
+        }
+    }
+
     // alloc
     memsector_header_t* memsector_header =
             (memsector_header_t*) ms->mmap_handle.start_addr;
@@ -82,6 +178,33 @@ int memsector_load(memsector_handle_t *ms, const char *path) {
             memsector_off2addr(ms->alloc, memsector_header->index_header_off);
     ms->index.alloc = ms->alloc;
     ms->index.root  = &index_header->root;
+    ms->index.leaves = (leaf_t*)
+            memsector_off2addr(ms->alloc, index_header->leaves_off);
+    ms->index.num_leaves = index_header->num_leaves;
+    ms->index.tokens = (encoded_token_t*)
+            memsector_off2addr(ms->alloc, index_header->tokens_off);
+    ms->index.num_tokens = index_header->num_tokens;
+
+    return 0;
+}
+
+int memsector_warmup(const memsector_handle_t *ms,
+                     memsector_progress_cb_t cb, void *cb_arg) {
+    const volatile char* addr = ms->mmap_handle.start_addr;
+    const uint64_t size = ms->mmap_handle.size;
+    const uint64_t page_size = sysconf(_SC_PAGESIZE);
+    uint64_t done = 0;
+    uint64_t end;
+
+    while (done < size) {
+        end = done + MEMSECTOR_WARMUP_STEP;
+        if (end > size) end = size;
+        for (; done < end; done += page_size) {
+            (void) addr[done];
+        }
+        if (done > size) done = size;
+        if (cb != NULL && cb(cb_arg, done, size) != 0) return -1;
+    }
 
     return 0;
 }
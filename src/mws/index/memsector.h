@@ -31,6 +31,7 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 
 // System includes
 
+#include <stddef.h>
 #include <stdint.h>
 
 // Local includes
@@ -42,15 +43,31 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 #include "mws/index/encoded_url_dict.h"
 #include "mws/index/index.h"
 
+/*--------------------------------------------------------------------------*/
+/* Constants                                                                */
+/*--------------------------------------------------------------------------*/
+
+/** Default memsector growth step (huge page size) */
+#define MEMSECTOR_GROW_STEP     (2 * 1024 * 1024)
+
+/** Block size of the EXPORT_LAYOUT_BLOCKS memsector layout (page size) */
+#define MEMSECTOR_LAYOUT_BLOCK_SIZE     4096
+
+/** Progress of memsector_warmup() is reported after each step */
+#define MEMSECTOR_WARMUP_STEP   (64 * 1024 * 1024)
+
+/** Progress of memsector_sync() is reported after each step */
+#define MEMSECTOR_SYNC_STEP     (4 * 1024 * 1024)
+
 /*--------------------------------------------------------------------------*/
 /* Type declarations                                                        */
 /*--------------------------------------------------------------------------*/
 
 struct memsector_header_s {
     memsector_alloc_header_t alloc_header;
-    uint32_t index_header_off;
-    uint32_t encoded_token_dict_header_off;
-    uint32_t encoded_url_dict_header_off;
+    memsector_off_t index_header_off;
+    memsector_off_t encoded_token_dict_header_off;
+    memsector_off_t encoded_url_dict_header_off;
     uint32_t signature; // TODO
 } PACKED;
 typedef struct memsector_header_s memsector_header_t;
@@ -63,9 +80,37 @@ typedef struct memsector_handle_s {
     //encoded_url_dict_handle_t encoded_url_dict;
 } memsector_handle_t;
 
+/**
+ * @brief Options of memsector_load_flags(), to be or-ed together
+ */
+typedef enum memsector_load_flags_e {
+    /** prefault the whole memsector when mapping it (MAP_POPULATE) */
+    MEMSECTOR_LOAD_PREFAULT     = 1 << 0,
+    /** back the memsector by transparent huge pages (MADV_HUGEPAGE) */
+    MEMSECTOR_LOAD_HUGEPAGE     = 1 << 1,
+    /** disable readahead around page faults (MADV_RANDOM) */
+    MEMSECTOR_LOAD_RANDOM       = 1 << 2,
+    /** start reading the memsector in the background (MADV_WILLNEED) */
+    MEMSECTOR_LOAD_WILLNEED     = 1 << 3,
+    /** lock the memsector in memory */
+    MEMSECTOR_LOAD_MLOCK        = 1 << 4,
+    /** copy the memsector to anonymous memory backed by huge pages, or by
+     * transparent huge pages if none are reserved */
+    MEMSECTOR_LOAD_HUGETLB_COPY = 1 << 5
+} memsector_load_flags_t;
+
+/**
+ * @brief memsector_warmup() and memsector_sync() progress callback
+ * @return 0 to continue, non-zero to stop the warm-up
+ */
+typedef int (*memsector_progress_cb_t)(void* arg, uint64_t done,
+                                       uint64_t total);
+
 typedef struct memsector_writer_s {
     mmap_handle_t mmap_handle;
     memsector_header_t* ms_header;
+    /* the memsector doubles in size when full, rounded up to this step */
+    uint64_t grow_step;
 } memsector_writer_t;
 
 /*--------------------------------------------------------------------------*/
@@ -75,22 +120,74 @@ typedef struct memsector_writer_s {
 BEGIN_DECLS
 
 /**
+ * Create a memsector which grows as space is allocated from it.
+ *
+ * @param size initial size of the memsector in bytes (0 for one growth step)
  * @return 0 on success, -1 on failure.
  */
 int memsector_create(memsector_writer_t *msw,
                      const char *path,
-                     uint32_t size);
+                     uint64_t size);
 
 /**
+ * Truncate the memsector to the space in use and unmap it.
+ *
  * @return 0 on success, -1 on failure.
  */
 int memsector_save(memsector_writer_t *msw);
 
+/**
+ * Unmap a memsector which could not be written, leaving its file as it is.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int memsector_discard(memsector_writer_t *msw);
+
+/**
+ * Write the space in use of the memsector back to its file, such that
+ * memsector_save() finds little left to write. The callback can pace the
+ * writes by sleeping.
+ *
+ * @param cb called after each MEMSECTOR_SYNC_STEP bytes and at the end
+ * (can be NULL)
+ * @return 0 on success, -1 on failure or if stopped by cb.
+ */
+int memsector_sync(memsector_writer_t *msw,
+                   memsector_progress_cb_t cb, void *cb_arg);
+
+/**
+ * Grow the memsector such that nbytes more can be allocated. The memsector
+ * does not move in memory.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int mswr_grow(memsector_writer_t *msw, uint64_t nbytes);
+
 /**
  * @return 0 on success, -1 on failure.
  */
 int memsector_load(memsector_handle_t *ms, const char *path);
 
+/**
+ * Load a memsector, preparing its memory according to flags (an or-ed
+ * combination of memsector_load_flags_t). Memory advice is best-effort,
+ * while a failure to lock or copy the memsector fails the load.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int memsector_load_flags(memsector_handle_t *ms, const char *path, int flags);
+
+/**
+ * Read every page of a loaded memsector, such that queries do not wait on
+ * page faults. Meant to run in a background thread after loading.
+ *
+ * @param cb called after each MEMSECTOR_WARMUP_STEP bytes and at the end
+ * (can be NULL)
+ * @return 0 when done, -1 if stopped by cb.
+ */
+int memsector_warmup(const memsector_handle_t *ms,
+                     memsector_progress_cb_t cb, void *cb_arg);
+
 /**
  * @return 0 on success, -1 on failure.
  */
@@ -115,22 +212,48 @@ memsector_alloc_header_t* ms_get_alloc(memsector_handle_t* ms) {
 }
 
 /**
- * Prepare the memsector to begin writing the index
+ * Allocate nbytes from the memsector, growing it if needed
+ *
+ * @return offset of the allocated space or 0 on failure
+ */
+static inline
+memsector_off_t mswr_alloc(memsector_writer_t* RESTRICT mswr,
+                           uint64_t nbytes) {
+    memsector_alloc_header_t* alloc = mswr_get_alloc(mswr);
+
+    if (alloc->end_offset - alloc->curr_offset < memsector_align(nbytes) &&
+            mswr_grow(mswr, nbytes) != 0) {
+        return 0;
+    }
+
+    return memsector_alloc(alloc, nbytes);
+}
+
+/**
+ * Prepare the memsector to begin writing the index. The root inode has to be
+ * the next allocation following this call.
+ *
+ * @return pointer to the index header or NULL on failure
  */
 static inline
-void mswr_index_begin(memsector_writer_t* RESTRICT mswr) {
+index_header_t* mswr_index_begin(memsector_writer_t* RESTRICT mswr) {
     memsector_header_t*       ms    = mswr->ms_header;
     memsector_alloc_header_t* alloc = &ms->alloc_header;
 
-    /* set index header offset */
-    memsector_off_t index_off = memsector_alloc_get_curr_off(alloc);
-    ms->index_header_off = index_off;
+    /* alloc index header (without the root inode) */
+    assert(offsetof(index_header_t, root) % MEMSECTOR_ALIGNMENT == 0);
+    memsector_off_t index_header_off =
+            mswr_alloc(mswr, offsetof(index_header_t, root));
+    if (index_header_off == 0) return NULL;
+    ms->index_header_off = index_header_off;
+
+    return (index_header_t*) memsector_off2addr(alloc, index_header_off);
 }
 
 /**
  * Prepare the memsector to begin writing the encoded token dictionary
  *
- * @return pointer to the encoded token dictionary header
+ * @return pointer to the encoded token dictionary header or NULL on failure
  */
 static inline
 encoded_token_dict_header_t*
@@ -140,7 +263,8 @@ mswr_encoded_token_dict_begin(memsector_writer_t* RESTRICT mswr) {
 
     /* alloc encoded_token_dict header */
     memsector_off_t encoded_token_dict_header_off =
-            memsector_alloc(alloc, sizeof(encoded_token_dict_header_t));
+            mswr_alloc(mswr, sizeof(encoded_token_dict_header_t));
+    if (encoded_token_dict_header_off == 0) return NULL;
     ms->encoded_token_dict_header_off = encoded_token_dict_header_off;
 
     return (encoded_token_dict_header_t*)
@@ -150,7 +274,7 @@ mswr_encoded_token_dict_begin(memsector_writer_t* RESTRICT mswr) {
 /**
  * Prepare the memsector to begin writing the URL dictionary
  *
- * @return pointer to the URL dictionary header
+ * @return pointer to the URL dictionary header or NULL on failure
  */
 static inline
 encoded_url_dict_header_t*
@@ -160,7 +284,8 @@ mswr_encoded_url_dict_begin(memsector_writer_t* RESTRICT mswr) {
 
     /* alloc encoded_url_dict header */
     memsector_off_t encoded_url_dict_header_off =
-            memsector_alloc(alloc, sizeof(encoded_url_dict_header_t));
+            mswr_alloc(mswr, sizeof(encoded_url_dict_header_t));
+    if (encoded_url_dict_header_off == 0) return NULL;
     ms->encoded_url_dict_header_off = encoded_url_dict_header_off;
 
     return (encoded_url_dict_header_t*) 
@@ -39,13 +39,19 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 /*--------------------------------------------------------------------------*/
 
 /**
- * Compact offset pointer
+ * Compact offset pointer, in units of MEMSECTOR_ALIGNMENT bytes. This keeps
+ * links between nodes at 32 bits while a memsector spans up to
+ * MEMSECTOR_MAX_SIZE bytes.
  */
 typedef uint32_t memsector_off_t;
 
+#define MEMSECTOR_OFF_SHIFT     3
+#define MEMSECTOR_ALIGNMENT     (1 << MEMSECTOR_OFF_SHIFT)
+#define MEMSECTOR_MAX_SIZE      ((uint64_t) UINT32_MAX << MEMSECTOR_OFF_SHIFT)
+
 struct memsector_alloc_header_s {
-    uint32_t curr_offset;
-    uint32_t end_offset;
+    uint64_t curr_offset;   /* in bytes */
+    uint64_t end_offset;    /* in bytes */
 } PACKED;
 typedef struct memsector_alloc_header_s memsector_alloc_header_t;
 
@@ -55,12 +61,21 @@ typedef struct memsector_alloc_header_s memsector_alloc_header_t;
 
 BEGIN_DECLS
 
+/**
+ * @return nbytes rounded up to the memsector alignment
+ */
+static inline
+uint64_t memsector_align(uint64_t nbytes) {
+    return (nbytes + MEMSECTOR_ALIGNMENT - 1) & ~((uint64_t) MEMSECTOR_ALIGNMENT - 1);
+}
+
 static inline
 memsector_off_t memsector_alloc(memsector_alloc_header_t *alloc,
-                                uint32_t nbytes) {
+                                uint64_t nbytes) {
+    nbytes = memsector_align(nbytes);
     assert(alloc->end_offset - alloc->curr_offset >= nbytes);
 
-    memsector_off_t result = alloc->curr_offset;
+    memsector_off_t result = alloc->curr_offset >> MEMSECTOR_OFF_SHIFT;
     alloc->curr_offset += nbytes;
 
     return result;
@@ -69,16 +84,27 @@ memsector_off_t memsector_alloc(memsector_alloc_header_t *alloc,
 static inline
 void* memsector_off2addr(const memsector_alloc_header_t* alloc,
                          memsector_off_t off) {
-    return (void*) (((char*)alloc) + off);
+    return (void*) (((char*)alloc) + ((uint64_t) off << MEMSECTOR_OFF_SHIFT));
+}
+
+/**
+ * @return offset of the address nbytes (a multiple of MEMSECTOR_ALIGNMENT)
+ * past off
+ */
+static inline
+memsector_off_t memsector_off_add(memsector_off_t off, uint64_t nbytes) {
+    assert(nbytes % MEMSECTOR_ALIGNMENT == 0);
+
+    return off + (memsector_off_t) (nbytes >> MEMSECTOR_OFF_SHIFT);
 }
 
 static inline
-uint32_t memsector_size_inuse(const memsector_alloc_header_t* alloc) {
+uint64_t memsector_size_inuse(const memsector_alloc_header_t* alloc) {
     return alloc->curr_offset;
 }
 
 static inline
-uint32_t memsector_alloc_get_curr_off(const memsector_alloc_header_t* alloc) {
+uint64_t memsector_alloc_get_curr_off(const memsector_alloc_header_t* alloc) {
     return alloc->curr_offset;
 }
 
@@ -0,0 +1,161 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+  * @brief File containing the main function of the MWS query broker
+  * @file mwsbrokerd.cpp
+  * @date 19 Oct 2026
+  *
+  * License: GPL v3
+  *
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "common/utils/FlagParser.hpp"
+#include "common/utils/save_pid_file.h"
+#include "mws/broker/MwsBroker.hpp"
+#include "config.h"
+
+using std::string;
+using common::utils::FlagParser;
+
+/// Time the shards have to answer by default
+#define DEFAULT_SHARD_TIMEOUT_MS 2000
+
+int main(int argc, char* argv[]) {
+    int ret;
+    mws::broker::Config config;
+
+    // Parsing the flags
+    FlagParser::addFlag('m', "mws-port",             FLAG_OPT, ARG_REQ);
+    FlagParser::addFlag('s', "shard",                FLAG_REQ, ARG_REQ);
+    FlagParser::addFlag('t', "shard-timeout",        FLAG_OPT, ARG_REQ);
+    FlagParser::addFlag('K', "partition-tokens",     FLAG_OPT, ARG_REQ);
+    FlagParser::addFlag('i', "pid-file",             FLAG_OPT, ARG_REQ);
+    FlagParser::addFlag('l', "log-file",             FLAG_OPT, ARG_REQ);
+#ifndef __APPLE__
+    FlagParser::addFlag('d', "daemonize",            FLAG_OPT, ARG_NONE);
+#endif  // !__APPLE__
+
+    if ((ret = FlagParser::parse(argc, argv)) != 0) {
+        fprintf(stderr, "%s", FlagParser::getUsage().c_str());
+        goto failure;
+    }
+
+    // shard-timeout
+    config.shardTimeoutMs = DEFAULT_SHARD_TIMEOUT_MS;
+    if (FlagParser::hasArg('t')) {
+        config.shardTimeoutMs = atoi(FlagParser::getArg('t').c_str());
+    }
+
+    // shards, as host:port
+    for (const string& arg : FlagParser::getArgs('s')) {
+        mws::broker::Shard shard;
+        size_t colon = arg.rfind(':');
+        int port = (colon != string::npos) ?
+                atoi(arg.c_str() + colon + 1) : DEFAULT_MWS_PORT;
+        shard.host = (colon != string::npos) ? arg.substr(0, colon) : arg;
+        if (port <= 0 || port >= (1<<16)) {
+            fprintf(stderr, "Invalid shard \"%s\" (expected host:port)\n",
+                    arg.c_str());
+            goto failure;
+        }
+        shard.port = port;
+        if (mws::broker::openShard(&shard, config.shardTimeoutMs) != 0) {
+            fprintf(stderr, "Unable to resolve shard \"%s\"\n", arg.c_str());
+            goto failure;
+        }
+        config.shards.push_back(shard);
+    }
+
+    // partition-tokens: the shards are the partitions of an index, in order
+    config.partitionTokens = 0;
+    if (FlagParser::hasArg('K')) {
+        config.partitionTokens = atoi(FlagParser::getArg('K').c_str());
+        if (config.partitionTokens < 1) {
+            fprintf(stderr, "Invalid number of partition tokens \"%s\"\n",
+                    FlagParser::getArg('K').c_str());
+            goto failure;
+        }
+    }
+
+    // mws-port
+    if (FlagParser::hasArg('m')) {
+        int mwsPort = atoi(FlagParser::getArg('m').c_str());
+        if (mwsPort > 0 && mwsPort < (1<<16)) {
+            config.brokerPort = mwsPort;
+        } else {
+            fprintf(stderr, "Invalid port \"%s\"\n",
+                    FlagParser::getArg('m').c_str());
+            goto failure;
+        }
+    } else {
+        fprintf(stderr, "Using default mws port %d\n", DEFAULT_MWS_PORT);
+        config.brokerPort = DEFAULT_MWS_PORT;
+    }
+
+    // log-file
+    if (FlagParser::hasArg('l')) {
+        fprintf(stderr, "Redirecting output to %s\n",
+                FlagParser::getArg('l').c_str());
+        if (freopen(FlagParser::getArg('l').c_str(), "w", stderr) == NULL) {
+            fprintf(stderr, "ERROR: Unable to redirect stderr to %s\n",
+                    FlagParser::getArg('l').c_str());
+            goto failure;
+        }
+        if (freopen(FlagParser::getArg('l').c_str(), "w", stdout) == NULL) {
+            fprintf(stderr, "ERROR: Unable to redirect stdout to %s\n",
+                    FlagParser::getArg('l').c_str());
+            goto failure;
+        }
+    }
+
+#ifndef __APPLE__
+    // daemon
+    if (FlagParser::hasArg('d')) {
+        // Daemonizing
+        ret = ::daemon(0, /* noclose = */ FlagParser::hasArg('l'));
+        if (ret != 0) {
+            fprintf(stderr, "Error while daemonizing\n");
+            goto failure;
+        }
+    }
+#endif  // !__APPLE__
+
+    // pid-file - always needs to be done after daemonizing
+    if (FlagParser::hasArg('i')) {
+        ret = save_pid_file(FlagParser::getArg('i').c_str());
+        if (ret != 0) {
+            fprintf(stderr, "ERROR: Unable to save pidfile %s\n",
+                    FlagParser::getArg('i').c_str());
+            goto failure;
+        }
+    }
+
+    return mws::broker::mwsBrokerLoop(config);
+
+failure:
+    return EXIT_FAILURE;
+}
@@ -37,6 +37,7 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "common/utils/FlagParser.hpp"
 #include "common/utils/save_pid_file.h"
+#include "mws/daemon/BatchRunner.hpp"
 #include "mws/daemon/MwsDaemon.hpp"
 #include "mws/index/memsector.h"
 #include "config.h"
@@ -48,16 +49,34 @@ using common::utils::FlagParser;
 int main(int argc, char* argv[]) {
     int ret;
     mws::daemon::Config config;
+    mws::daemon::BatchConfig batchConfig;
 
     // Parsing the flags
-    FlagParser::addFlag('I', "include-harvest-path", FLAG_REQ, ARG_REQ);
+    FlagParser::addFlag('I', "include-harvest-path", FLAG_OPT, ARG_REQ);
     FlagParser::addFlag('O', "elastic-search-outdir",FLAG_OPT, ARG_REQ);
     FlagParser::addFlag('m', "mws-port",             FLAG_OPT, ARG_REQ);
+    FlagParser::addFlag('u', "mws-socket",           FLAG_OPT, ARG_REQ);
     FlagParser::addFlag('D', "data-path",            FLAG_OPT, ARG_REQ);
     FlagParser::addFlag('i', "pid-file",             FLAG_OPT, ARG_REQ);
     FlagParser::addFlag('l', "log-file",             FLAG_OPT, ARG_REQ);
     FlagParser::addFlag('r', "recursive",            FLAG_OPT, ARG_NONE);
     FlagParser::addFlag('E', "exit-after-load",      FLAG_OPT, ARG_NONE);
+    FlagParser::addFlag('M', "memsector-path",       FLAG_OPT, ARG_REQ);
+    FlagParser::addFlag('P', "prefault",             FLAG_OPT, ARG_NONE);
+    FlagParser::addFlag('R', "readahead",            FLAG_OPT, ARG_NONE);
+    FlagParser::addFlag('A', "madvise",              FLAG_OPT, ARG_REQ);
+    FlagParser::addFlag('L', "mlock",                FLAG_OPT, ARG_NONE);
+    FlagParser::addFlag('H', "hugetlb-copy",         FLAG_OPT, ARG_NONE);
+    FlagParser::addFlag('Y', "memsector-layout",     FLAG_OPT, ARG_REQ);
+    FlagParser::addFlag('q', "layout-queries",       FLAG_OPT, ARG_REQ);
+    FlagParser::addFlag('C', "compact",              FLAG_OPT, ARG_NONE);
+    FlagParser::addFlag('g', "merge-interval",       FLAG_OPT, ARG_REQ);
+    FlagParser::addFlag('w', "merge-rate-limit",     FLAG_OPT, ARG_REQ);
+    FlagParser::addFlag('k', "partition",            FLAG_OPT, ARG_REQ);
+    FlagParser::addFlag('K', "partition-tokens",     FLAG_OPT, ARG_REQ);
+    FlagParser::addFlag('b', "batch",                FLAG_OPT, ARG_REQ);
+    FlagParser::addFlag('o', "batch-output",         FLAG_OPT, ARG_REQ);
+    FlagParser::addFlag('j', "batch-threads",        FLAG_OPT, ARG_REQ);
 #ifndef __APPLE__
     FlagParser::addFlag('d', "daemonize",            FLAG_OPT, ARG_NONE);
 #endif  // !__APPLE__
@@ -70,6 +89,109 @@ int main(int argc, char* argv[]) {
     // harvest paths
     config.harvestLoadPaths = FlagParser::getArgs('I');
 
+    // memsector
+    if (FlagParser::hasArg('M')) {
+        config.memsectorPath = FlagParser::getArg('M');
+    } else if (config.harvestLoadPaths.empty()) {
+        fprintf(stderr, "Harvest path or memsector path required\n");
+        fprintf(stderr, "%s", FlagParser::getUsage().c_str());
+        goto failure;
+    }
+
+    // memsector load options
+    config.memsectorLoadFlags = 0;
+    if (FlagParser::hasArg('P')) {
+        config.memsectorLoadFlags |= MEMSECTOR_LOAD_PREFAULT;
+    }
+    if (FlagParser::hasArg('L')) {
+        config.memsectorLoadFlags |= MEMSECTOR_LOAD_MLOCK;
+    }
+    if (FlagParser::hasArg('H')) {
+        config.memsectorLoadFlags |= MEMSECTOR_LOAD_HUGETLB_COPY;
+    }
+    for (const string& advice : FlagParser::getArgs('A')) {
+        if (advice == "hugepage") {
+            config.memsectorLoadFlags |= MEMSECTOR_LOAD_HUGEPAGE;
+        } else if (advice == "random") {
+            config.memsectorLoadFlags |= MEMSECTOR_LOAD_RANDOM;
+        } else if (advice == "willneed") {
+            config.memsectorLoadFlags |= MEMSECTOR_LOAD_WILLNEED;
+        } else {
+            fprintf(stderr, "Invalid advice \"%s\" "
+                    "(expected hugepage, random or willneed)\n",
+                    advice.c_str());
+            goto failure;
+        }
+    }
+    config.memsectorReadahead = FlagParser::hasArg('R');
+
+    // memsector layout
+    config.memsectorLayout = mws::EXPORT_LAYOUT_DFS;
+    if (FlagParser::hasArg('q')) {
+        config.layoutQueryPath = FlagParser::getArg('q');
+        config.memsectorLayout = mws::EXPORT_LAYOUT_HOT;
+    }
+    if (FlagParser::hasArg('Y')) {
+        const string layout = FlagParser::getArg('Y');
+        if (layout == "dfs") {
+            config.memsectorLayout = mws::EXPORT_LAYOUT_DFS;
+        } else if (layout == "blocks") {
+            config.memsectorLayout = mws::EXPORT_LAYOUT_BLOCKS;
+        } else if (layout == "hot" && FlagParser::hasArg('q')) {
+            config.memsectorLayout = mws::EXPORT_LAYOUT_HOT;
+        } else {
+            fprintf(stderr, "Invalid layout \"%s\" (expected dfs, blocks "
+                    "or hot with --layout-queries)\n", layout.c_str());
+            goto failure;
+        }
+    }
+
+    // memsector encoding
+    config.memsectorEncoding = FlagParser::hasArg('C') ?
+            mws::EXPORT_ENCODING_COMPACT : mws::EXPORT_ENCODING_FIXED;
+
+    // merges of the ingested harvests into the memsector
+    config.mergeInterval = 0;
+    if (FlagParser::hasArg('g')) {
+        config.mergeInterval = atoi(FlagParser::getArg('g').c_str());
+    }
+    config.mergeRateLimit = 0;
+    if (FlagParser::hasArg('w')) {
+        config.mergeRateLimit = atoi(FlagParser::getArg('w').c_str());
+    }
+
+    // partition of the harvests indexed
+    if (FlagParser::hasArg('k') &&
+            config.partition.parse(FlagParser::getArg('k')) != 0) {
+        fprintf(stderr, "Invalid partition \"%s\" (expected index/count)\n",
+                FlagParser::getArg('k').c_str());
+        goto failure;
+    }
+    if (FlagParser::hasArg('K')) {
+        config.partition.numTokens = atoi(FlagParser::getArg('K').c_str());
+        if (config.partition.numTokens < 1) {
+            fprintf(stderr, "Invalid number of partition tokens \"%s\"\n",
+                    FlagParser::getArg('K').c_str());
+            goto failure;
+        }
+    }
+
+    // batch of queries answered offline
+    batchConfig.inputPath = FlagParser::hasArg('b') ?
+            FlagParser::getArg('b') : "";
+    batchConfig.outputPath = FlagParser::hasArg('o') ?
+            FlagParser::getArg('o') : "-";
+    batchConfig.threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (FlagParser::hasArg('j')) {
+        int threads = atoi(FlagParser::getArg('j').c_str());
+        if (threads < 1) {
+            fprintf(stderr, "Invalid number of batch threads \"%s\"\n",
+                    FlagParser::getArg('j').c_str());
+            goto failure;
+        }
+        batchConfig.threads = threads;
+    }
+
     // elastic search out dir
     if (FlagParser::hasArg('O')) {
         config.outDir = FlagParser::getArg('O');
@@ -96,10 +218,17 @@ int main(int argc, char* argv[]) {
             goto failure;
         }
     } else {
-        fprintf(stderr, "Using default mws port %d\n", DEFAULT_MWS_PORT);
+        if (batchConfig.inputPath.empty()) {
+            fprintf(stderr, "Using default mws port %d\n", DEFAULT_MWS_PORT);
+        }
         config.mwsPort = DEFAULT_MWS_PORT;
     }
 
+    // mws-socket
+    if (FlagParser::hasArg('u')) {
+        config.socketPath = FlagParser::getArg('u');
+    }
+
     // data-path
     if (FlagParser::hasArg('D')) {
         config.dataPath = FlagParser::getArg('D');
@@ -146,6 +275,10 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    if (!batchConfig.inputPath.empty()) {
+        return mwsBatchLoop(config, batchConfig);
+    }
+
     return mwsDaemonLoop(config);
 
 failure:
@@ -0,0 +1,203 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+  * @file EncodedQuery.cpp
+  * @brief Pre-tokenized queries, answered without parsing XML
+  * @date 19 Oct 2026
+  */
+
+#include <string.h>
+
+#include <set>
+#include <stack>
+#include <utility>
+
+#include "EncodedQuery.hpp"
+#include "common/utils/BinaryEncoding.hpp"
+#include "MwsQueryConf.hpp"
+#include "mws/query/query_engine.h"
+
+using namespace std;
+using namespace mws::types;
+
+namespace mws {
+
+namespace {
+
+const char   ENCODED_QUERY_MAGIC[] = "MWQE";
+const size_t ENCODED_QUERY_MAGIC_SIZE = 4;
+const size_t ENCODED_QUERY_HEADER_SIZE = 20;
+/// Distinct qvars the query engine has ids for
+const size_t ENCODED_QUERY_MAX_QVARS = QVAR_ID_MAX - QVAR_ID_MIN + 1;
+
+}  // namespace
+
+EncodedQuery::EncodedQuery() :
+    offset(0), size(DEFAULT_MWSQUERY_MAXSIZE),
+    maxTotal(DEFAULT_MWSQUERY_TOTALREQ_MAXSIZE),
+    outputFormat(DATAFORMAT_JSON) {
+}
+
+void
+EncodedQuery::setExpression(const CmmlToken* expression) {
+    stack<const CmmlToken*> tokenStack;
+
+    tokens.clear();
+    tokenStack.push(expression);
+    while (!tokenStack.empty()) {
+        const CmmlToken* token = tokenStack.top();
+        tokenStack.pop();
+
+        CmmlToken::PtrList::const_reverse_iterator rIt;
+        for (rIt = token->getChildNodes().rbegin();
+             rIt != token->getChildNodes().rend(); rIt++) {
+            tokenStack.push(*rIt);
+        }
+
+        if (token->isQvar()) {
+            tokens.push_back(EncodedQueryToken(token->getQvarName(), 0, true));
+        } else {
+            tokens.push_back(EncodedQueryToken(token->getMeaning(),
+                                               token->getChildNodes().size(),
+                                               false));
+        }
+    }
+}
+
+CmmlToken*
+EncodedQuery::toCmmlToken() const {
+    CmmlToken* root = NULL;
+    // tokens still missing children, with the number they miss
+    stack<pair<CmmlToken*, uint32_t> > parents;
+
+    for (const EncodedQueryToken& encoded : tokens) {
+        CmmlToken* token;
+        if (parents.empty()) {
+            token = root = CmmlToken::newRoot(false);
+        } else {
+            token = parents.top().first->newChildNode();
+            if (--parents.top().second == 0) parents.pop();
+        }
+
+        if (encoded.isQvar) {
+            token->setTag(MWS_QVAR_MEANING);
+            token->appendTextContent(encoded.value.data(),
+                                     encoded.value.size());
+        } else if (encoded.value.compare(0, 1, "#") == 0) {
+            // any tag with text content has the meaning "#" + text
+            token->setTag("ci");
+            token->appendTextContent(encoded.value.data() + 1,
+                                     encoded.value.size() - 1);
+        } else {
+            token->setTag(encoded.value);
+        }
+        if (encoded.arity > 0) parents.push(make_pair(token, encoded.arity));
+    }
+
+    return root;
+}
+
+int
+readEncodedQuery(const char* data, size_t size, EncodedQuery* query) {
+    const unsigned char* pos = (const unsigned char*) data;
+    const unsigned char* end = pos + size;
+    uint64_t             numTokens, header;
+    // tokens still expected for the expression to be complete
+    uint64_t             numMissing = 1;
+    // distinct qvars, anonymous ones are all distinct
+    set<string>          qvarNames;
+    size_t               numAnonymousQvars = 0;
+
+    if (size < ENCODED_QUERY_HEADER_SIZE ||
+            memcmp(data, ENCODED_QUERY_MAGIC,
+                   ENCODED_QUERY_MAGIC_SIZE) != 0 ||
+            pos[4] != ENCODED_QUERY_VERSION) {
+        return -1;
+    }
+    query->outputFormat = (pos[5] & ENCODED_QUERY_BINARY) ? DATAFORMAT_BINARY
+                                                          : DATAFORMAT_JSON;
+    query->offset = getUint32(pos + 8);
+    query->size = getUint32(pos + 12);
+    query->maxTotal = getUint32(pos + 16);
+    pos += ENCODED_QUERY_HEADER_SIZE;
+
+    // every token takes at least 2 bytes, and all must fit on the stacks
+    // of the query engine
+    if (getVarint(&pos, end, &numTokens) != 0 ||
+            numTokens > (uint64_t) (end - pos) / 2 ||
+            numTokens > MAX_QUERY_STACK_SIZE) {
+        return -1;
+    }
+    query->tokens.clear();
+    query->tokens.reserve(numTokens);
+    for (uint64_t i = 0; i < numTokens; i++) {
+        string value;
+        if (numMissing == 0 || getVarint(&pos, end, &header) != 0 ||
+                getVarintString(&pos, end, &value) != 0) {
+            return -1;
+        }
+        uint64_t arity = header >> 1;
+        bool isQvar = header & 1;
+        if (arity > ARITY_MAX || (isQvar && arity > 0) ||
+                (!isQvar && value.empty())) {
+            return -1;
+        }
+        if (isQvar) {
+            if (value.empty()) {
+                numAnonymousQvars++;
+            } else {
+                qvarNames.insert(value);
+            }
+            if (qvarNames.size() + numAnonymousQvars >
+                    ENCODED_QUERY_MAX_QVARS) {
+                return -1;
+            }
+        }
+        numMissing += arity - 1;
+        query->tokens.push_back(EncodedQueryToken(value, arity, isQvar));
+    }
+
+    return (numMissing == 0 && pos == end) ? 0 : -1;
+}
+
+string
+writeEncodedQuery(const EncodedQuery& query) {
+    string out;
+
+    out.append(ENCODED_QUERY_MAGIC, ENCODED_QUERY_MAGIC_SIZE);
+    out.push_back((char) ENCODED_QUERY_VERSION);
+    out.push_back((char) ((query.outputFormat == DATAFORMAT_BINARY) ?
+                          ENCODED_QUERY_BINARY : 0));
+    out.append(2, '\0');
+    putUint32(&out, query.offset);
+    putUint32(&out, query.size);
+    putUint32(&out, query.maxTotal);
+
+    putVarint(&out, query.tokens.size());
+    for (const EncodedQueryToken& token : query.tokens) {
+        putVarint(&out, ((uint64_t) token.arity << 1) | token.isQvar);
+        putVarintString(&out, token.value);
+    }
+
+    return out;
+}
+
+}  // namespace mws
@@ -0,0 +1,107 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef _MWS_QUERY_ENCODEDQUERY_HPP
+#define _MWS_QUERY_ENCODEDQUERY_HPP
+
+/**
+  * @file EncodedQuery.hpp
+  * @brief Pre-tokenized queries, answered without parsing XML
+  * @date 19 Oct 2026
+  *
+  * An encoded query is (integers in little-endian order):
+  *
+  *     "MWQE"           magic (framed requests start with "MWS")
+  *     uint8            format version (ENCODED_QUERY_VERSION)
+  *     uint8            flags (ENCODED_QUERY_*)
+  *     uint16           reserved, 0
+  *     uint32           offset of the first solution returned (limitmin)
+  *     uint32           maximum number of solutions returned (answsize)
+  *     uint32           maximum number of solutions counted (totalreq)
+  *     varint           number of tokens
+  *     tokens           in DFS order, each as a varint (arity << 1 | 1 for
+  *                      qvars), then a varint length and the bytes of the
+  *                      meaning (see CmmlToken::getMeaning()), or of the
+  *                      name of the qvar ("" for anonymous qvars)
+  */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "common/types/DataFormat.hpp"
+#include "mws/types/CmmlToken.hpp"
+
+namespace mws {
+
+/// Version of the encoded queries read
+const uint8_t ENCODED_QUERY_VERSION = 1;
+/// Flag set to get a binary answer set instead of JSON
+const uint8_t ENCODED_QUERY_BINARY  = 0x01;
+
+struct EncodedQueryToken {
+    /// meaning of a constant, or name of a qvar ("" if anonymous)
+    std::string value;
+    uint32_t    arity;
+    bool        isQvar;
+
+    EncodedQueryToken(const std::string& value, uint32_t arity, bool isQvar) :
+        value(value), arity(arity), isQvar(isQvar) {}
+};
+
+/**
+ * @brief Query expression and limits, as machine-generated queries send
+ * them instead of a mws:query document
+ */
+struct EncodedQuery {
+    /// tokens of the expression in DFS order
+    std::vector<EncodedQueryToken> tokens;
+    uint32_t    offset;
+    uint32_t    size;
+    uint32_t    maxTotal;
+    DataFormat  outputFormat;
+
+    EncodedQuery();
+
+    /// @brief set the tokens to the ones of an expression
+    void setExpression(const types::CmmlToken* expression);
+
+    /**
+     * @brief build the expression, for the indexes only CmmlTokens can be
+     * searched in
+     * @return expression, to be deleted by the caller
+     */
+    types::CmmlToken* toCmmlToken() const;
+};
+
+/**
+ * @brief Read an encoded query
+ * @return 0 on success, -1 if data is not an encoded query of one
+ * expression
+ */
+int readEncodedQuery(const char* data, size_t size, EncodedQuery* query);
+
+/// @return the encoded query, as read by readEncodedQuery()
+std::string writeEncodedQuery(const EncodedQuery& query);
+
+}  // namespace mws
+
+#endif  // _MWS_QUERY_ENCODEDQUERY_HPP
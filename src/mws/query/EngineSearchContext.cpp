@@ -0,0 +1,203 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+  * @file EngineSearchContext.cpp
+  * @brief Search context answering queries from a memsector index
+  * @date 19 Oct 2026
+  */
+
+#include <map>
+#include <stack>
+#include <string>
+#include <utility>
+
+#include "EngineSearchContext.hpp"
+#include "common/utils/ToString.hpp"
+#include "mws/query/query_engine.h"
+
+using namespace std;
+using namespace mws::types;
+
+namespace mws {
+
+namespace {
+
+struct ResultCollector {
+    MwsAnswset* result;
+    unsigned int offset;
+    unsigned int size;
+    unsigned int maxTotal;
+    unsigned int found;
+    const index::DeadHits* deadHits;
+};
+
+result_cb_return_t collectResult(void* handle, const leaf_t* leaf) {
+    ResultCollector* collector = (ResultCollector*) handle;
+
+    if (collector->deadHits != NULL &&
+            collector->deadHits->getLiveHits(leaf->dbid,
+                                             leaf->num_hits) == 0) {
+        return QUERY_CONTINUE;
+    }
+
+    if (collector->found >= collector->offset &&
+            collector->found < collector->offset + collector->size) {
+        Answer* answer = new Answer();
+        answer->formulaId = (FormulaId) leaf->dbid;
+        collector->result->answers.push_back(answer);
+    }
+    collector->found++;
+
+    return (collector->found < collector->maxTotal) ? QUERY_CONTINUE
+                                                     : QUERY_STOP;
+}
+
+}  // namespace
+
+EngineSearchContext::EngineSearchContext(const CmmlToken* expression,
+                                         MeaningDictionary* dict) :
+    m_matchable(true), m_deadHits(NULL), m_numQvars(0) {
+    stack<const CmmlToken*> tokenStack;
+
+    tokenStack.push(expression);
+    while (!tokenStack.empty()) {
+        const CmmlToken* token = tokenStack.top();
+        tokenStack.pop();
+
+        // Pushing the children on the stack (in reverse order to maintain DFS)
+        CmmlToken::PtrList::const_reverse_iterator rIt;
+        for (rIt = token->getChildNodes().rbegin();
+             rIt != token->getChildNodes().rend(); rIt++) {
+            tokenStack.push(*rIt);
+        }
+
+        if (token->isQvar()) {
+            addQvar(token->getQvarName(), token->getXpathRelative());
+        } else {
+            addConstant(token->getMeaning(), token->getChildNodes().size(),
+                        dict);
+        }
+        // larger queries would overflow the stacks of the engine
+        if (m_tokens.size() > MAX_QUERY_STACK_SIZE) {
+            m_matchable = false;
+            break;
+        }
+    }
+}
+
+EngineSearchContext::EngineSearchContext(const EncodedQuery& query,
+                                         MeaningDictionary* dict) :
+    m_matchable(true), m_deadHits(NULL), m_numQvars(0) {
+    // children seen so far and arity of the tokens missing children
+    vector<pair<uint32_t, uint32_t> > parents;
+
+    for (const EncodedQueryToken& token : query.tokens) {
+        if (token.isQvar) {
+            string xpath;
+            // only named qvars are reported with their xpath
+            if (!token.value.empty()) {
+                for (auto& parent : parents) {
+                    xpath += "/*[" + ToString(parent.first) + "]";
+                }
+            }
+            addQvar(token.value, xpath);
+        } else {
+            addConstant(token.value, token.arity, dict);
+        }
+
+        if (token.arity > 0) {
+            parents.push_back(make_pair(1, token.arity));
+        } else {
+            // move on to the next sibling of the closest unfinished parent
+            while (!parents.empty() &&
+                   parents.back().first == parents.back().second) {
+                parents.pop_back();
+            }
+            if (!parents.empty()) parents.back().first++;
+        }
+    }
+    // larger queries would overflow the stacks of the engine
+    if (m_tokens.size() > MAX_QUERY_STACK_SIZE) m_matchable = false;
+}
+
+void
+EngineSearchContext::addQvar(const string& name, const string& xpath) {
+    uint32_t qvarId;
+    map<string, uint32_t>::iterator it = m_qvarIds.find(name);
+
+    if (name == "") {
+        // anonymous qvars are all distinct
+        qvarId = QVAR_ID_MIN + m_numQvars++;
+    } else {
+        // Name / xpath book keeping
+        m_qvars.push_back(Qvar(name, xpath));
+        if (it == m_qvarIds.end()) {
+            qvarId = QVAR_ID_MIN + m_numQvars++;
+            m_qvarIds.insert(make_pair(name, qvarId));
+        } else {
+            qvarId = it->second;
+        }
+    }
+    if (qvarId > QVAR_ID_MAX) m_matchable = false;
+    m_tokens.push_back(encoded_token(qvarId, 0));
+}
+
+void
+EngineSearchContext::addConstant(const Meaning& meaning, uint32_t arity,
+                                 MeaningDictionary* dict) {
+    MeaningId meaningId = dict->get(meaning);
+    // a meaning missing from the index cannot match, nor can an arity
+    // which an encoded token does not hold
+    if (meaningId == MeaningDictionary::KEY_NOT_FOUND || arity > ARITY_MAX) {
+        m_matchable = false;
+    }
+    assert(meaningId == MeaningDictionary::KEY_NOT_FOUND ||
+           meaningId >= CONST_ID_MIN);
+    m_tokens.push_back(encoded_token(meaningId, arity));
+}
+
+MwsAnswset*
+EngineSearchContext::getResult(index_handle_t* index,
+                               unsigned int offset,
+                               unsigned int size,
+                               unsigned int maxTotal) {
+    ResultCollector collector;
+
+    collector.result   = new MwsAnswset();
+    collector.result->qvars = m_qvars;
+    collector.offset   = offset;
+    collector.size     = size;
+    collector.maxTotal = maxTotal;
+    collector.found    = 0;
+    collector.deadHits = m_deadHits;
+
+    if (m_matchable && maxTotal > 0) {
+        encoded_formula_t query;
+        query.data = m_tokens.data();
+        query.size = m_tokens.size();
+        (void) query_engine_run(index, &query, collectResult, &collector);
+    }
+    collector.result->total = collector.found;
+
+    return collector.result;
+}
+
+}  // namespace mws
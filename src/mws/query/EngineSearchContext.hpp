@@ -0,0 +1,108 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef _MWS_QUERY_ENGINESEARCHCONTEXT_HPP
+#define _MWS_QUERY_ENGINESEARCHCONTEXT_HPP
+
+/**
+  * @file EngineSearchContext.hpp
+  * @brief Search context answering queries from a memsector index
+  * @date 19 Oct 2026
+  */
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mws/query/EncodedQuery.hpp"
+#include "mws/types/CmmlToken.hpp"
+#include "mws/types/MeaningDictionary.hpp"
+#include "mws/types/MwsAnswset.hpp"
+#include "mws/index/encoded_token_dict.h"
+#include "mws/index/index.h"
+#include "mws/index/Tombstones.hpp"
+
+namespace mws {
+
+/**
+ * @brief Counterpart of SearchContext for memsector indexes, encoding the
+ * query for query_engine_run()
+ */
+class EngineSearchContext {
+    /// Query tokens in DFS order, qvars encoded as QVAR_ID_MIN + qvar number
+    std::vector<encoded_token_t> m_tokens;
+    std::vector<Qvar> m_qvars;
+    /// false if the query cannot match (unknown meaning or too many qvars)
+    /// or is too large for the query engine
+    bool m_matchable;
+    /// Hits of deleted documents, which are not solutions (or NULL)
+    const index::DeadHits* m_deadHits;
+    /// Ids of the named qvars
+    std::map<std::string, uint32_t> m_qvarIds;
+    uint32_t m_numQvars;
+
+public:
+    /**
+     * @param expression query expression
+     * @param dict meaning dictionary of the index, with ids starting at
+     * CONST_ID_MIN
+     */
+    EngineSearchContext(const types::CmmlToken* expression,
+                        types::MeaningDictionary* dict);
+
+    /**
+     * @param query encoded query, whose tokens are taken as they are
+     * @param dict meaning dictionary of the index, with ids starting at
+     * CONST_ID_MIN
+     */
+    EngineSearchContext(const EncodedQuery& query,
+                        types::MeaningDictionary* dict);
+
+    /**
+     * @brief Skip the leaves whose hits are all in deleted documents
+     * @param deadHits hits of the deleted documents (NULL to return all
+     * leaves)
+     */
+    void setDeadHits(const index::DeadHits* deadHits) {
+        m_deadHits = deadHits;
+    }
+
+    /**
+     * @brief Run the query against an index
+     * @param index memsector index
+     * @param offset offset where to start returning the solutions
+     * @param size maximum number of solutions to return
+     * @param maxTotal maximum number of solutions to count
+     * @return an answer set with the corresponding results
+     */
+    MwsAnswset* getResult(index_handle_t* index,
+                          unsigned int offset,
+                          unsigned int size,
+                          unsigned int maxTotal);
+
+private:
+    void addQvar(const std::string& name, const std::string& xpath);
+    void addConstant(const Meaning& meaning, uint32_t arity,
+                     types::MeaningDictionary* dict);
+};
+
+}  // namespace mws
+
+#endif  // _MWS_QUERY_ENGINESEARCHCONTEXT_HPP
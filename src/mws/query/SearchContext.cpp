@@ -44,7 +44,8 @@ using namespace mws;
 using namespace mws::types;
 
 
-SearchContext::SearchContext(CmmlToken* expression, MeaningDictionary* dict)
+SearchContext::SearchContext(CmmlToken* expression, MeaningDictionary* dict) :
+    accessCounts(NULL), deadHits(NULL)
 {
     int                                      tokenCount;
     map<std::string, int>                    indexedQvars;
@@ -139,6 +140,24 @@ SearchContext::~SearchContext()
 }
 
 
+void
+SearchContext::setAccessCounts(AccessCounts* counts)
+{
+    accessCounts = counts;
+    for (size_t i = 0; i < qvarTable.size(); i++)
+    {
+        qvarTable[i].accessCounts = counts;
+    }
+}
+
+
+void
+SearchContext::setDeadHits(const index::DeadHits* deleted)
+{
+    deadHits = deleted;
+}
+
+
 MwsAnswset*
 SearchContext::getResult(MwsIndexNode* data,
                          dbc::DbQueryManager* dbQueryManger,
@@ -165,6 +184,7 @@ SearchContext::getResult(MwsIndexNode* data,
 
     currentToken   = 0;      // Current token from expr vector
     currentNode    = data;   // Current MwsIndexNode
+    countAccess(accessCounts, currentNode);
     lastSolvedQvar = -1;     // Last qvar that was solved
 
     // Checking the arguments
@@ -206,6 +226,7 @@ SearchContext::getResult(MwsIndexNode* data,
                         if (mapIt != currentNode->children.end())
                         {
                             currentNode = mapIt->second;
+                            countAccess(accessCounts, currentNode);
                         }
                         else
                         {
@@ -235,6 +256,7 @@ SearchContext::getResult(MwsIndexNode* data,
                 if (mapIt != currentNode->children.end())
                 {
                     currentNode = mapIt->second;
+                    countAccess(accessCounts, currentNode);
                 }
                 else
                 {
@@ -242,6 +264,13 @@ SearchContext::getResult(MwsIndexNode* data,
                 }
             }
         }
+        else if (deadHits != NULL &&
+                 deadHits->getLiveHits((FormulaId)currentNode->id,
+                                       currentNode->solutions) == 0)
+        {
+            // All the hits are deleted
+            backtrack = true;
+        }
         else
         {
             // Handling the solutions
@@ -41,6 +41,7 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 #include "mws/types/MwsAnswset.hpp"
 #include "mws/dbc/DbQueryManger.hpp"
 #include "mws/index/MwsIndexNode.hpp"
+#include "mws/index/Tombstones.hpp"
 
 #include "SearchContextTypes.hpp"
 
@@ -59,6 +60,10 @@ struct SearchContext
     /// vector starts with -1 to mark the beginning
     std::vector<int> backtrackPoints;
     std::vector<Qvar> qvars;
+    /// Index node access counts to update (or NULL)
+    AccessCounts* accessCounts;
+    /// Hits of deleted documents, which are not solutions (or NULL)
+    const index::DeadHits* deadHits;
 
 
     // Constructors and Destructors
@@ -86,6 +91,21 @@ struct SearchContext
       * without returning).
       * @return an answer set with the corresponding results.
       */
+    /**
+      * @brief Method to count the index nodes visited by getResult(), for
+      * instance to export the index with EXPORT_LAYOUT_HOT.
+      * @param counts are the counts to update (NULL to stop counting).
+      */
+    void setAccessCounts(AccessCounts* counts);
+
+    /**
+      * @brief Method to skip the solutions whose hits are all in deleted
+      * documents.
+      * @param deleted are the hits of the deleted documents (NULL to
+      * return all).
+      */
+    void setDeadHits(const index::DeadHits* deleted);
+
     mws::MwsAnswset* getResult(mws::MwsIndexNode* aNode,
                                dbc::DbQueryManager* dbQueryManager,
                                unsigned int anOffset,
@@ -53,6 +53,15 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 namespace mws
 {
 
+inline void
+countAccess(AccessCounts* accessCounts, const MwsIndexNode* node)
+{
+    if (accessCounts != NULL)
+    {
+        (*accessCounts)[node]++;
+    }
+}
+
 struct qvarCtxt
 {
     typedef
@@ -66,6 +75,8 @@ struct qvarCtxt
         >
     > backtrackIterators;
     bool isSolved;
+    /// Access counts to update (or NULL)
+    AccessCounts* accessCounts;
 
     inline qvarCtxt()
     {
@@ -74,6 +85,7 @@ struct qvarCtxt
 #endif
 
         isSolved = false;
+        accessCounts = NULL;
 
 #ifdef TRACE_FUNC_CALLS
     LOG_TRACE_OUT;
@@ -108,6 +120,7 @@ struct qvarCtxt
             totalArrity += currentPair.first->first.second - 1;
             backtrackIterators.push_back(currentPair);
             node = currentPair.first->second;
+            countAccess(accessCounts, node);
         }
 
         isSolved = true;
@@ -150,6 +163,7 @@ struct qvarCtxt
         totalArrity += backtrackIterators.back().first->first.second - 1;
         // Found a valid next, now we need to complete it to the right arrity
         currentNode = backtrackIterators.back().first->second;
+        countAccess(accessCounts, currentNode);
         while (totalArrity)
         {
             currentPair = make_pair(currentNode->children.begin(),
@@ -157,6 +171,7 @@ struct qvarCtxt
             backtrackIterators.push_back(currentPair);
             // Updating currentNode and arrity
             currentNode = currentPair.first->second;
+            countAccess(accessCounts, currentNode);
             totalArrity += currentPair.first->first.second - 1;
         }
         // We have selected a different solution
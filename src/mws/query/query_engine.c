@@ -30,13 +30,6 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 #include "mws/index/encoded_token_dict.h"
 #include "common/utils/macro_func.h"
 
-/*--------------------------------------------------------------------------*/
-/* Constants                                                                */
-/*--------------------------------------------------------------------------*/
-
-#define MAX_VAR_INSTATIATION_SIZE       256
-#define MAX_QUERY_STACK_SIZE            512
-
 /*--------------------------------------------------------------------------*/
 /* Type declarations                                                        */
 /*--------------------------------------------------------------------------*/
@@ -70,6 +63,40 @@ void token_stack_pop_many(token_stack_t* RESTRICT stack, int to_pop) {
     stack->size -= to_pop;
 }
 
+/**
+ * tokens might already be in place above the top of the stack
+ */
+static inline
+void token_stack_push_many(token_stack_t* RESTRICT stack,
+                           const encoded_token_t* tokens, int size) {
+    memmove(stack->data + stack->size, tokens, size * sizeof(encoded_token_t));
+    stack->size += size;
+}
+
+/**
+ * @return true if num more tokens fit on the stack
+ */
+static inline
+bool token_stack_fits(const token_stack_t* RESTRICT stack, int num) {
+    return (stack->size + num <= MAX_QUERY_STACK_SIZE);
+}
+
+/**
+ * @return true if any of the top num tokens of the stack is a variable or if
+ * the stack holds less than num tokens
+ */
+static inline
+bool token_stack_has_var(const token_stack_t* RESTRICT stack, int num) {
+    int i;
+
+    if (stack->size < num) return true;
+    for (i = stack->size - num; i < stack->size; i++) {
+        if (encoded_token_is_var(stack->data[i])) return true;
+    }
+
+    return false;
+}
+
 static inline
 bool token_stack_empty(const token_stack_t* RESTRICT stack) {
     return (stack->size == 0);
@@ -78,12 +105,19 @@ bool token_stack_empty(const token_stack_t* RESTRICT stack) {
 typedef struct query_ctxt_s {
     /* query tokens and iterator */
     token_stack_t query_stack;
+    /* number of occurrences of each query variable */
+    int qvar_occurrences[VAR_ID_MAX + 1];
+
     /* index iterator */
+    const index_handle_t* index;
     const inode_t* curr_index_inode;
     token_stack_t index_stack;
 
+    /* dense leaf array of the index */
+    const leaf_t* leaves;
+
     /* var instantiations */
-    var_instantiation_t vars[VAR_ID_MAX];
+    var_instantiation_t vars[VAR_ID_MAX + 1];
     /* var solve stack */
     uint32_t solving_var_id;
 
@@ -109,9 +143,25 @@ void query_ctxt_init(query_ctxt_t* RESTRICT      query_ctxt,
 static
 int process_query_token(query_ctxt_t* query_ctxt);
 
+static
+bool query_matches_any_term(const query_ctxt_t* query_ctxt);
+
+static
+int report_leaf_range(query_ctxt_t* query_ctxt);
+
+static
+int process_path_node(query_ctxt_t* query_ctxt);
+
+static
+int match_query_to_hvars(query_ctxt_t* query_ctxt);
+
 static
 int match_var_to_index(query_ctxt_t* query_ctxt, uint32_t arity);
 
+static
+int var_append_token(query_ctxt_t* query_ctxt, var_instantiation_t* var,
+                     encoded_token_t token);
+
 static
 int match_var_to_query(query_ctxt_t* query_ctxt, uint32_t arity);
 
@@ -129,6 +179,8 @@ int query_engine_run(index_handle_t* RESTRICT    index,
 
     query_ctxt_t query_ctxt;
 
+    if (query->size > MAX_QUERY_STACK_SIZE) return QUERY_ERROR;
+
     query_ctxt_init(&query_ctxt, index, query, result_cb, result_cb_handle);
 
     return process_query_token(&query_ctxt);
@@ -147,7 +199,7 @@ void query_ctxt_init(query_ctxt_t* RESTRICT      query_ctxt,
     int i;
 
     // initialize variables table
-    for (i = 0; i < VAR_ID_MAX; i++) {
+    for (i = 0; i <= VAR_ID_MAX; i++) {
         query_ctxt->vars[i].solved = false;
     }
 
@@ -158,9 +210,21 @@ void query_ctxt_init(query_ctxt_t* RESTRICT      query_ctxt,
         query_ctxt->query_stack.data[size - i - 1] = query->data[i];
     }
 
+    // count query variable occurrences
+    for (i = 0; i <= VAR_ID_MAX; i++) {
+        query_ctxt->qvar_occurrences[i] = 0;
+    }
+    for (i = 0; i < size; i++) {
+        if (encoded_token_is_var(query->data[i])) {
+            query_ctxt->qvar_occurrences[encoded_token_get_id(query->data[i])]++;
+        }
+    }
+
     // intialize index
+    query_ctxt->index = index;
     query_ctxt->curr_index_inode = index->root;
     query_ctxt->index_stack.size = 0;
+    query_ctxt->leaves = index->leaves;
 
     // initialize memsector alloc
     query_ctxt->alloc = index->alloc;
@@ -183,6 +247,17 @@ int process_query_token(query_ctxt_t* RESTRICT query_ctxt) {
         return query_ctxt->result_cb(query_ctxt->result_cb_handle, leaf);
     }
 
+    // check if any term matches the rest of the query - report the subtree
+    if (query_matches_any_term(query_ctxt)) {
+        return report_leaf_range(query_ctxt);
+    }
+
+    // check if we reached a path node - match its run of tokens
+    if (token_stack_empty(&query_ctxt->index_stack) &&
+            query_ctxt->curr_index_inode->type == PATH_NODE) {
+        return process_path_node(query_ctxt);
+    }
+
     // otherwise get next token and find match
     encoded_token_t query_token = token_stack_pop(query);
 
@@ -193,16 +268,18 @@ int process_query_token(query_ctxt_t* RESTRICT query_ctxt) {
             var_instantiation_t* var = &query_ctxt->vars[var_id];
             int i;
             int size = var->num_tokens;
-            for (i = 0; i < size; ++i) {
-                token_stack_push(query, var->tokens[size - i - 1]);
-            }
+            if (token_stack_fits(query, size)) {
+                for (i = 0; i < size; ++i) {
+                    token_stack_push(query, var->tokens[size - i - 1]);
+                }
 
-            // continue
-            ret = process_query_token(query_ctxt);
-            if (ret != QUERY_CONTINUE) return ret;
+                // continue
+                ret = process_query_token(query_ctxt);
+                if (ret != QUERY_CONTINUE) return ret;
 
-            // revert token stack
-            token_stack_pop_many(query, size);
+                // revert token stack
+                token_stack_pop_many(query, size);
+            }
         } else { // unsolved
             query_ctxt->solving_var_id = var_id;
             query_ctxt->vars[var_id].num_tokens = 0;
@@ -221,9 +298,29 @@ int process_query_token(query_ctxt_t* RESTRICT query_ctxt) {
                 token_stack_push(query, query_token);
 
                 int var_id = encoded_token_get_id(index_token);
-                query_ctxt->solving_var_id = var_id;
-                ret = match_var_to_query(query_ctxt, 1);
-                if (ret != QUERY_CONTINUE) return ret;
+                var_instantiation_t* var = &query_ctxt->vars[var_id];
+                if (var->solved) { // solved
+                    int i;
+                    int size = var->num_tokens;
+                    if (token_stack_fits(&query_ctxt->index_stack, size)) {
+                        for (i = 0; i < size; ++i) {
+                            token_stack_push(&query_ctxt->index_stack,
+                                             var->tokens[size - i - 1]);
+                        }
+
+                        // continue
+                        ret = process_query_token(query_ctxt);
+                        if (ret != QUERY_CONTINUE) return ret;
+
+                        // revert index stack
+                        token_stack_pop_many(&query_ctxt->index_stack, size);
+                    }
+                } else { // unsolved
+                    query_ctxt->solving_var_id = var_id;
+                    var->num_tokens = 0;
+                    ret = match_var_to_query(query_ctxt, 1);
+                    if (ret != QUERY_CONTINUE) return ret;
+                }
             } else { // constant index token
                 if (memcmp(&query_token, &index_token, sizeof(query_token)) == 0) {
                     // continue
@@ -238,7 +335,8 @@ int process_query_token(query_ctxt_t* RESTRICT query_ctxt) {
         } else { // regular index
 
             const inode_t* curr = query_ctxt->curr_index_inode;
-            memsector_off_t off = inode_get_child(curr, query_token);
+            memsector_off_t off = index_get_child(query_ctxt->index, curr,
+                                                  query_token);
             if (off != 0) {
                 const inode_t* child =
                         (inode_t*) memsector_off2addr(query_ctxt->alloc, off);
@@ -251,20 +349,166 @@ int process_query_token(query_ctxt_t* RESTRICT query_ctxt) {
 
                 // revert
                 query_ctxt->curr_index_inode = curr;
+            }
 
-                // revert query token before hvars processing
-                token_stack_push(query, query_token);
+            // revert query token before hvars processing
+            token_stack_push(query, query_token);
 
-                // hvars
-                uint32_t hvar_id_max = inode_get_max_var(query_ctxt->curr_index_inode);
-                uint32_t hvar_id;
-                for (hvar_id = 0; hvar_id < hvar_id_max; hvar_id++) {
-                    query_ctxt->solving_var_id = hvar_id;
-                    ret = match_var_to_query(query_ctxt, 1);
-                    if (ret != QUERY_CONTINUE) return ret;
+            // hvars
+            ret = match_query_to_hvars(query_ctxt);
+            if (ret != QUERY_CONTINUE) return ret;
+        }
+    }
+
+    return QUERY_CONTINUE;
+}
+
+/**
+ * @return run of a path node, compact ones decoded right above the top of
+ * the index stack, or NULL if the run does not fit there
+ */
+static inline
+const encoded_token_t* get_path_tokens(query_ctxt_t* RESTRICT query_ctxt,
+                                       const pnode_t* path) {
+    token_stack_t* index_stack = &query_ctxt->index_stack;
+
+    if (!token_stack_fits(index_stack, path->size)) return NULL;
+
+    return pnode_get_tokens(query_ctxt->index, path,
+                            index_stack->data + index_stack->size);
+}
+
+/**
+ * Match the run of a path node. If the top of the query stack equals the run,
+ * it is skipped at once. Otherwise, unless the query has only constants there,
+ * the run is moved to the index stack to be matched token by token. Runs
+ * which do not fit on the index stack are not descended into.
+ */
+static
+int process_path_node(query_ctxt_t* RESTRICT query_ctxt) {
+    int ret;
+    token_stack_t* query = &query_ctxt->query_stack;
+    const inode_t* curr = query_ctxt->curr_index_inode;
+    const pnode_t* path = (const pnode_t*) curr;
+    const int size = path->size;
+    const encoded_token_t* tokens = get_path_tokens(query_ctxt, path);
+    if (tokens == NULL) return QUERY_CONTINUE;
+
+    const inode_t* next =
+            (inode_t*) memsector_off2addr(query_ctxt->alloc, path->next);
+
+    query_ctxt->curr_index_inode = next;
+
+    if (query->size >= size &&
+            memcmp(query->data + query->size - size, tokens,
+                   size * sizeof(encoded_token_t)) == 0) { // exact run
+        token_stack_pop_many(query, size);
+
+        // continue
+        ret = process_query_token(query_ctxt);
+        if (ret != QUERY_CONTINUE) return ret;
+
+        // revert query stack (a decoded run might have been overwritten)
+        token_stack_push_many(query, get_path_tokens(query_ctxt, path), size);
+    } else if (token_stack_has_var(query, size)) { // match token by token
+        token_stack_push_many(&query_ctxt->index_stack, tokens, size);
+
+        // continue
+        ret = process_query_token(query_ctxt);
+        if (ret != QUERY_CONTINUE) return ret;
+
+        // revert index stack
+        token_stack_pop_many(&query_ctxt->index_stack, size);
+    }
+
+    query_ctxt->curr_index_inode = curr;
+
+    return QUERY_CONTINUE;
+}
+
+/**
+ * Match the query term on top of the query stack to the index variables of
+ * the current inode, which are stored in their own section of it.
+ */
+static
+int match_query_to_hvars(query_ctxt_t* RESTRICT query_ctxt) {
+    int ret;
+    const inode_t* curr = query_ctxt->curr_index_inode;
+    const encoded_token_dict_entry_t* hvars = inode_get_vars(curr);
+    uint32_t i;
+
+    for (i = 0; i < curr->num_vars; i++) {
+        uint32_t hvar_id = encoded_token_get_id(hvars[i].token);
+        var_instantiation_t* hvar = &query_ctxt->vars[hvar_id];
+
+        query_ctxt->curr_index_inode =
+                (inode_t*) memsector_off2addr(query_ctxt->alloc, hvars[i].off);
+
+        if (hvar->solved) { // compare instantiation to the query
+            int j;
+            if (token_stack_fits(&query_ctxt->index_stack, hvar->num_tokens)) {
+                for (j = hvar->num_tokens - 1; j >= 0; --j) {
+                    token_stack_push(&query_ctxt->index_stack,
+                                     hvar->tokens[j]);
                 }
+
+                // continue
+                ret = process_query_token(query_ctxt);
+                if (ret != QUERY_CONTINUE) return ret;
+
+                // revert index stack
+                token_stack_pop_many(&query_ctxt->index_stack,
+                                     hvar->num_tokens);
             }
+        } else { // instantiate to the query term
+            query_ctxt->solving_var_id = hvar_id;
+            hvar->num_tokens = 0;
+            ret = match_var_to_query(query_ctxt, 1);
+            if (ret != QUERY_CONTINUE) return ret;
         }
+
+        // revert
+        query_ctxt->curr_index_inode = curr;
+    }
+
+    return QUERY_CONTINUE;
+}
+
+/**
+ * The rest of the query matches any term if it consists only of query
+ * variables which occur once. Solved index variables might be instantiated to
+ * query variables, so this only applies as long as none is solved.
+ */
+static
+bool query_matches_any_term(const query_ctxt_t* RESTRICT query_ctxt) {
+    const token_stack_t* query = &query_ctxt->query_stack;
+    int i;
+
+    if (!token_stack_empty(&query_ctxt->index_stack)) return false;
+
+    for (i = query->size - 1; i >= 0; i--) {
+        uint32_t var_id = encoded_token_get_id(query->data[i]);
+        if (var_id < QVAR_ID_MIN || var_id > QVAR_ID_MAX) return false;
+        if (query_ctxt->qvar_occurrences[var_id] != 1) return false;
+    }
+
+    for (i = HVAR_ID_MIN; i <= HVAR_ID_MAX; i++) {
+        if (query_ctxt->vars[i].solved) return false;
+    }
+
+    return true;
+}
+
+static
+int report_leaf_range(query_ctxt_t* RESTRICT query_ctxt) {
+    int ret;
+    const inode_t* curr = query_ctxt->curr_index_inode;
+    const leaf_t* leaf = &query_ctxt->leaves[curr->leaves_begin];
+    const leaf_t* end  = &query_ctxt->leaves[curr->leaves_end];
+
+    for (; leaf < end; leaf++) {
+        ret = query_ctxt->result_cb(query_ctxt->result_cb_handle, leaf);
+        if (ret != QUERY_CONTINUE) return ret;
     }
 
     return QUERY_CONTINUE;
@@ -289,64 +533,58 @@ int match_var_to_index(query_ctxt_t* RESTRICT query_ctxt, uint32_t arity) {
         var->solved = false;
 
     } else if (!token_stack_empty(&query_ctxt->index_stack)) { // index stack
-        return match_var_to_stack(query_ctxt, &query_ctxt->index_stack);
+        // the index stack might hold only a prefix of the term
+        encoded_token_t token = token_stack_pop(&query_ctxt->index_stack);
+        int pushed_var_tokens = var_append_token(query_ctxt, var, token);
+        if (pushed_var_tokens >= 0) {
+            // continue
+            ret = match_var_to_index(query_ctxt, arity + token.arity - 1);
+            if (ret != QUERY_CONTINUE) return ret;
+
+            // revert
+            var->num_tokens -= pushed_var_tokens;
+        }
+        token_stack_push(&query_ctxt->index_stack, token);
+
+    } else if (query_ctxt->curr_index_inode->type == PATH_NODE) { // path
+        const inode_t* curr = query_ctxt->curr_index_inode;
+        const pnode_t* path = (const pnode_t*) curr;
+        const encoded_token_t* tokens = get_path_tokens(query_ctxt, path);
+        if (tokens == NULL) return QUERY_CONTINUE;
+        token_stack_push_many(&query_ctxt->index_stack, tokens, path->size);
+        query_ctxt->curr_index_inode =
+                (inode_t*) memsector_off2addr(query_ctxt->alloc, path->next);
+
+        // continue
+        ret = match_var_to_index(query_ctxt, arity);
+        if (ret != QUERY_CONTINUE) return ret;
+
+        // revert
+        token_stack_pop_many(&query_ctxt->index_stack, path->size);
+        query_ctxt->curr_index_inode = curr;
+
     } else { // regular index
 
-        uint32_t i;
-        uint32_t size = query_ctxt->curr_index_inode->size;
-        const encoded_token_dict_entry_t* data = query_ctxt->curr_index_inode->data;
-
-        for (i = 0; i < size; ++i) {
-            const encoded_token_dict_entry_t* entry = &data[i];
-            int pushed_var_tokens = 0;
-            token_stack_t var_stack;
-            var_stack.size = 0;
-            token_stack_push(&var_stack, entry->token);
-
-            while (!token_stack_empty(&var_stack)) {
-                encoded_token_t token = token_stack_pop(&var_stack);
-                if (encoded_token_is_var(token)) { // var
-                    uint32_t var_id = encoded_token_get_id(token);
-                    // check self-referencing variable
-                    if (var_id == query_ctxt->solving_var_id) {
-                        if (token_stack_empty(&var_stack) && var->num_tokens == 0) {
-                            // variable self references (e.g. Q1 -> H1 -> Q1)
-                            // => set as not solved and proceed
-                            break;
-                        } else {
-                            // variable is infinitely recursive
-                            // (e.g. Q1 -> f(H1) -> f(g(Q1)))
-                            // => no solution
-                            goto revert_index;
-                        }
-                    }
-                    if (query_ctxt->vars[var_id].solved) { // solved var
-                        var_instantiation_t* solved_var = &query_ctxt->vars[var_id];
-                        // push in reverse order on stack
-                        int i;
-                        for (i = solved_var->num_tokens - 1; i >= 0; --i) {
-                            token_stack_push(&var_stack, solved_var->tokens[i]);
-                        }
-                        continue;
-                    }
-                }
-                // save to var_instantiation
-                var->tokens[var->num_tokens] = token;
-                var->num_tokens++;
-                pushed_var_tokens++;
-            }
+        const inode_t* curr = query_ctxt->curr_index_inode;
+        inode_iter_t it;
+        encoded_token_t child_token;
+        memsector_off_t child_off;
+
+        inode_iter_init(&it, query_ctxt->index, curr);
+        while (inode_iter_next(&it, &child_token, &child_off)) {
+            int pushed_var_tokens = var_append_token(query_ctxt, var,
+                                                     child_token);
+            if (pushed_var_tokens < 0) continue;
 
             // advance in the index
-            const inode_t* curr = query_ctxt->curr_index_inode;
             const inode_t* child =
-                    (inode_t*) memsector_off2addr(query_ctxt->alloc, entry->off);
+                    (inode_t*) memsector_off2addr(query_ctxt->alloc, child_off);
             query_ctxt->curr_index_inode = child;
 
             // continue
-            ret = match_var_to_index(query_ctxt, arity + entry->token.arity - 1);
+            ret = match_var_to_index(query_ctxt, arity + child_token.arity - 1);
             if (ret != QUERY_CONTINUE) return ret;
 
-revert_index:
             // revert
             var->num_tokens -= pushed_var_tokens;
             query_ctxt->curr_index_inode = curr;
@@ -356,6 +594,68 @@ revert_index:
     return QUERY_CONTINUE;
 }
 
+/**
+ * Append an index token to the instantiation of the variable being solved,
+ * replacing solved variables by their instantiation.
+ *
+ * @return number of tokens appended or -1 if the variable would be
+ * infinitely recursive
+ */
+static
+int var_append_token(query_ctxt_t* RESTRICT query_ctxt,
+                     var_instantiation_t* RESTRICT var,
+                     encoded_token_t token) {
+    int pushed_var_tokens = 0;
+    token_stack_t var_stack;
+    var_stack.size = 0;
+    token_stack_push(&var_stack, token);
+
+    while (!token_stack_empty(&var_stack)) {
+        encoded_token_t token = token_stack_pop(&var_stack);
+        if (encoded_token_is_var(token)) { // var
+            uint32_t var_id = encoded_token_get_id(token);
+            // check self-referencing variable
+            if (var_id == query_ctxt->solving_var_id) {
+                if (token_stack_empty(&var_stack) && var->num_tokens == 0) {
+                    // variable self references (e.g. Q1 -> H1 -> Q1)
+                    // => set as not solved and proceed
+                    break;
+                } else {
+                    // variable is infinitely recursive
+                    // (e.g. Q1 -> f(H1) -> f(g(Q1)))
+                    // => no solution
+                    var->num_tokens -= pushed_var_tokens;
+                    return -1;
+                }
+            }
+            if (query_ctxt->vars[var_id].solved) { // solved var
+                var_instantiation_t* solved_var = &query_ctxt->vars[var_id];
+                // push in reverse order on stack
+                int i;
+                if (!token_stack_fits(&var_stack, solved_var->num_tokens)) {
+                    var->num_tokens -= pushed_var_tokens;
+                    return -1;
+                }
+                for (i = solved_var->num_tokens - 1; i >= 0; --i) {
+                    token_stack_push(&var_stack, solved_var->tokens[i]);
+                }
+                continue;
+            }
+        }
+        // instantiations longer than a var holds have no solution
+        if (var->num_tokens == MAX_VAR_INSTATIATION_SIZE) {
+            var->num_tokens -= pushed_var_tokens;
+            return -1;
+        }
+        // save to var_instantiation
+        var->tokens[var->num_tokens] = token;
+        var->num_tokens++;
+        pushed_var_tokens++;
+    }
+
+    return pushed_var_tokens;
+}
+
 static
 int match_var_to_query(query_ctxt_t* query_ctxt, uint32_t arity) {
     UNUSED(arity);
@@ -411,12 +711,17 @@ int match_var_to_stack(query_ctxt_t* query_ctxt, token_stack_t* stack) {
                 var_instantiation_t* solved_var = &query_ctxt->vars[var_id];
                 // push in reverse order on stack
                 int i;
+                if (!token_stack_fits(&var_stack, solved_var->num_tokens)) {
+                    goto revert_stack;
+                }
                 for (i = solved_var->num_tokens - 1; i >= 0; --i) {
                     token_stack_push(&var_stack, solved_var->tokens[i]);
                 }
                 continue;
             }
         }
+        // instantiations longer than a var holds have no solution
+        if (var->num_tokens == MAX_VAR_INSTATIATION_SIZE) goto revert_stack;
         // save to var_instantiation
         var->tokens[var->num_tokens] = token;
         var->num_tokens++;
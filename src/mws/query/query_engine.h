@@ -34,6 +34,15 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 #include "mws/index/encoded_token_dict.h"
 #include "common/utils/compiler_defs.h"
 
+/*--------------------------------------------------------------------------*/
+/* Constants                                                                */
+/*--------------------------------------------------------------------------*/
+
+/** Tokens of a query at most, and of each stack of the engine */
+#define MAX_QUERY_STACK_SIZE            512
+/** Tokens a variable is instantiated to at most */
+#define MAX_VAR_INSTATIATION_SIZE       256
+
 /*--------------------------------------------------------------------------*/
 /* Type declarations                                                        */
 /*--------------------------------------------------------------------------*/
@@ -145,6 +145,17 @@ public:
         }
     }
 
+    /**
+      * @brief Method to remove an element from the Map.
+      * @param it is an iterator to the element to be removed.
+      * @return an iterator to the element following the removed one.
+      */
+    inline iterator
+    erase(iterator it)
+    {
+        return _data.erase(it);
+    }
+
     /**
       * @brief Method to obtain an iterator to the beginning of the VectorMap.
       * @return an iterator to the beginning of the VectorMap.
@@ -164,6 +175,18 @@ public:
     {
         return _data.end();
     }
+
+    inline const_iterator
+    begin() const
+    {
+        return _data.begin();
+    }
+
+    inline const_iterator
+    end() const
+    {
+        return _data.end();
+    }
 };
 
 template<>
@@ -0,0 +1,182 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+  * @brief File containing the implementation of the readMwsDeleteFromFd
+  * function
+  * @file readMwsDeleteFromFd.cpp
+  * @date 19 Oct 2026
+  *
+  * License: GPL v3
+  */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <libxml/parser.h>
+
+#include <algorithm>
+
+#include "readMwsDeleteFromFd.hpp"
+
+#define MWSDELETE_MAIN_NAME            "mws:delete"
+#define MWSDELETE_DOC_NAME             "mws:doc"
+#define MWSDELETE_DOC_ATTR_URI_NAME    "url"
+
+using namespace std;
+
+namespace {
+
+struct MwsDelete_SaxUserData {
+    vector<string>* urls;
+    bool            inDelete;
+    bool            errorDetected;
+};
+
+/// Delete document held in memory
+struct MemoryInput {
+    const char* data;
+    size_t      size;
+};
+
+int
+fdXmlInputReadCallback(void* fdPtr, char* buffer, int len)
+{
+    return read(*(int*) fdPtr, (void*) buffer, (size_t) len);
+}
+
+int
+memoryXmlInputReadCallback(void* inputPtr, char* buffer, int len)
+{
+    MemoryInput* input = (MemoryInput*) inputPtr;
+    size_t result = min((size_t) len, input->size);
+
+    memcpy(buffer, input->data, result);
+    input->data += result;
+    input->size -= result;
+
+    return result;
+}
+
+void
+my_startElement(void* user_data, const xmlChar* name, const xmlChar** attrs)
+{
+    MwsDelete_SaxUserData* data = (MwsDelete_SaxUserData*) user_data;
+
+    if (strcmp((const char*) name, MWSDELETE_MAIN_NAME) == 0) {
+        data->inDelete = true;
+    } else if (data->inDelete &&
+               strcmp((const char*) name, MWSDELETE_DOC_NAME) == 0) {
+        while (attrs != NULL && attrs[0] != NULL) {
+            if (strcmp((const char*) attrs[0],
+                       MWSDELETE_DOC_ATTR_URI_NAME) == 0) {
+                data->urls->push_back((const char*) attrs[1]);
+            }
+            attrs += 2;
+        }
+    }
+}
+
+void
+my_endElement(void* user_data, const xmlChar* name)
+{
+    MwsDelete_SaxUserData* data = (MwsDelete_SaxUserData*) user_data;
+
+    if (strcmp((const char*) name, MWSDELETE_MAIN_NAME) == 0) {
+        data->inDelete = false;
+    }
+}
+
+void
+my_error(void* user_data, const char* msg, ...)
+{
+    MwsDelete_SaxUserData* data = (MwsDelete_SaxUserData*) user_data;
+    va_list args;
+
+    data->errorDetected = true;
+    va_start(args, msg);
+    vfprintf(stderr, msg, args);
+    va_end(args);
+}
+
+/// Parse the delete document read by readCallback from inputContext
+int
+readMwsDelete(xmlInputReadCallback readCallback, void* inputContext,
+              vector<string>* urls)
+{
+    MwsDelete_SaxUserData user_data;
+    xmlSAXHandler         saxHandler;
+    xmlParserCtxtPtr      ctxtPtr;
+    int                   ret;
+
+    user_data.urls          = urls;
+    user_data.inDelete      = false;
+    user_data.errorDetected = false;
+
+    memset(&saxHandler, 0, sizeof(xmlSAXHandler));
+    saxHandler.startElement = my_startElement;
+    saxHandler.endElement   = my_endElement;
+    saxHandler.error        = my_error;
+    saxHandler.fatalError   = my_error;
+
+    // Locking libXML -- to allow multi-threaded use
+    xmlLockLibrary();
+
+    ctxtPtr = xmlCreateIOParserCtxt(&saxHandler, &user_data,
+                                    readCallback, NULL, inputContext,
+                                    XML_CHAR_ENCODING_UTF8);
+    if (ctxtPtr == NULL) {
+        fprintf(stderr, "Error while creating the ParserContext\n");
+        xmlUnlockLibrary();
+        return -1;
+    }
+
+    ret = xmlParseDocument(ctxtPtr);
+    if (ret == -1 || !ctxtPtr->wellFormed || user_data.errorDetected) {
+        fprintf(stderr, "Bad delete document\n");
+        ret = -1;
+    }
+
+    xmlFreeParserCtxt(ctxtPtr);
+    xmlUnlockLibrary();
+
+    return ret;
+}
+
+}  // namespace
+
+namespace mws
+{
+
+int readMwsDeleteFromFd(int fd, vector<string>* urls)
+{
+    return readMwsDelete(fdXmlInputReadCallback, &fd, urls);
+}
+
+int readMwsDeleteFromMemory(const char* data, size_t size,
+                            vector<string>* urls)
+{
+    MemoryInput input = { data, size };
+
+    return readMwsDelete(memoryXmlInputReadCallback, &input, urls);
+}
+
+}
@@ -0,0 +1,64 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef _READMWSDELETEFROMFD_HPP
+#define _READMWSDELETEFROMFD_HPP
+
+/**
+  * @brief File containing the header of the readMwsDeleteFromFd function
+  *
+  * @file readMwsDeleteFromFd.hpp
+  * @date 19 Oct 2026
+  *
+  * License: GPL v3
+  *
+  */
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+namespace mws
+{
+
+/**
+  * @brief Function to read the documents to delete from an input file
+  * descriptor, given as
+  * <mws:delete><mws:doc url="..."/>...</mws:delete>
+  * @param fd is the file descriptor from where to read.
+  * @param urls is where to append the urls of the documents.
+  * @return 0 on success, -1 if the document could not be parsed.
+  */
+int readMwsDeleteFromFd(int fd, std::vector<std::string>* urls);
+
+/**
+  * @brief Function to read the documents to delete from a delete document
+  * held in memory.
+  * @param data is the delete document.
+  * @param size is the size of the delete document.
+  * @param urls is where to append the urls of the documents.
+  * @return 0 on success, -1 if the document could not be parsed.
+  */
+int readMwsDeleteFromMemory(const char* data, size_t size,
+                            std::vector<std::string>* urls);
+
+}
+
+#endif
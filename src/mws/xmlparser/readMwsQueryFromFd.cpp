@@ -39,6 +39,7 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 #include <sys/types.h>                 // Primitive System datatypes
 #include <sys/stat.h>                  // POSIX File characteristics
 #include <fcntl.h>                     // File control operations
+#include <algorithm>                   // STL algorithms
 
 // Local includes
 
@@ -88,6 +89,34 @@ fdXmlInputReadCallback(void* fdPtr,
 }
 
 
+/// Query document held in memory
+struct MemoryInput {
+    const char* data;
+    size_t      size;
+};
+
+
+/**
+  * @brief Callback function used to read a document held in memory with an IO
+  * context parser
+  *
+  */
+static inline int
+memoryXmlInputReadCallback(void* inputPtr,
+                           char* buffer,
+                           int   len)
+{
+    MemoryInput* input = (MemoryInput*) inputPtr;
+    size_t result = min((size_t) len, input->size);
+
+    memcpy(buffer, input->data, result);
+    input->data += result;
+    input->size -= result;
+
+    return result;
+}
+
+
 /**
   * @brief This function is called before the SAX handler starts parsing the
   * document
@@ -207,6 +236,12 @@ my_startElement(void*           user_data,
                             data->result->attrResultOutputFormat =
                                 DATAFORMAT_JSON;
                         }
+                        else if (strcmp((char*) attrs[1],
+                                    "binary") == 0)
+                        {
+                            data->result->attrResultOutputFormat =
+                                DATAFORMAT_BINARY;
+                        }
                         else
                         {
                             data->result->attrResultOutputFormat =
@@ -472,7 +507,11 @@ my_fatalError(void*       user_data,
 namespace mws
 {
 
-MwsQuery* readMwsQueryFromFd(int fd)
+/**
+  * @brief Parse a MwsQuery read by readCallback from inputContext
+  */
+static MwsQuery*
+readMwsQuery(xmlInputReadCallback readCallback, void* inputContext)
 {
     MwsQuery_SaxUserData user_data;
     xmlSAXHandler        saxHandler;
@@ -515,9 +554,9 @@ MwsQuery* readMwsQueryFromFd(int fd)
     // Creating the IOParser context
     ctxtPtr = xmlCreateIOParserCtxt(&saxHandler,
                                     &user_data,
-                                    fdXmlInputReadCallback,
+                                    readCallback,
                                     NULL,
-                                    &fd,
+                                    inputContext,
                                     XML_CHAR_ENCODING_UTF8);
     if (ctxtPtr == NULL)
     {
@@ -546,4 +585,16 @@ MwsQuery* readMwsQueryFromFd(int fd)
     return user_data.result;
 }
 
+MwsQuery* readMwsQueryFromFd(int fd)
+{
+    return readMwsQuery(fdXmlInputReadCallback, &fd);
+}
+
+MwsQuery* readMwsQueryFromMemory(const char* data, size_t size)
+{
+    MemoryInput input = { data, size };
+
+    return readMwsQuery(memoryXmlInputReadCallback, &input);
+}
+
 }
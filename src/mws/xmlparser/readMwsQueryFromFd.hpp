@@ -32,6 +32,8 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
   *
   */
 
+#include <stddef.h>
+
 // Local includes
 
 #include "mws/types/MwsQuery.hpp"      // MwsQuery datatype header
@@ -47,6 +49,15 @@ namespace mws
   */
 mws::MwsQuery* readMwsQueryFromFd(int fd);
 
+/**
+  * @brief Function to read a MwsQuery held in memory.
+  * @param data is the query document.
+  * @param size is the size of the query document.
+  * @return a pointer to a MwsQuery containing the information read or NULL in
+  * case of failure.
+  */
+mws::MwsQuery* readMwsQueryFromMemory(const char* data, size_t size);
+
 }
 
 #endif
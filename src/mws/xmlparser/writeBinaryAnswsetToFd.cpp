@@ -0,0 +1,207 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+  * @brief   Compact binary answer sets, for clients which only need the
+  * formula ids
+  * @file    writeBinaryAnswsetToFd.cpp
+  * @date    19 Oct 2026
+  *
+  * License: GPL v3
+  *
+  */
+
+#include <string.h>
+#include <unistd.h>
+
+#include "writeBinaryAnswsetToFd.hpp"
+#include "common/utils/BinaryEncoding.hpp"
+
+using namespace std;
+using namespace mws;
+using namespace mws::types;
+
+namespace mws
+{
+
+namespace {
+
+const char   BINARY_ANSWSET_MAGIC[] = "MWSA";
+const size_t BINARY_ANSWSET_MAGIC_SIZE = 4;
+const size_t BINARY_ANSWSET_HEADER_SIZE = 16;
+const char   BINARY_ANSWSETS_MAGIC[] = "MWSB";
+const size_t BINARY_ANSWSETS_HEADER_SIZE = 12;
+
+}  // namespace
+
+string
+writeBinaryAnswsetToString(const mws::MwsAnswset* answset)
+{
+    string      out;
+    FormulaId   previous = 0;
+    uint8_t     flags = answset->qvars.empty() ? 0 : BINARY_ANSWSET_QVARS;
+
+    // formula ids close to each other take a byte or two
+    out.reserve(BINARY_ANSWSET_HEADER_SIZE + 2 * answset->answers.size());
+    out.append(BINARY_ANSWSET_MAGIC, BINARY_ANSWSET_MAGIC_SIZE);
+    out.push_back((char) BINARY_ANSWSET_VERSION);
+    out.push_back((char) flags);
+    out.append(2, '\0');
+    putUint32(&out, answset->answers.size());
+    putUint32(&out, answset->total);
+
+    for (auto answer : answset->answers) {
+        int64_t delta = (int64_t) answer->formulaId - (int64_t) previous;
+        putVarint(&out, ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63));
+        previous = answer->formulaId;
+    }
+
+    if (flags & BINARY_ANSWSET_QVARS) {
+        putVarint(&out, answset->qvars.size());
+        for (auto& qvar : answset->qvars) {
+            putVarintString(&out, qvar.name);
+            putVarintString(&out, qvar.xpath);
+        }
+    }
+
+    return out;
+}
+
+int
+writeBinaryAnswsetToFd(mws::MwsAnswset* answset, int fd)
+{
+    const char*                data;
+    size_t                     data_size;
+    size_t                     bytes_written;
+    ssize_t                    n;
+    string                     out;
+
+    out = writeBinaryAnswsetToString(answset);
+    data = out.data();
+    data_size = out.size();
+
+    bytes_written = 0;
+    while (bytes_written < data_size) {
+        n = write(fd, data + bytes_written, data_size - bytes_written);
+        if (n < 0) return -1;
+        bytes_written += n;
+    }
+
+    return data_size;
+}
+
+int
+readBinaryAnswset(const char* data, size_t size, mws::MwsAnswset* answset)
+{
+    const unsigned char* pos = (const unsigned char*) data;
+    const unsigned char* end = pos + size;
+    uint32_t             numAnswers;
+    uint64_t             value, numQvars;
+    FormulaId            previous = 0;
+
+    if (size < BINARY_ANSWSET_HEADER_SIZE ||
+            memcmp(data, BINARY_ANSWSET_MAGIC,
+                   BINARY_ANSWSET_MAGIC_SIZE) != 0 ||
+            pos[4] != BINARY_ANSWSET_VERSION) {
+        return -1;
+    }
+    uint8_t flags = pos[5];
+    numAnswers = getUint32(pos + 8);
+    answset->total = getUint32(pos + 12);
+    pos += BINARY_ANSWSET_HEADER_SIZE;
+
+    // every formula id takes at least a byte
+    if (numAnswers > (size_t) (end - pos)) return -1;
+    answset->answers.reserve(numAnswers);
+    for (uint32_t i = 0; i < numAnswers; i++) {
+        if (getVarint(&pos, end, &value) != 0) return -1;
+        int64_t delta = (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+        Answer* answer = new Answer();
+        answer->formulaId = previous + delta;
+        answset->answers.push_back(answer);
+        previous = answer->formulaId;
+    }
+
+    if (flags & BINARY_ANSWSET_QVARS) {
+        if (getVarint(&pos, end, &numQvars) != 0) return -1;
+        for (uint64_t i = 0; i < numQvars; i++) {
+            string name, xpath;
+            if (getVarintString(&pos, end, &name) != 0 ||
+                    getVarintString(&pos, end, &xpath) != 0) {
+                return -1;
+            }
+            answset->qvars.push_back(Qvar(name, xpath));
+        }
+    }
+
+    return (pos == end) ? 0 : -1;
+}
+
+string
+writeBinaryAnswsetsToString(const vector<const mws::MwsAnswset*>& answsets)
+{
+    string      out;
+
+    out.append(BINARY_ANSWSETS_MAGIC, BINARY_ANSWSET_MAGIC_SIZE);
+    out.push_back((char) BINARY_ANSWSET_VERSION);
+    out.append(3, '\0');
+    putUint32(&out, answsets.size());
+    for (auto answset : answsets) {
+        putVarintString(&out, writeBinaryAnswsetToString(answset));
+    }
+
+    return out;
+}
+
+int
+readBinaryAnswsets(const char* data, size_t size,
+                   vector<mws::MwsAnswset*>* answsets)
+{
+    const unsigned char* pos = (const unsigned char*) data;
+    const unsigned char* end = pos + size;
+    uint32_t             numAnswsets;
+    uint64_t             length;
+
+    if (size < BINARY_ANSWSETS_HEADER_SIZE ||
+            memcmp(data, BINARY_ANSWSETS_MAGIC,
+                   BINARY_ANSWSET_MAGIC_SIZE) != 0 ||
+            pos[4] != BINARY_ANSWSET_VERSION) {
+        return -1;
+    }
+    numAnswsets = getUint32(pos + 8);
+    pos += BINARY_ANSWSETS_HEADER_SIZE;
+
+    for (uint32_t i = 0; i < numAnswsets; i++) {
+        if (getVarint(&pos, end, &length) != 0 ||
+                length > (uint64_t) (end - pos)) {
+            return -1;
+        }
+        MwsAnswset* answset = new MwsAnswset();
+        answsets->push_back(answset);
+        if (readBinaryAnswset((const char*) pos, length, answset) != 0) {
+            return -1;
+        }
+        pos += length;
+    }
+
+    return (pos == end) ? 0 : -1;
+}
+
+}
@@ -0,0 +1,120 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef _WRITEBINARYANSWSETTOFD_HPP
+#define _WRITEBINARYANSWSETTOFD_HPP
+
+/**
+  * @brief   Compact binary answer sets, for clients which only need the
+  * formula ids
+  *
+  * @file    writeBinaryAnswsetToFd.hpp
+  * @date    19 Oct 2026
+  *
+  * License: GPL v3
+  *
+  * An answer set is written as (integers in little-endian order):
+  *
+  *     "MWSA"           magic
+  *     uint8            format version (BINARY_ANSWSET_VERSION)
+  *     uint8            flags (BINARY_ANSWSET_*)
+  *     uint16           reserved, 0
+  *     uint32           size, the number of formula ids
+  *     uint32           total
+  *     size varints     formula ids, each as the zigzag-encoded difference
+  *                      to the previous one (the first to 0)
+  *     qvar records     if BINARY_ANSWSET_QVARS is set: a varint count,
+  *                      then the name and the xpath of each query variable,
+  *                      each as a varint length followed by the bytes
+  *
+  * The formula ids keep the order of the answers, which is the order the
+  * pages of a query are cut from.
+  *
+  * The answer sets of a batch of expressions are written as "MWSB", the
+  * format version, 3 reserved bytes, a uint32 count, then each answer set
+  * as a varint length followed by its bytes.
+  */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Local includes
+
+#include "mws/types/MwsAnswset.hpp"    // MWS Answer Set datatype header
+
+namespace mws
+{
+
+/// Version of the binary answer sets written
+const uint8_t BINARY_ANSWSET_VERSION = 1;
+/// Flag set if the answer set is followed by the query variables
+const uint8_t BINARY_ANSWSET_QVARS   = 0x01;
+
+/**
+  * @brief Function to write a MwsAnswset to an output file descriptor as a
+  * binary answer set.
+  * @param fd is the file descriptor to which to write.
+  * @param answset is the MWS Answer Set to be written.
+  * @return the number of bytes written to fd or -1 in case of failure.
+  */
+int writeBinaryAnswsetToFd(mws::MwsAnswset* answset, int fd);
+
+/**
+  * @brief Function to write a MwsAnswset as a binary answer set in memory.
+  * @param answset is the MWS Answer Set to be written.
+  * @return the binary answer set, as written by writeBinaryAnswsetToFd.
+  */
+std::string writeBinaryAnswsetToString(const mws::MwsAnswset* answset);
+
+/**
+  * @brief Function to read a binary answer set written by
+  * writeBinaryAnswsetToFd.
+  * @param data is the binary answer set.
+  * @param size is the size of data.
+  * @param answset is the (empty) MWS Answer Set to fill.
+  * @return 0 on success, -1 if data is not such an answer set.
+  */
+int readBinaryAnswset(const char* data, size_t size,
+                      mws::MwsAnswset* answset);
+
+/**
+  * @brief Function to write the answer sets of a batch of expressions as
+  * binary data in memory.
+  * @param answsets are the MWS Answer Sets, in the order of the expressions.
+  * @return the binary answer sets.
+  */
+std::string writeBinaryAnswsetsToString(
+        const std::vector<const mws::MwsAnswset*>& answsets);
+
+/**
+  * @brief Function to read the binary answer sets written by
+  * writeBinaryAnswsetsToString.
+  * @param answsets is filled with the answer sets, to be deleted by the
+  * caller (even on failure).
+  * @return 0 on success, -1 if data is not such a batch.
+  */
+int readBinaryAnswsets(const char* data, size_t size,
+                       std::vector<mws::MwsAnswset*>* answsets);
+
+}
+
+#endif // _WRITEBINARYANSWSETTOFD_HPP
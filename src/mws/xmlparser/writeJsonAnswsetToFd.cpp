@@ -42,15 +42,10 @@ using namespace mws;
 namespace mws
 {
 
-int
-writeJsonAnswsetToFd(mws::MwsAnswset* answset, int fd)
+string
+writeJsonAnswsetToString(const mws::MwsAnswset* answset)
 {
     stringstream               ss;
-    vector<mws::types::Answer*>::iterator it;
-    const char*                data;
-    size_t                     data_size;
-    size_t                     bytes_written;
-    string                     out;
     bool                       begin;
 
     ss << "{\"size\":" << answset->answers.size()
@@ -77,7 +72,33 @@ writeJsonAnswsetToFd(mws::MwsAnswset* answset, int fd)
     }
     ss << "]}";
 
-    out = ss.str();
+    return ss.str();
+}
+
+string
+writeJsonAnswsetsToString(const vector<const mws::MwsAnswset*>& answsets)
+{
+    string                     out;
+
+    out = "{\"size\":" + to_string(answsets.size()) + ",\"answsets\":[";
+    for (size_t i = 0; i < answsets.size(); i++) {
+        if (i > 0) out += ",";
+        out += writeJsonAnswsetToString(answsets[i]);
+    }
+    out += "]}";
+
+    return out;
+}
+
+int
+writeJsonAnswsetToFd(mws::MwsAnswset* answset, int fd)
+{
+    const char*                data;
+    size_t                     data_size;
+    size_t                     bytes_written;
+    string                     out;
+
+    out = writeJsonAnswsetToString(answset);
     data = out.c_str();
     data_size = out.size();
 
@@ -32,6 +32,9 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
   *
   */
 
+#include <string>
+#include <vector>
+
 // Local includes
 
 #include "mws/types/MwsAnswset.hpp"    // MWS Answer Set datatype header
@@ -48,6 +51,22 @@ namespace mws
   */
 int writeJsonAnswsetToFd(mws::MwsAnswset* answset, int fd);
 
+/**
+  * @brief Function to write a MwsAnswset as JSON data in memory.
+  * @param answset is the MWS Answer Set to be written.
+  * @return the JSON data, as written by writeJsonAnswsetToFd.
+  */
+std::string writeJsonAnswsetToString(const mws::MwsAnswset* answset);
+
+/**
+  * @brief Function to write the answer sets of a batch of expressions as
+  * JSON data in memory: {"size":N,"answsets":[...]}.
+  * @param answsets are the MWS Answer Sets, in the order of the expressions.
+  * @return the JSON data.
+  */
+std::string writeJsonAnswsetsToString(
+        const std::vector<const mws::MwsAnswset*>& answsets);
+
 }
 
 #endif // _WRITEJSONANSWSETTOFD_HPP
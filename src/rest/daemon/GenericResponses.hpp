@@ -103,9 +103,11 @@ sendOptionsResponse(struct MHD_Connection* connection)
     MHD_add_response_header(response,
                             "Access-Control-Allow-Origin", "*");
     MHD_add_response_header(response,
-                            "Access-Control-Allow-Methods", "POST, OPTIONS");
+                            "Access-Control-Allow-Methods",
+                            "GET, POST, OPTIONS");
     MHD_add_response_header(response,
-                            "Access-Control-Allow-Headers", "CONTENT-TYPE");
+                            "Access-Control-Allow-Headers",
+                            "CONTENT-TYPE, IF-NONE-MATCH");
     MHD_add_response_header(response,
                             "Access-Control-Max-Age", "1728000");
     ret = MHD_queue_response(connection,
@@ -116,4 +118,35 @@ sendOptionsResponse(struct MHD_Connection* connection)
     return ret;
 }
 
+inline int
+sendNotModifiedResponse(struct MHD_Connection* connection,
+                        const char*            etag)
+{
+    struct MHD_Response* response;
+    int                  ret;
+
+#ifdef _MICROHTTPD_DEPRECATED
+    response = MHD_create_response_from_data(strlen(EMPTY_RESPONSE),
+                                             (void*) EMPTY_RESPONSE,
+                                             false,
+                                             false);
+#else // _MICROHTTPD_DEPRECATED
+    response = MHD_create_response_from_buffer(strlen(EMPTY_RESPONSE),
+                                               (void*) EMPTY_RESPONSE,
+                                               MHD_RESPMEM_PERSISTENT);
+#endif // _MICROHTTPD_DEPRECATED
+    MHD_add_response_header(response,
+                            "Access-Control-Allow-Origin", "*");
+    MHD_add_response_header(response,
+                            "Cache-Control", "public, no-cache");
+    MHD_add_response_header(response,
+                            "ETag", etag);
+    ret = MHD_queue_response(connection,
+                             MHD_HTTP_NOT_MODIFIED,
+                             response);
+    MHD_destroy_response(response);
+
+    return ret;
+}
+
 #endif // _GENERICRESPONSES_HPP
@@ -0,0 +1,83 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+  * @brief File containing the implementation of the ResponseCache class.
+  * @file ResponseCache.cpp
+  * @date 19 Oct 2026
+  *
+  * License: GPL v3
+  *
+  */
+
+#include "rest/daemon/ResponseCache.hpp"    // ResponseCache class header
+
+using namespace std;
+
+
+ResponseCache::ResponseCache(size_t maxEntries) :
+    _maxEntries(maxEntries)
+{
+    pthread_mutex_init(&_lock, NULL);
+}
+
+
+ResponseCache::~ResponseCache()
+{
+    pthread_mutex_destroy(&_lock);
+}
+
+
+bool
+ResponseCache::get(const string& key, Frame* answer)
+{
+    map<string, Entries::iterator>::iterator it;
+    bool found = false;
+
+    pthread_mutex_lock(&_lock);
+    it = _index.find(key);
+    if (it != _index.end())
+    {
+        _entries.splice(_entries.begin(), _entries, it->second);
+        *answer = it->second->second;
+        found = true;
+    }
+    pthread_mutex_unlock(&_lock);
+
+    return found;
+}
+
+
+void
+ResponseCache::put(const string& key, const Frame& answer)
+{
+    pthread_mutex_lock(&_lock);
+    if (_maxEntries > 0 && _index.find(key) == _index.end())
+    {
+        if (_entries.size() >= _maxEntries)
+        {
+            _index.erase(_entries.back().first);
+            _entries.pop_back();
+        }
+        _entries.push_front(make_pair(key, answer));
+        _index[key] = _entries.begin();
+    }
+    pthread_mutex_unlock(&_lock);
+}
@@ -0,0 +1,84 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+#ifndef _RESPONSECACHE_HPP
+#define _RESPONSECACHE_HPP
+
+/**
+  * @brief File containing the header of the ResponseCache class.
+  * @file ResponseCache.hpp
+  * @date 19 Oct 2026
+  *
+  * License: GPL v3
+  *
+  */
+
+// System includes
+
+#include <pthread.h>
+#include <stddef.h>
+#include <list>
+#include <map>
+#include <string>
+
+// Local includes
+
+#include "common/socket/Frame.hpp"      // Answers of MWS
+
+/**
+  * @brief Answers to recent GET queries, by canonical query and index
+  * generation.
+  *
+  * The key of an answer changes with the index generation, so the entries
+  * of an older generation are never hit again and are the first ones
+  * evicted. All the methods are thread safe.
+  */
+class ResponseCache
+{
+    typedef std::list< std::pair<std::string, Frame> > Entries;
+
+    pthread_mutex_t                             _lock;
+    /// most recently used first
+    Entries                                     _entries;
+    std::map<std::string, Entries::iterator>    _index;
+    size_t                                      _maxEntries;
+
+public:
+    ResponseCache(size_t maxEntries);
+    ~ResponseCache();
+
+    /**
+      * @brief Look up the answer with a key
+      * @return true if found, in which case it is copied to answer
+      */
+    bool get(const std::string& key, Frame* answer);
+
+    /**
+      * @brief Store an answer, evicting the least recently used one if the
+      * cache is full
+      */
+    void put(const std::string& key, const Frame& answer);
+
+private:
+    ResponseCache(const ResponseCache&);
+    ResponseCache& operator=(const ResponseCache&);
+};
+
+#endif // _RESPONSECACHE_HPP
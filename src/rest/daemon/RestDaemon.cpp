@@ -30,6 +30,7 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 
 // System includes
 
+#include <ctype.h>                     // C character classification
 #include <stdint.h>                    // C standard integer types
 #include <sys/types.h>                 // C depricated types
 #include <sys/socket.h>                // C sockets API
@@ -37,6 +38,12 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdlib.h>                    // C general purpose library
 #include <string.h>                    // C string library
 #include <stdio.h>
+#include <sys/time.h>                  // C time types
+#include <sys/resource.h>              // C resource limits
+#include <sys/select.h>                // C select, FD_SETSIZE
+
+#include <iomanip>                     // C++ stream manipulators
+#include <sstream>                     // C++ string streams
 
 // Local includes
 
@@ -44,11 +51,17 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 #include "common/utils/getSockAddrLog.hpp"  // Socket Address logging function
 #include "common/utils/macro_func.h"        // Utility Macro Functions
 #include "common/utils/DebugMacros.hpp"     // Utility Debug Macros
+#include "common/utils/TimeStamp.hpp"       // Utility monotonic clock
 #include "common/utils/ToString.hpp"        // Utility ToString function
 
 #include "rest/daemon/RestDaemon.hpp"       // RestDaemon class header
 #include "rest/daemon/GenericResponses.hpp" // Generic responses collection
-#include "rest/types/MwsConnection.hpp"     // Mws Connection datatype
+#include "rest/daemon/ResponseCache.hpp"    // Answers to recent GET queries
+#include "common/socket/ConnectionPool.hpp" // Pooled mwsd connections
+#include "common/types/DataFormat.hpp"     // Data formats enum
+#ifdef _EMBEDDED_MWS
+#include "mws/daemon/MwsDaemon.hpp"         // In-process MWS engine
+#endif // _EMBEDDED_MWS
 
 #include "config.h"
 
@@ -56,9 +69,346 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 
 using namespace std;
 
+/// Polling of the HTTP connections, with the best poller MHD was built with
+#if MHD_VERSION >= 0x00095900
+#define MHD_POLLING_FLAGS (MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_AUTO)
+#elif MHD_VERSION >= 0x00095300 && defined(__linux__)
+#define MHD_POLLING_FLAGS (MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_EPOLL)
+#elif MHD_VERSION >= 0x00093300 && defined(__linux__)
+#define MHD_POLLING_FLAGS (MHD_USE_SELECT_INTERNALLY | MHD_USE_EPOLL_LINUX_ONLY)
+#else
+#define MHD_POLLING_FLAGS MHD_USE_SELECT_INTERNALLY
+/// select() cannot poll the descriptors from FD_SETSIZE on
+#define MHD_MAX_CLIENTS_POLLED (FD_SETSIZE - 64)
+#endif
+
+/// Descriptors open besides the HTTP and MWS connections
+static const rlim_t RESERVED_FILES = 64;
+
+
+/// Connections to MWS, or NULL if the requests are answered in-process
+static ConnectionPool* mwsPool;
+/// Answers to recent GET queries
+static ResponseCache* responseCache;
+
+/// Time the index generation is trusted before asking MWS again
+static const double GENERATION_TTL_MS = 1000;
+static pthread_mutex_t generationLock = PTHREAD_MUTEX_INITIALIZER;
+/// Last index generation answered by MWS, empty if unknown
+static string generation;
+static double generationAtMs;
+
+/**
+  * @brief Request forwarded to MWS
+  */
+struct RestRequest
+{
+    string         body;
+    Frame          answer;
+    /// logged when the request is completed
+    string         info;
+    struct timeval start;
+
+    RestRequest() { gettimeofday(&start, NULL); }
+};
+
+/**
+  * @brief Type of the document posted, as told by its root element
+  */
+static uint8_t
+getFrameType(const string& document)
+{
+    size_t query = document.find("<mws:query");
+    size_t harvest = document.find("<mws:harvest");
+    size_t deleted = document.find("<mws:delete");
+    size_t first = min(query, min(harvest, deleted));
+
+    if (first == string::npos || first == query) return FRAME_QUERY;
+
+    return (first == harvest) ? FRAME_HARVEST : FRAME_DELETE;
+}
+
+/**
+  * @brief Carry out a request, in this process if MWS is embedded
+  * @return 0 on success, -1 if MWS could not be reached
+  */
+static int
+forwardRequest(Frame* query, Frame* answer)
+{
+#ifdef _EMBEDDED_MWS
+    if (mwsPool == NULL)
+    {
+        mws::daemon::answerRequest(*query, answer);
+        return 0;
+    }
+#endif // _EMBEDDED_MWS
+
+    return mwsPool->request(query, answer);
+}
+
+/**
+  * @brief Description of a response, in the log
+  */
+static string
+getResponseInfo(const RestRequest& request)
+{
+    stringstream   ss;
+    struct timeval now;
+    struct timeval diff;
+
+    gettimeofday(&now, NULL);
+    timersub(&now, &request.start, &diff);
+    ss << "Response (" << (DataFormat) request.answer.format
+       << ") of " << request.answer.body.size() << " bytes returned in "
+       << diff.tv_sec << ".";
+    ss << std::setfill('0') << std::setw(3)
+       << std::right << diff.tv_usec / 1000 << "s";
+
+    return ss.str();
+}
+
+/**
+  * @brief Generation of the index queried, as last answered by MWS
+  * @return 0 on success, -1 if MWS does not tell its generation
+  */
+static int
+getIndexGeneration(string* indexGeneration)
+{
+    Frame request;
+    Frame answer;
+
+    pthread_mutex_lock(&generationLock);
+    if (!generation.empty() &&
+            MonotonicMs() - generationAtMs < GENERATION_TTL_MS)
+    {
+        *indexGeneration = generation;
+        pthread_mutex_unlock(&generationLock);
+        return 0;
+    }
+    pthread_mutex_unlock(&generationLock);
+
+    request.type = FRAME_GENERATION;
+    if (forwardRequest(&request, &answer) != 0 ||
+            answer.status != FRAME_STATUS_OK || answer.body.empty())
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&generationLock);
+    generation = answer.body;
+    generationAtMs = MonotonicMs();
+    pthread_mutex_unlock(&generationLock);
+    *indexGeneration = answer.body;
+
+    return 0;
+}
+
+/**
+  * @brief Query without the whitespace around its elements, such that the
+  * same query laid out differently has the same ETag
+  */
+static string
+canonicalQuery(const char* query)
+{
+    string canonical;
+    size_t blanks = 0;
+
+    for (const char* c = query; *c != '\0'; c++)
+    {
+        if (isspace((unsigned char) *c))
+        {
+            blanks++;
+            continue;
+        }
+        // blanks only matter within text and tags
+        if (blanks > 0 && !canonical.empty() &&
+                canonical[canonical.size() - 1] != '>' && *c != '<')
+        {
+            canonical += ' ';
+        }
+        blanks = 0;
+        canonical += *c;
+    }
+
+    return canonical;
+}
+
+/**
+  * @brief ETag of the answer to a query on a generation of the index
+  */
+static string
+getETag(const string& query, const string& indexGeneration)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    char     etag[64];
+
+    for (size_t i = 0; i < query.size(); i++)
+    {
+        hash = (hash ^ (unsigned char) query[i]) * 1099511628211ULL;
+    }
+    snprintf(etag, sizeof(etag), "\"%016llx-%s\"",
+             (unsigned long long) hash, indexGeneration.c_str());
+
+    return etag;
+}
+
+/**
+  * @brief Key of the answer to a query on a generation of the index in the
+  * response cache, which unlike the hashed ETag cannot collide
+  */
+static string
+getCacheKey(const string& query, const string& indexGeneration)
+{
+    return indexGeneration + '\n' + query;
+}
+
+/**
+  * @brief Send the answer of MWS, which lives until the request is
+  * completed
+  * @param etag ETag of the answer, or empty if it cannot be cached
+  */
+static int
+sendAnswer(struct MHD_Connection* connection,
+           RestRequest*           request,
+           const string&          etag)
+{
+    struct MHD_Response* response;
+    int ret;
+
+#ifdef _MICROHTTPD_DEPRECATED
+    response = MHD_create_response_from_data(
+            request->answer.body.size(),
+            (void*) request->answer.body.data(),
+            false,
+            false);
+#else // _MICROHTTPD_DEPRECATED
+    response = MHD_create_response_from_buffer(
+            request->answer.body.size(),
+            (void*) request->answer.body.data(),
+            MHD_RESPMEM_PERSISTENT);
+#endif // _MICROHTTPD_DEPRECATED
+    switch (request->answer.format)
+    {
+    case DATAFORMAT_XML:
+        MHD_add_response_header(response, 
+                "Content-Type", "text/xml");
+        break;
+    case DATAFORMAT_JSON:
+        MHD_add_response_header(response, 
+                "Content-Type", "application/json");
+        break;
+    case DATAFORMAT_BINARY:
+        MHD_add_response_header(response, 
+                "Content-Type", "application/x-mws-answset");
+        break;
+    default:
+        MHD_add_response_header(response, 
+                "Content-Type", "text/xml");
+        break;
+    }
+    MHD_add_response_header(response,
+                    "Access-Control-Allow-Origin", "*");
+    if (etag.empty())
+    {
+        MHD_add_response_header(response, 
+                        "Cache-Control", "no-cache, must-revalidate");
+    }
+    else
+    {
+        // stored by browsers and proxies, and revalidated with the ETag
+        MHD_add_response_header(response, "Cache-Control", "public, no-cache");
+        MHD_add_response_header(response, "ETag", etag.c_str());
+    }
+
+    ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+    MHD_destroy_response(response);
+
+    return ret;
+}
+
+/**
+  * @brief Forward a request to MWS and send its answer
+  * @param etag ETag of the answer, or empty
+  * @param cacheKey key the answer is cached with, or empty
+  */
+static int
+forwardAndAnswer(struct MHD_Connection* connection,
+                 RestRequest*           request,
+                 Frame*                 query,
+                 const string&          etag,
+                 const string&          cacheKey)
+{
+    // Sending the request on a pooled connection to MWS
+    if (forwardRequest(query, &request->answer) != 0)
+    {
+        request->info = "Couldn't connect to MWS";
+        return sendXmlGenericResponse(connection,
+                                      XML_MWS_UNREACHABLE,
+                                      MHD_HTTP_SERVICE_UNAVAILABLE);
+    }
+    // Checking if query parsing was ok
+    else if (request->answer.status != FRAME_STATUS_OK)
+    {
+        request->info = "Couldn't parse Mws Query request";
+        return sendXmlGenericResponse(connection,
+                                      XML_MWS_BADQUERY,
+                                      MHD_HTTP_BAD_REQUEST);
+    }
+
+    request->info = getResponseInfo(*request);
+    if (!cacheKey.empty()) responseCache->put(cacheKey, request->answer);
+
+    return sendAnswer(connection, request, etag);
+}
+
+/**
+  * @brief Answer GET /?query=..., without asking MWS again while the index
+  * does not change
+  */
+static int
+answerGet(struct MHD_Connection* connection, RestRequest* request)
+{
+    const char* query;
+    const char* ifNoneMatch;
+    string      indexGeneration;
+    string      etag;
+    string      cacheKey;
+    Frame       frame;
+
+    query = MHD_lookup_connection_value(connection,
+                                        MHD_GET_ARGUMENT_KIND, "query");
+    if (query == NULL)
+    {
+        request->info = "Missing query argument";
+        return sendXmlGenericResponse(connection,
+                                      XML_MWS_BADQUERY,
+                                      MHD_HTTP_BAD_REQUEST);
+    }
+    frame.type = FRAME_QUERY;
+    frame.body = canonicalQuery(query);
+
+    // answers are only cached while MWS tells the generation of its index
+    if (getIndexGeneration(&indexGeneration) == 0)
+    {
+        etag = getETag(frame.body, indexGeneration);
+        ifNoneMatch = MHD_lookup_connection_value(connection,
+                MHD_HEADER_KIND, MHD_HTTP_HEADER_IF_NONE_MATCH);
+        if (ifNoneMatch != NULL && strstr(ifNoneMatch, etag.c_str()))
+        {
+            request->info = "Not modified";
+            return sendNotModifiedResponse(connection, etag.c_str());
+        }
+        cacheKey = getCacheKey(frame.body, indexGeneration);
+        if (responseCache->get(cacheKey, &request->answer))
+        {
+            request->info = "Cached " + getResponseInfo(*request);
+            return sendAnswer(connection, request, etag);
+        }
+    }
 
-static int mwsPort;
-static string mwsHost;
+    return forwardAndAnswer(connection, request, &frame, etag, cacheKey);
+}
 
 static void
 my_MHD_RequestCompletedCallback(void*                      cls,
@@ -70,10 +420,10 @@ my_MHD_RequestCompletedCallback(void*                      cls,
     UNUSED( status );
 
     const union MHD_ConnectionInfo* connInfo;
-    MwsConnection*                  mwsConn;
+    RestRequest*                    request;
     const struct sockaddr*          clientAddr;
 
-    mwsConn = (MwsConnection*) *ptr;
+    request = (RestRequest*) *ptr;
 
     connInfo = MHD_get_connection_info(connection,
                                        MHD_CONNECTION_INFO_CLIENT_ADDRESS);
@@ -89,13 +439,13 @@ my_MHD_RequestCompletedCallback(void*                      cls,
     clientAddr = connInfo->client_addr;
 #endif // _MICROHTTPD_DEPRECATED
 
-    if (mwsConn)
+    if (request)
     {
         printf("%s\n :: %s\n",
                getSockAddrLog(clientAddr, CLIENT_ADDR_SIZE).c_str(),
-               mwsConn->getInfo().c_str());
+               request->info.c_str());
 
-        delete mwsConn;
+        delete request;
     }
     else
     {
@@ -107,48 +457,6 @@ my_MHD_RequestCompletedCallback(void*                      cls,
 }
 
 
-#ifdef _MICROHTTPD_DEPRECATED
-static int
-my_MHD_ContentReaderCallback(void*    cls,
-                             uint64_t pos,
-                             char*    buf,
-                             int      max)
-#else // _MICROHTTPD_DEPRECATED
-static ssize_t
-my_MHD_ContentReaderCallback(void*    cls,
-                             uint64_t pos,
-                             char*    buf,
-                             size_t   max)
-#endif // _MICROHTTPD_DEPRECATED
-{
-    UNUSED( pos ); // Not necessary if responses aren't reused
-
-    MwsConnection* data;
-    ssize_t        result;
-
-    data = (MwsConnection*) cls;
-    result = data->read(buf, max);
-
-    if (result <= 0)
-    {
-#ifdef _MICROHTTPD_DEPRECATED
-        /*
-         * Older versions of MHD did not make a difference between end of
-         * transmission or error
-         */
-        result = -1;
-#else // _MICROHTTPD_DEPRECATED
-        if (result == 0)
-            result = MHD_CONTENT_READER_END_OF_STREAM;
-        else
-            result = MHD_CONTENT_READER_END_WITH_ERROR;
-#endif // _MICROHTTPD_DEPRECATED
-    }
-
-    return result;
-}
-
-
 static int
 my_MHD_AcceptPolicyCallback(void* cls,
                             const sockaddr* addr,
@@ -184,13 +492,11 @@ my_MHD_AccessHandlerCallback(void*                  cls,
     LOG_TRACE_IN;
 #endif
     UNUSED( cls );
-    UNUSED( url );
     UNUSED( version );
 
-    struct MHD_Response* response;
     int ret;
-    size_t nbytes;
-    MwsConnection* mwsConn;
+    RestRequest* request;
+    Frame query;
 
     // On OPTIONS method request different behavior
     if (0 == strcmp(method, MHD_HTTP_METHOD_OPTIONS))
@@ -198,100 +504,45 @@ my_MHD_AccessHandlerCallback(void*                  cls,
         ret = sendOptionsResponse(connection);
     }
     // Checking if the method is supported
-    else if (0 != strcmp(method, MHD_HTTP_METHOD_POST))
+    else if (0 != strcmp(method, MHD_HTTP_METHOD_POST) &&
+             0 != strcmp(method, MHD_HTTP_METHOD_GET))
     {
         ret = MHD_NO;
     }
     // Checking if initialization needed
     else if (*ptr == NULL)
     {
-        // Opening a socket and connecting to MWS
-        *ptr = new MwsConnection(mwsHost, mwsPort);
-        mwsConn = (MwsConnection*)*ptr;
+        *ptr = new RestRequest();
 
-        mwsConn->connect();
-        
         ret = MHD_YES;
     }
     // Data to be processed
     else if (*upload_data_size)
     {
-        mwsConn = (MwsConnection*)*ptr;
-        
-        while (*upload_data_size)
-        {
-            nbytes = mwsConn->write(upload_data,
-                                    *upload_data_size);
-            if (nbytes <= 0)
-            {
-                ret = MHD_NO;
-                break;
-            }
-                                    
-            upload_data       += nbytes;
-            *upload_data_size -= nbytes;
-        }
+        request = (RestRequest*)*ptr;
+        request->body.append(upload_data, *upload_data_size);
+        *upload_data_size = 0;
 
         ret = MHD_YES;
     }
+    // Queries in the URL
+    else if (0 == strcmp(method, MHD_HTTP_METHOD_GET))
+    {
+        ret = answerGet(connection, (RestRequest*)*ptr);
+    }
     // If we are here, all post data has been processed
     else
     {
-        mwsConn = (MwsConnection*)*ptr;
-
-        // Checking if MWS was reached
-        if (!mwsConn->isConnected())
+        request = (RestRequest*)*ptr;
+        query.type = getFrameType(request->body);
+        // each expression of a query posted to /batch is answered
+        if (query.type == FRAME_QUERY && 0 == strcmp(url, "/batch"))
         {
-            ret = sendXmlGenericResponse(connection,
-                                         XML_MWS_UNREACHABLE,
-                                         MHD_HTTP_SERVICE_UNAVAILABLE);
-        }
-        // Signaling the end of data and receiving a control sequence
-        // for the parsed data
-        else if (mwsConn->signalEnd() == -1)
-        {
-            ret = sendXmlGenericResponse(connection,
-                                         XML_MWS_INTERNALERROR,
-                                         MHD_HTTP_INTERNAL_SERVER_ERROR);
-        }
-        // Checking if query parsing was ok
-        else if (!mwsConn->isParsed())
-        {
-            ret = sendXmlGenericResponse(connection,
-                                         XML_MWS_BADQUERY,
-                                         MHD_HTTP_BAD_REQUEST);
-        }
-        // Retrieving the answer and sending it
-        else
-        {
-            response = MHD_create_response_from_callback(-1,// Unknown size
-                                                1024,   // Prefered block size
-                                                my_MHD_ContentReaderCallback,
-                                                mwsConn,
-                                                NULL);
-            switch (mwsConn->getOutputFormat())
-            {
-            case DATAFORMAT_XML:
-                MHD_add_response_header(response, 
-                        "Content-Type", "text/xml");
-                break;
-            case DATAFORMAT_JSON:
-                MHD_add_response_header(response, 
-                        "Content-Type", "application/json");
-                break;
-            default:
-                MHD_add_response_header(response, 
-                        "Content-Type", "text/xml");
-                break;
-            }
-            MHD_add_response_header(response,
-                            "Access-Control-Allow-Origin", "*");
-            MHD_add_response_header(response, 
-                            "Cache-Control", "no-cache, must-revalidate");
-
-            ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
-            MHD_destroy_response(response);
+            query.type = FRAME_BATCH_QUERY;
         }
+        query.body.swap(request->body);
+
+        ret = forwardAndAnswer(connection, request, &query, "", "");
     }
 
 #ifdef TRACE_FUNC_CALLS
@@ -301,6 +552,32 @@ my_MHD_AccessHandlerCallback(void*                  cls,
 }
 
 
+/**
+  * @brief Raise the limit of open files to fit the HTTP and MWS connections
+  * @return number of HTTP connections that fit in the limit
+  */
+static unsigned
+reserveFiles(unsigned maxClients, unsigned mwsConnections)
+{
+    struct rlimit limit;
+    rlim_t needed = (rlim_t) maxClients + mwsConnections + RESERVED_FILES;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) return maxClients;
+    if (limit.rlim_cur < needed)
+    {
+        limit.rlim_cur = min(needed, limit.rlim_max);
+        if (setrlimit(RLIMIT_NOFILE, &limit) != 0) getrlimit(RLIMIT_NOFILE, &limit);
+    }
+    if (limit.rlim_cur >= needed) return maxClients;
+
+    fprintf(stderr, "Open files limited to %llu, fewer than %u clients\n",
+            (unsigned long long) limit.rlim_cur, maxClients);
+    if (limit.rlim_cur <= mwsConnections + RESERVED_FILES) return 1;
+
+    return (unsigned) (limit.rlim_cur - mwsConnections - RESERVED_FILES);
+}
+
+
 RestDaemon::RestDaemon()
 {
     _daemonHandler = NULL;
@@ -309,10 +586,7 @@ RestDaemon::RestDaemon()
 
 RestDaemon::~RestDaemon()
 {
-    if (_daemonHandler != NULL)
-    {
-        MHD_stop_daemon(_daemonHandler);
-    }
+    stop();
 }
 
 
@@ -320,24 +594,57 @@ int
 RestDaemon::startAsync(const Config& config)
 {
     int status;
+    unsigned maxClients;
+
+    if (!config.embeddedMws)
+    {
+        ConnectionPool::Config poolConfig;
+        poolConfig.host = config.mwsHost;
+        poolConfig.port = config.mwsPort;
+        poolConfig.socketPath = config.mwsSocketPath;
+        poolConfig.maxConnections = config.mwsConnections;
+        poolConfig.timeoutMs = config.mwsTimeoutMs;
+        mwsPool = new ConnectionPool(poolConfig);
+    }
+#ifndef _EMBEDDED_MWS
+    else
+    {
+        fprintf(stderr, "restd was built without WITH_EMBEDDED_MWS\n");
+        return -1;
+    }
+#endif // !_EMBEDDED_MWS
+    responseCache = new ResponseCache(config.cacheSize);
 
-    mwsPort = config.mwsPort;
-    mwsHost = config.mwsHost;
+    maxClients = reserveFiles(config.maxClients, config.mwsConnections);
+#ifdef MHD_MAX_CLIENTS_POLLED
+    maxClients = min(maxClients, (unsigned) MHD_MAX_CLIENTS_POLLED);
+#endif
 
-    _daemonHandler = MHD_start_daemon(MHD_USE_THREAD_PER_CONNECTION,
+    // A pool of threads polls the connections, which are kept alive
+    // between requests. Requests to MWS block their thread, such that
+    // config.threads bounds the requests in flight.
+    _daemonHandler = MHD_start_daemon(MHD_POLLING_FLAGS,
                                       config.restPort,
                                       my_MHD_AcceptPolicyCallback,
                                           NULL,
                                       my_MHD_AccessHandlerCallback,
                                           NULL,
+                                      MHD_OPTION_THREAD_POOL_SIZE,
+                                          (unsigned int) config.threads,
                                       MHD_OPTION_CONNECTION_LIMIT,
-                                          20,
+                                          (unsigned int) maxClients,
+                                      MHD_OPTION_CONNECTION_TIMEOUT,
+                                          (unsigned int) config.clientTimeoutSec,
                                       MHD_OPTION_NOTIFY_COMPLETED,
                                           my_MHD_RequestCompletedCallback,
                                           NULL,
                                       MHD_OPTION_END);
     if (_daemonHandler == NULL)
     {
+        delete mwsPool;
+        mwsPool = NULL;
+        delete responseCache;
+        responseCache = NULL;
         status = -1;
     }
     else
@@ -356,5 +663,9 @@ RestDaemon::stop()
     {
         MHD_stop_daemon(_daemonHandler);
         _daemonHandler = NULL;
+        delete mwsPool;
+        mwsPool = NULL;
+        delete responseCache;
+        responseCache = NULL;
     }
 }
@@ -44,8 +44,25 @@ class RestDaemon
 public:
     struct Config {
         int         restPort;
+        /// threads polling the HTTP connections and answering the requests
+        unsigned    threads;
+        /// HTTP connections open at once
+        unsigned    maxClients;
+        /// seconds before an idle HTTP connection is closed
+        unsigned    clientTimeoutSec;
+        /// answers to GET queries kept in memory
+        unsigned    cacheSize;
         int         mwsPort;
         std::string mwsHost;
+        /// Unix domain socket of MWS, used instead of host and port if set
+        std::string mwsSocketPath;
+        /// connections kept open to MWS, and requests in flight at most
+        unsigned    mwsConnections;
+        /// time MWS has to answer a request
+        unsigned    mwsTimeoutMs;
+        /// answer the requests in this process (see startEmbeddedMws()),
+        /// for restd built WITH_EMBEDDED_MWS
+        bool        embeddedMws;
     };
 private:
     struct MHD_Daemon* _daemonHandler;
@@ -31,9 +31,13 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <unistd.h>
 
+#include "common/socket/ConnectionPool.hpp"
 #include "common/utils/FlagParser.hpp"
 #include "common/utils/save_pid_file.h"
 #include "rest/daemon/RestDaemon.hpp"
+#ifdef _EMBEDDED_MWS
+#include "mws/daemon/MwsDaemon.hpp"
+#endif // _EMBEDDED_MWS
 
 #include "config.h"
 
@@ -46,6 +50,54 @@ static void catch_sigint(int sig)
     if (sig == SIGINT || sig == SIGTERM) sigQuit = 1;
 }
 
+/**
+ * @brief Positive integer argument of a flag, or its default
+ * @return 0 on success, -1 if the argument is not a positive integer
+ */
+static int
+getPositiveArg(char flag, unsigned defaultValue, unsigned* value)
+{
+    int arg;
+
+    *value = defaultValue;
+    if (FlagParser::hasArg(flag)) {
+        arg = atoi(FlagParser::getArg(flag).c_str());
+        if (arg <= 0) {
+            fprintf(stderr, "\"%s\" is not a valid -%c argument\n",
+                    FlagParser::getArg(flag).c_str(), flag);
+            return -1;
+        }
+        *value = arg;
+    }
+
+    return 0;
+}
+
+#ifdef _EMBEDDED_MWS
+/**
+ * @brief Index answering the queries in-process, loaded from the harvests
+ * and memsector given as they are to mwsd
+ */
+static void
+getEmbeddedMwsConfig(mws::daemon::Config* mwsConfig)
+{
+    mwsConfig->harvestLoadPaths = FlagParser::getArgs('I');
+    if (FlagParser::hasArg('M')) {
+        mwsConfig->memsectorPath = FlagParser::getArg('M');
+    }
+    mwsConfig->recursive = FlagParser::hasArg('r');
+    mwsConfig->mwsPort = 0;
+    mwsConfig->dataPath = DEFAULT_MWS_DATA_PATH;
+    mwsConfig->exitAfterLoad = false;
+    mwsConfig->memsectorLoadFlags = 0;
+    mwsConfig->memsectorReadahead = false;
+    mwsConfig->memsectorLayout = mws::EXPORT_LAYOUT_DFS;
+    mwsConfig->memsectorEncoding = mws::EXPORT_ENCODING_FIXED;
+    mwsConfig->mergeInterval = 0;
+    mwsConfig->mergeRateLimit = 0;
+}
+#endif // _EMBEDDED_MWS
+
 
 int main(int argc, char* argv[])
 {
@@ -55,13 +107,29 @@ int main(int argc, char* argv[])
     int                   port;
     int                   ret;
     RestDaemon::Config    config;
+    ConnectionPool::Config poolDefaults;
+#ifdef _EMBEDDED_MWS
+    mws::daemon::Config   mwsConfig;
+#endif // _EMBEDDED_MWS
 
     // Parsing the flags
     FlagParser::addFlag('p', "rest-port",   FLAG_REQ, ARG_REQ );
     FlagParser::addFlag('m', "mws-port",    FLAG_OPT, ARG_REQ );
     FlagParser::addFlag('h', "mws-host",    FLAG_OPT, ARG_REQ );
+    FlagParser::addFlag('u', "mws-socket",  FLAG_OPT, ARG_REQ );
+    FlagParser::addFlag('c', "mws-connections", FLAG_OPT, ARG_REQ );
+    FlagParser::addFlag('t', "mws-timeout", FLAG_OPT, ARG_REQ );
     FlagParser::addFlag('i', "pid-file",    FLAG_OPT, ARG_REQ );
     FlagParser::addFlag('l', "log-file",    FLAG_OPT, ARG_REQ );
+    FlagParser::addFlag('T', "threads",     FLAG_OPT, ARG_REQ );
+    FlagParser::addFlag('C', "max-clients", FLAG_OPT, ARG_REQ );
+    FlagParser::addFlag('o', "client-timeout", FLAG_OPT, ARG_REQ );
+    FlagParser::addFlag('L', "cache-size",  FLAG_OPT, ARG_REQ );
+#ifdef _EMBEDDED_MWS
+    FlagParser::addFlag('I', "include-harvest-path", FLAG_OPT, ARG_REQ );
+    FlagParser::addFlag('M', "memsector-path", FLAG_OPT, ARG_REQ );
+    FlagParser::addFlag('r', "recursive",   FLAG_OPT, ARG_NONE);
+#endif // _EMBEDDED_MWS
 #ifndef __APPLE__
     FlagParser::addFlag('d', "daemonize",   FLAG_OPT, ARG_NONE);
 #endif // !__APPLE__
@@ -104,6 +172,30 @@ int main(int argc, char* argv[])
         config.mwsPort = DEFAULT_MWS_PORT;
     }
 
+    // mws unix socket, used instead of the host and port
+    if (FlagParser::hasArg('u')) {
+        config.mwsSocketPath = FlagParser::getArg('u');
+    }
+
+    // http threads, connections, their timeout (in seconds) and the cache
+    if (getPositiveArg('T', DEFAULT_REST_THREADS, &config.threads) != 0 ||
+            getPositiveArg('C', DEFAULT_REST_MAX_CLIENTS,
+                           &config.maxClients) != 0 ||
+            getPositiveArg('o', DEFAULT_REST_CLIENT_TIMEOUT,
+                           &config.clientTimeoutSec) != 0 ||
+            getPositiveArg('L', DEFAULT_REST_CACHE_SIZE,
+                           &config.cacheSize) != 0) {
+        goto failure;
+    }
+
+    // connections to mws, and their timeout (in milliseconds)
+    if (getPositiveArg('c', poolDefaults.maxConnections,
+                       &config.mwsConnections) != 0 ||
+            getPositiveArg('t', poolDefaults.timeoutMs,
+                           &config.mwsTimeoutMs) != 0) {
+        goto failure;
+    }
+
 #ifndef __APPLE__
     // daemon
     if (FlagParser::hasArg('d'))
@@ -144,6 +236,19 @@ int main(int argc, char* argv[])
         }
     }
 
+    // in-process index, instead of connecting to mws
+    config.embeddedMws = false;
+#ifdef _EMBEDDED_MWS
+    if (FlagParser::hasArg('I') || FlagParser::hasArg('M')) {
+        getEmbeddedMwsConfig(&mwsConfig);
+        if (mws::daemon::startEmbeddedMws(mwsConfig) != 0) {
+            fprintf(stderr, "Failure while loading the index\n");
+            goto failure;
+        }
+        config.embeddedMws = true;
+    }
+#endif // _EMBEDDED_MWS
+
     // Starting the daemon
     ret = restDaemon.startAsync(config);
     if (ret != 0) {
@@ -180,6 +285,9 @@ int main(int argc, char* argv[])
       fprintf(stderr,"sigaction - close");
 
     restDaemon.stop();
+#ifdef _EMBEDDED_MWS
+    if (config.embeddedMws) mws::daemon::stopEmbeddedMws();
+#endif // _EMBEDDED_MWS
     return EXIT_SUCCESS;
 
 failure:
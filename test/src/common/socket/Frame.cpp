@@ -0,0 +1,76 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+ * @file Frame.cpp
+ *
+ */
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "common/socket/Frame.hpp"
+
+#include "common/utils/macro_func.h"
+
+int main() {
+    int fds[2] = { -1, -1 };
+    Frame frame, read;
+
+    FAIL_ON(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0);
+
+    // pipelined frames are read back in order
+    frame.type = FRAME_QUERY;
+    frame.requestId = 0x01020304;
+    frame.body = "<mws:query/>";
+    FAIL_ON(writeFrame(fds[0], frame) != 0);
+    frame.type = FRAME_DELETE;
+    frame.status = FRAME_STATUS_ERROR;
+    frame.requestId = 7;
+    frame.body.clear();
+    FAIL_ON(writeFrame(fds[0], frame) != 0);
+
+    FAIL_ON(readFrame(fds[1], &read) != 1);
+    FAIL_ON(read.type != FRAME_QUERY);
+    FAIL_ON(read.requestId != 0x01020304);
+    FAIL_ON(read.body != "<mws:query/>");
+    FAIL_ON(readFrame(fds[1], &read) != 1);
+    FAIL_ON(read.type != FRAME_DELETE || read.status != FRAME_STATUS_ERROR);
+    FAIL_ON(read.requestId != 7 || !read.body.empty());
+
+    // documents of the unframed protocol
+    FAIL_ON(isFrameStart("<mws:query", 10));
+    FAIL_ON(isFrameStart("MW", 2));
+    FAIL_ON(write(fds[0], "<mws:query>.....", 16) != 16);
+    FAIL_ON(readFrame(fds[1], &read) != -1);
+
+    // closed between two frames
+    FAIL_ON(close(fds[0]) != 0);
+    FAIL_ON(readFrame(fds[1], &read) != 0);
+
+    // writing to a closed peer fails, without SIGPIPE
+    FAIL_ON(writeFrame(fds[1], frame) != -1);
+    (void) close(fds[1]);
+
+    return 0;
+
+fail:
+    return -1;
+}
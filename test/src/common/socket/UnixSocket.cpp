@@ -0,0 +1,72 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+ * @file UnixSocket.cpp
+ *
+ */
+
+#include <unistd.h>
+
+#include <string>
+
+#include "common/socket/InSocket.hpp"
+#include "common/socket/OutSocket.hpp"
+#include "common/utils/ToString.hpp"
+
+#include "common/utils/macro_func.h"
+
+using namespace std;
+
+int main() {
+    string path = "/tmp/mws_test_" + ToString(getpid()) + ".sock";
+    InSocket* server = new InSocket(path);
+    OutSocket client(path);
+    OutSocket* accepted = NULL;
+    SocketInfo info;
+    char buf[5];
+
+    FAIL_ON(server->enable() != 0);
+    FAIL_ON(access(path.c_str(), F_OK) != 0);
+    FAIL_ON(client.enable() != 0);
+    FAIL_ON((accepted = server->accept()) == NULL);
+
+    // the peer is told by its credentials
+    info = accepted->getInfo();
+    FAIL_ON(info.hostname != "pid " + ToString(getpid()));
+    FAIL_ON(info.service != "uid " + ToString(getuid()));
+
+    FAIL_ON(client.write("query", 5) != 5);
+    FAIL_ON(accepted->read(buf, 5) != 5);
+    FAIL_ON(string(buf, 5) != "query");
+
+    // the socket is removed with the server
+    delete server;
+    server = NULL;
+    FAIL_ON(access(path.c_str(), F_OK) == 0);
+    delete accepted;
+
+    return 0;
+
+fail:
+    delete accepted;
+    delete server;
+    return -1;
+}
@@ -0,0 +1,81 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+ * @file ShardAnswset.cpp
+ *
+ */
+
+#include <string>
+#include <vector>
+
+#include "mws/broker/ShardAnswset.hpp"
+#include "mws/xmlparser/writeBinaryAnswsetToFd.hpp"
+
+#include "common/utils/macro_func.h"
+
+using namespace std;
+using namespace mws::broker;
+
+int main() {
+    vector<ShardAnswset> answsets(3);
+    ShardAnswset binaryAnswset;
+    mws::MwsAnswset answset;
+    string merged;
+
+    FAIL_ON(readJsonAnswset("{\"size\":3,\"total\":10,"
+                            "\"qvars\":[{\"name\":\"x]\",\"xpath\":\"\"}],"
+                            "\"data\":[4,5,6]}", &answsets[0]) != 0);
+    FAIL_ON(answsets[0].total != 10);
+    FAIL_ON(answsets[0].formulaIds.size() != 3);
+    FAIL_ON(answsets[0].formulaIds[2] != 6);
+    FAIL_ON(answsets[0].qvars != "[{\"name\":\"x]\",\"xpath\":\"\"}]");
+    FAIL_ON(readJsonAnswset("{\"size\":1,\"total\":1,\"data\":[1",
+                            &answsets[1]) != -1);
+
+    FAIL_ON(readJsonAnswset("{\"size\":2,\"total\":2,\"qvars\":[],"
+                            "\"data\":[7,8]}", &answsets[2]) != 0);
+    // shards answer the broker with binary answer sets
+    answset.total = 2;
+    answset.answers.push_back(new mws::types::Answer());
+    answset.answers[0]->formulaId = 8;
+    answset.qvars.push_back(mws::Qvar("x]", ""));
+    FAIL_ON(readBinaryAnswset(mws::writeBinaryAnswsetToString(&answset),
+                              &binaryAnswset) != 0);
+    FAIL_ON(binaryAnswset.total != 2);
+    FAIL_ON(binaryAnswset.formulaIds.size() != 1);
+    FAIL_ON(binaryAnswset.formulaIds[0] != 8);
+    FAIL_ON(binaryAnswset.qvars != answsets[0].qvars);
+
+    answsets[0].answered = answsets[0].parsed = true;
+    answsets[2].answered = answsets[2].parsed = true;
+
+    // the page starts in the first shard and ends in the last one
+    merged = mergeJsonAnswsets(answsets, 1, 3);
+    FAIL_ON(merged != "{\"size\":3,\"total\":12,"
+                      "\"qvars\":[{\"name\":\"x]\",\"xpath\":\"\"}],"
+                      "\"data\":[5,6,7],\"shards\":[0,0,2],"
+                      "\"partial\":true,\"failed\":[1]}");
+
+    return 0;
+
+fail:
+    return -1;
+}
@@ -0,0 +1,221 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+ * @file IndexSnapshot.cpp
+ *
+ * Snapshots ingested from others are left as they are, and a snapshot
+ * rebased on the memsector its frozen deltas were merged into answers as
+ * before, with the harvests ingested meanwhile and without the deleted
+ * documents.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "mws/daemon/IndexSnapshot.hpp"
+#include "mws/dbc/MemCrawlDb.hpp"
+#include "mws/dbc/MemFormulaDb.hpp"
+#include "mws/index/MwsIndexNode.hpp"
+#include "mws/index/Tombstones.hpp"
+#include "mws/index/memsector.h"
+#include "mws/types/CmmlToken.hpp"
+#include "mws/types/MeaningDictionary.hpp"
+#include "common/utils/macro_func.h"
+
+#define TMPFILE_PATH    "/tmp/test_IndexSnapshot.map"
+
+using namespace std;
+using namespace mws;
+using mws::daemon::IndexSnapshot;
+using mws::types::CmmlToken;
+using mws::types::MeaningDictionary;
+
+/// @return harvest of apply(op, x, y) in the document url, which has 4
+/// subterms
+static FILE* newHarvest(const char* url, const char* op,
+                        const char* x, const char* y) {
+    FILE* file = tmpfile();
+    if (file == NULL) return NULL;
+
+    fprintf(file,
+            "<?xml version=\"1.0\"?>\n"
+            "<mws:harvest xmlns:mws=\"http://search.mathweb.org/ns\" "
+            "xmlns:m=\"http://www.w3.org/1998/Math/MathML\">\n"
+            "  <mws:expr url=\"%s\"><content>\n"
+            "    <m:apply><m:%s/><m:ci>%s</m:ci><m:ci>%s</m:ci></m:apply>\n"
+            "  </content></mws:expr>\n"
+            "</mws:harvest>\n", url, op, x, y);
+    rewind(file);
+
+    return file;
+}
+
+/// @return snapshot with the harvest ingested, or NULL
+static IndexSnapshot* ingest(const IndexSnapshot& snapshot, const char* url,
+                             const char* op, const char* x, const char* y) {
+    int numLoaded = 0;
+    FILE* file = newHarvest(url, op, x, y);
+    if (file == NULL) return NULL;
+
+    IndexSnapshot* ingested = snapshot.ingest(file, &numLoaded);
+    // the subterms are ingested as well
+    if (ingested != NULL && numLoaded != 4) {
+        delete ingested;
+        return NULL;
+    }
+
+    return ingested;
+}
+
+/// @return number of solutions of apply(op, x, y) in snapshot
+static int countSolutions(const IndexSnapshot& snapshot, const char* op,
+                          const char* x, const char* y) {
+    CmmlToken* query = CmmlToken::newRoot(false);
+    query->setTag("m:apply");
+    query->newChildNode()->setTag(string("m:") + op);
+    CmmlToken* ci = query->newChildNode();
+    ci->setTag("m:ci");
+    ci->appendTextContent(x, strlen(x));
+    ci = query->newChildNode();
+    ci->setTag("m:ci");
+    ci->appendTextContent(y, strlen(y));
+
+    MwsAnswset* result = snapshot.search(query, 0, 10, 10);
+    int total = result->total;
+    delete result;
+    delete query;
+
+    return total;
+}
+
+static void unloadMemsector(memsector_handle_t* ms) {
+    (void) memsector_unload(ms);
+    delete ms;
+}
+
+/// @return memsector of the index, or NULL
+static shared_ptr<const memsector_handle_t> exportIndex(MwsIndexNode* index) {
+    memsector_writer_t mswr;
+    memsector_handle_t* ms = new memsector_handle_t;
+
+    if ((unlink(TMPFILE_PATH) != 0 && errno != ENOENT) ||
+            memsector_create(&mswr, TMPFILE_PATH, 0) != 0) {
+        delete ms;
+        return nullptr;
+    }
+    if (index->exportToMemsector(&mswr) != 0 || memsector_save(&mswr) != 0) {
+        (void) memsector_discard(&mswr);
+        delete ms;
+        return nullptr;
+    }
+    if (memsector_load(ms, TMPFILE_PATH) != 0) {
+        delete ms;
+        return nullptr;
+    }
+
+    return shared_ptr<const memsector_handle_t>(ms, unloadMemsector);
+}
+
+int main() {
+    dbc::MemCrawlDb crawlDb;
+    dbc::MemFormulaDb formulaDb;
+    MwsIndexNode* base = new MwsIndexNode();
+    MwsIndexNode* merged = NULL;
+    map<FormulaId, FormulaId> renamed;
+    vector<int> numHits;
+    shared_ptr<const memsector_handle_t> ms;
+
+    shared_ptr<IndexSnapshot> empty(new IndexSnapshot(
+            base, nullptr, MeaningDictionary(CONST_ID_MIN),
+            make_shared<index::Tombstones>(), &crawlDb, &formulaDb));
+    shared_ptr<IndexSnapshot> s1, s2, frozen, s3, s4, rebased;
+
+    // ingesting leaves the snapshots ingested from as they are
+    s1.reset(ingest(*empty, "doc1", "eq", "a", "b"));
+    FAIL_ON(s1 == NULL);
+    s2.reset(ingest(*s1, "doc2", "eq", "a", "c"));
+    FAIL_ON(s2 == NULL);
+    FAIL_ON(countSolutions(*empty, "eq", "a", "b") != 0);
+    FAIL_ON(countSolutions(*s1, "eq", "a", "b") != 1);
+    FAIL_ON(countSolutions(*s1, "eq", "a", "c") != 0);
+    FAIL_ON(countSolutions(*s2, "eq", "a", "b") != 1);
+    FAIL_ON(countSolutions(*s2, "eq", "a", "c") != 1);
+    FAIL_ON(s2->getNumDeltaExpressions() != 8);
+
+    // harvests ingested into a frozen snapshot go to a new delta
+    frozen.reset(s2->freeze());
+    s3.reset(ingest(*frozen, "doc3", "eq", "a", "b"));
+    FAIL_ON(s3 == NULL);
+    FAIL_ON(countSolutions(*frozen, "eq", "a", "b") != 1);
+    FAIL_ON(countSolutions(*s3, "eq", "a", "b") != 2);
+
+    // deleting a document leaves the older snapshots as they are
+    s4.reset(s3->removeDocuments(vector<string>(1, "doc1"), &numHits));
+    FAIL_ON(numHits.size() != 1 || numHits[0] != 4);
+    FAIL_ON(countSolutions(*s3, "eq", "a", "b") != 2);
+    FAIL_ON(countSolutions(*s4, "eq", "a", "b") != 1);
+
+    // the frozen deltas merged into a memsector replace the base
+    merged = frozen->mergeIndexes(&renamed);
+    ms = exportIndex(merged);
+    FAIL_ON(ms == NULL);
+    rebased.reset(s4->rebase(ms, *frozen, renamed));
+    FAIL_ON(rebased->getNumDeltaExpressions() != 4);
+    FAIL_ON(countSolutions(*rebased, "eq", "a", "b") != 1);
+    FAIL_ON(countSolutions(*rebased, "eq", "a", "c") != 1);
+    FAIL_ON(countSolutions(*s4, "eq", "a", "b") != 1);
+    FAIL_ON(countSolutions(*s4, "eq", "a", "c") != 1);
+
+    // documents deleted after the freeze are still deleted once rebased
+    numHits.clear();
+    rebased.reset(rebased->removeDocuments(vector<string>(1, "doc2"),
+                                           &numHits));
+    FAIL_ON(numHits.size() != 1 || numHits[0] != 4);
+    FAIL_ON(countSolutions(*rebased, "eq", "a", "c") != 0);
+    FAIL_ON(countSolutions(*rebased, "eq", "a", "b") != 1);
+
+    rebased.reset();
+    ms.reset();
+    FAIL_ON(unlink(TMPFILE_PATH) != 0);
+    delete merged;
+    // the snapshots do not own the in-memory base
+    empty.reset();
+    s1.reset();
+    s2.reset();
+    frozen.reset();
+    s3.reset();
+    s4.reset();
+    delete base;
+    return 0;
+
+fail:
+    (void) unlink(TMPFILE_PATH);
+    delete merged;
+    delete base;
+    return -1;
+}
@@ -0,0 +1,261 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+ * @file MwsIndexNode.cpp
+ *
+ * Copy on write of shared indexes, merges, removal of hits and indexes
+ * imported back from a memsector with a delta merged into them.
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <map>
+#include <stack>
+
+#include "mws/index/MwsIndexNode.hpp"
+#include "mws/index/memsector.h"
+#include "mws/types/CmmlToken.hpp"
+#include "mws/types/MeaningDictionary.hpp"
+#include "common/utils/macro_func.h"
+
+#define TMPFILE_PATH    "/tmp/test_MwsIndexNode.map"
+
+using namespace std;
+using namespace mws;
+using mws::types::CmmlToken;
+using mws::types::MeaningDictionary;
+
+namespace mws {
+
+class Tester {
+  public:
+    /// @return leaf of expression in the index, or NULL
+    static MwsIndexNode* find(MwsIndexNode* index,
+                              const CmmlToken* expression,
+                              const MeaningDictionary& dict);
+    static bool same_index(MwsIndexNode* a, MwsIndexNode* b);
+    static uint32_t refs(MwsIndexNode* node) { return node->refs.load(); }
+};
+
+}
+
+/// @return apply(op, x, y)
+static CmmlToken* newApply(const char* op, const char* x, const char* y) {
+    CmmlToken* apply = CmmlToken::newRoot(false);
+    apply->setTag("m:apply");
+    apply->newChildNode()->setTag(op);
+    CmmlToken* ci = apply->newChildNode();
+    ci->setTag("m:ci");
+    ci->appendTextContent(x, strlen(x));
+    ci = apply->newChildNode();
+    ci->setTag("m:ci");
+    ci->appendTextContent(y, strlen(y));
+
+    return apply;
+}
+
+/// @return leaf of the indexed expression
+static MwsIndexNode* insert(MwsIndexNode* index, const CmmlToken* expression,
+                            MeaningDictionary* dict) {
+    MwsIndexNode* leaf = index->insertData(expression, dict);
+    leaf->solutions++;
+
+    return leaf;
+}
+
+/// @return 0 on success, -1 on failure
+static int exportAndLoad(MwsIndexNode* index, memsector_handle_t* ms) {
+    memsector_writer_t mswr;
+
+    if (unlink(TMPFILE_PATH) != 0 && errno != ENOENT) return -1;
+    if (memsector_create(&mswr, TMPFILE_PATH, 0) != 0) return -1;
+    if (index->exportToMemsector(&mswr, EXPORT_LAYOUT_DFS, NULL,
+                                 EXPORT_ENCODING_COMPACT) != 0 ||
+            memsector_save(&mswr) != 0) {
+        (void) memsector_discard(&mswr);
+        return -1;
+    }
+
+    return memsector_load(ms, TMPFILE_PATH);
+}
+
+int main() {
+    MeaningDictionary dict(CONST_ID_MIN);
+    CmmlToken* f1 = newApply("m:eq", "x", "y");
+    CmmlToken* f2 = newApply("m:eq", "x", "z");
+    CmmlToken* f3 = newApply("m:plus", "x", "y");
+    CmmlToken* f4 = newApply("m:minus", "x", "y");
+    MwsIndexNode* base = new MwsIndexNode();
+    MwsIndexNode* shared = NULL;
+    MwsIndexNode* delta = NULL;
+    MwsIndexNode* merged = NULL;
+    MwsIndexNode* imported = NULL;
+    MwsIndexNode* reimported = NULL;
+    MwsIndexNode* leaf;
+    map<FormulaId, FormulaId> renamed;
+    map<FormulaId, uint32_t> hits;
+    memsector_handle_t ms;
+    bool loaded = false;
+
+    MwsIndexNode* f1Leaf = insert(base, f1, &dict);
+
+    // the shared index copies the path to the formulae it changes
+    shared = base->share();
+    FAIL_ON(insert(shared, f2, &dict) == NULL);
+    FAIL_ON(Tester::find(base, f2, dict) != NULL);
+    FAIL_ON(Tester::find(shared, f2, dict) == NULL);
+    leaf = insert(shared, f1, &dict);
+    FAIL_ON(leaf == f1Leaf || leaf->id != f1Leaf->id);
+    FAIL_ON(leaf->solutions != 2 || f1Leaf->solutions != 1);
+    FAIL_ON(Tester::refs(f1Leaf) != 1 || Tester::refs(leaf) != 1);
+    // the nodes still shared are freed with the last index using them
+    insert(base, f3, &dict);
+    delete base;
+    base = NULL;
+    FAIL_ON(Tester::find(shared, f3, dict) != NULL);
+    FAIL_ON(Tester::find(shared, f1, dict)->solutions != 2);
+
+    // formulae present in both keep the id they have in the merged index
+    delta = new MwsIndexNode();
+    leaf = insert(delta, f1, &dict);
+    insert(delta, f3, &dict);
+    merged = shared->clone();
+    merged->merge(delta, &renamed);
+    FAIL_ON(Tester::find(merged, f1, dict)->solutions != 3);
+    FAIL_ON(Tester::find(merged, f3, dict) == NULL);
+    FAIL_ON(renamed.size() != 1);
+    FAIL_ON(renamed[leaf->id] != Tester::find(shared, f1, dict)->id);
+    FAIL_ON(Tester::find(shared, f3, dict) != NULL);
+
+    // leaves left without hits and their subtrees are dropped
+    hits[Tester::find(merged, f1, dict)->id] = 1;
+    FAIL_ON(!merged->removeHits(hits));
+    FAIL_ON(Tester::find(merged, f1, dict)->solutions != 2);
+    hits.clear();
+    hits[Tester::find(merged, f3, dict)->id] = 1;
+    FAIL_ON(!merged->removeHits(hits));
+    FAIL_ON(Tester::find(merged, f3, dict) != NULL);
+    FAIL_ON(merged->countLeaves() != 2);
+    hits.clear();
+    hits[Tester::find(merged, f1, dict)->id] = 2;
+    hits[Tester::find(merged, f2, dict)->id] = 1;
+    FAIL_ON(merged->removeHits(hits));
+    delete merged;
+    merged = NULL;
+
+    // a memsector imported back with a delta merged gives the same index
+    // as the delta merged in memory
+    FAIL_ON(exportAndLoad(shared, &ms) != 0);
+    loaded = true;
+    imported = MwsIndexNode::importFromMemsector(&ms.index);
+    FAIL_ON(!Tester::same_index(shared, imported));
+    renamed.clear();
+    imported->merge(delta, &renamed);
+    merged = shared->clone();
+    merged->merge(delta);
+    FAIL_ON(!Tester::same_index(merged, imported));
+    FAIL_ON(renamed[Tester::find(delta, f1, dict)->id] !=
+            Tester::find(shared, f1, dict)->id);
+    FAIL_ON(memsector_unload(&ms) != 0);
+    loaded = false;
+
+    FAIL_ON(exportAndLoad(imported, &ms) != 0);
+    loaded = true;
+    reimported = MwsIndexNode::importFromMemsector(&ms.index);
+    FAIL_ON(!Tester::same_index(merged, reimported));
+
+    // nodes created after a reload do not reuse its ids
+    MwsIndexNode::reserveIds(1000);
+    leaf = insert(reimported, f4, &dict);
+    FAIL_ON(leaf->id <= 1000);
+
+    FAIL_ON(memsector_unload(&ms) != 0);
+    FAIL_ON(unlink(TMPFILE_PATH) != 0);
+    delete shared;
+    delete delta;
+    delete merged;
+    delete imported;
+    delete reimported;
+    delete f1;
+    delete f2;
+    delete f3;
+    delete f4;
+    return 0;
+
+fail:
+    if (loaded) (void) memsector_unload(&ms);
+    (void) unlink(TMPFILE_PATH);
+    delete base;
+    delete shared;
+    delete delta;
+    delete merged;
+    delete imported;
+    delete reimported;
+    delete f1;
+    delete f2;
+    delete f3;
+    delete f4;
+    return -1;
+}
+
+MwsIndexNode* Tester::find(MwsIndexNode* index, const CmmlToken* expression,
+                           const MeaningDictionary& dict) {
+    stack<const CmmlToken*> tokens;
+    MwsIndexNode* node = index;
+
+    tokens.push(expression);
+    while (!tokens.empty()) {
+        const CmmlToken* token = tokens.top();
+        tokens.pop();
+
+        NodeInfo info = make_pair(dict.get(token->getMeaning()),
+                                  token->getChildNodes().size());
+        MwsIndexNode::_MapType::iterator it = node->children.find(info);
+        if (it == node->children.end()) return NULL;
+        node = it->second;
+
+        CmmlToken::PtrList::const_reverse_iterator rIt;
+        for (rIt = token->getChildNodes().rbegin();
+             rIt != token->getChildNodes().rend(); rIt++) {
+            tokens.push(*rIt);
+        }
+    }
+
+    return node;
+}
+
+bool Tester::same_index(MwsIndexNode* a, MwsIndexNode* b) {
+    if (a->children.size() != b->children.size()) return false;
+    if (a->children.size() == 0) {
+        return (a->id == b->id) && (a->solutions == b->solutions);
+    }
+
+    MwsIndexNode::_MapType::iterator it, jt;
+    for (it = a->children.begin(), jt = b->children.begin();
+         it != a->children.end();
+         it++, jt++) {
+        if (it->first != jt->first) return false;
+        if (!same_index(it->second, jt->second)) return false;
+    }
+    return true;
+}
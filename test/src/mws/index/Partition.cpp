@@ -0,0 +1,89 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+ * @file Partition.cpp
+ *
+ */
+
+#include "mws/index/Partition.hpp"
+
+#include "common/utils/macro_func.h"
+
+using namespace mws::index;
+using mws::types::CmmlToken;
+
+/// @return apply(op, x, y) where y is a query variable if qvar is set
+static CmmlToken* newApply(const char* op, bool qvar) {
+    CmmlToken* apply = CmmlToken::newRoot(false);
+    apply->setTag("m:apply");
+    apply->newChildNode()->setTag(op);
+    CmmlToken* x = apply->newChildNode();
+    x->setTag("m:ci");
+    x->appendTextContent("x", 1);
+    apply->newChildNode()->setTag(qvar ? "mws:qvar" : "m:ci");
+
+    return apply;
+}
+
+int main() {
+    Partition partition;
+    CmmlToken* eq = newApply("m:eq", false);
+    CmmlToken* eqQuery = newApply("m:eq", true);
+    CmmlToken* qvar = CmmlToken::newRoot(false);
+    int routed;
+    qvar->setTag("mws:qvar");
+
+    // not split
+    FAIL_ON(!partition.contains(eq));
+    FAIL_ON(Partition::route(qvar, 1, 1) != 0);
+
+    FAIL_ON(partition.parse("3/3") != -1);
+    FAIL_ON(partition.parse("1") != -1);
+    FAIL_ON(partition.parse("1/4") != 0);
+    FAIL_ON(partition.index != 1 || partition.count != 4);
+
+    // each expression is in exactly one partition, the one of its queries
+    for (unsigned numTokens = 1; numTokens <= 3; numTokens++) {
+        int numContaining = 0;
+        partition.numTokens = numTokens;
+        routed = Partition::route(eqQuery, 4, numTokens);
+        FAIL_ON(routed < 0);
+        for (partition.index = 0; partition.index < 4; partition.index++) {
+            if (partition.contains(eq)) {
+                FAIL_ON((int) partition.index != routed);
+                numContaining++;
+            }
+        }
+        FAIL_ON(numContaining != 1);
+    }
+
+    // query variables in the prefix can match any partition
+    FAIL_ON(Partition::route(qvar, 4, 1) != -1);
+    FAIL_ON(Partition::route(eqQuery, 4, 4) != -1);
+
+    delete eq;
+    delete eqQuery;
+    delete qvar;
+    return 0;
+
+fail:
+    return -1;
+}
@@ -24,6 +24,7 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
  */
 
 #include <string>
+#include <vector>
 #include <cerrno>
 
 #include "mws/index/MwsIndexNode.hpp"
@@ -39,7 +40,6 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 
 #define TMPDBENV_PATH   "/tmp"
 #define TMPFILE_PATH    "/tmp/test.map"
-#define TMPFILE_SIZE    500 * 1024 * 1024
 
 
 using namespace std;
@@ -49,12 +49,16 @@ namespace mws {
 
 class Tester {
   public:
-    static bool memsector_inode_consistent(MwsIndexNode* tmp_node, inode_t* inode);
+    static bool memsector_inode_consistent(MwsIndexNode* tmp_node, inode_t* inode,
+                                           ExportEncoding encoding);
+    static void count_accesses(MwsIndexNode* tmp_node, AccessCounts* counts);
+    static bool same_index(MwsIndexNode* a, MwsIndexNode* b);
 };
 
 }
 
-static int test_memsector_consistency(MwsIndexNode* data, memsector_handle_t* ms);
+static int test_memsector_consistency(MwsIndexNode* data, memsector_handle_t* ms,
+                                      ExportEncoding encoding);
 
 int main() {
     memsector_writer_t mswr;
@@ -67,10 +71,18 @@ int main() {
     dbc::FormulaDb* formulaDb = new dbc::MemFormulaDb();
     MwsIndexNode* data = new MwsIndexNode();
     types::MeaningDictionary* meaningDictionary =
-            new types::MeaningDictionary();
+            new types::MeaningDictionary(CONST_ID_MIN);
 
     index::IndexManager* indexManager =
             new index::IndexManager(formulaDb,crawlDb, data, meaningDictionary);
+    AccessCounts accessCounts;
+    MwsIndexNode* imported;
+    const ExportLayout layouts[] = {
+        EXPORT_LAYOUT_DFS, EXPORT_LAYOUT_BLOCKS, EXPORT_LAYOUT_HOT
+    };
+    const ExportEncoding encodings[] = {
+        EXPORT_ENCODING_FIXED, EXPORT_ENCODING_COMPACT
+    };
 
     /* ensure the file does not exist */
     FAIL_ON(unlink(ms_path) != 0 && errno != ENOENT);
@@ -79,28 +91,44 @@ int main() {
                                         AbsPath("."),
                                         /* recursive = */ false) <= 0);
 
-    FAIL_ON(memsector_create(&mswr, ms_path, TMPFILE_SIZE) != 0);
-    printf("Memsector %s created\n", ms_path);
-    
-    data->exportToMemsector(&mswr);
-    printf("Index exported to memsector\n");
-    printf("Space used: %d Kb\n",
-           memsector_size_inuse(&mswr.ms_header->alloc_header) / 1024);
+    Tester::count_accesses(data, &accessCounts);
 
-    FAIL_ON(memsector_save(&mswr) != 0);
-    printf("Memsector saved\n");
+    for (ExportLayout layout : layouts) {
+        for (ExportEncoding encoding : encodings) {
+            FAIL_ON(memsector_create(&mswr, ms_path, 0) != 0);
+            printf("Memsector %s created\n", ms_path);
 
-    FAIL_ON(memsector_load(&ms, ms_path) != 0);
-    printf("Memsector loaded\n");
+            FAIL_ON(data->exportToMemsector(&mswr, layout, &accessCounts,
+                                            encoding) != 0);
+            printf("Index exported to memsector with layout %d encoding %d\n",
+                   layout, encoding);
+            uint64_t used = memsector_size_inuse(&mswr.ms_header->alloc_header);
+            printf("Space used: %llu Kb, %.1f bytes per formula\n",
+                   (unsigned long long) used / 1024,
+                   (double) used / data->countLeaves());
 
-    if (test_memsector_consistency(data, &ms) != 0) {
-        printf("FAIL: Inconsistency detected!\n");
-        goto fail;
-    }
-    printf("Memsector consistent with index\n");
+            FAIL_ON(memsector_save(&mswr) != 0);
+            printf("Memsector saved\n");
+
+            FAIL_ON(memsector_load(&ms, ms_path) != 0);
+            printf("Memsector loaded\n");
+
+            if (test_memsector_consistency(data, &ms, encoding) != 0) {
+                printf("FAIL: Inconsistency detected!\n");
+                goto fail;
+            }
+            printf("Memsector consistent with index\n");
 
-    FAIL_ON(memsector_remove(&ms) != 0);
-    printf("Memsector removed\n");
+            imported = MwsIndexNode::importFromMemsector(&ms.index);
+            FAIL_ON(!Tester::same_index(data, imported));
+            delete imported;
+            printf("Memsector imported back\n");
+
+            FAIL_ON(memsector_remove(&ms) != 0);
+            FAIL_ON(memsector_unload(&ms) != 0);
+            printf("Memsector removed\n");
+        }
+    }
 
     return 0;
 
@@ -108,36 +136,106 @@ fail:
     return -1;
 }
 
+void Tester::count_accesses(MwsIndexNode* tmp_node, AccessCounts* counts) {
+    // hot nodes: the root and its children
+    (*counts)[tmp_node] = 2;
+    for (auto& child : tmp_node->children) {
+        (*counts)[child.second] = 1;
+    }
+}
+
+bool Tester::same_index(MwsIndexNode* a, MwsIndexNode* b) {
+    if (a->children.size() != b->children.size()) return false;
+    if (a->children.size() == 0) {
+        return (a->id == b->id) && (a->solutions == b->solutions);
+    }
+
+    MwsIndexNode::_MapType::iterator it, jt;
+    for (it = a->children.begin(), jt = b->children.begin();
+         it != a->children.end();
+         it++, jt++) {
+        if (it->first != jt->first) return false;
+        if (!same_index(it->second, jt->second)) return false;
+    }
+    return true;
+}
+
 const memsector_alloc_header_t *alloc;
+const index_handle_t *index_handle;
+const leaf_t *leaves;
+uint32_t next_leaf;
 
-bool Tester::memsector_inode_consistent(MwsIndexNode* tmp_node, inode_t* inode) {
+bool Tester::memsector_inode_consistent(MwsIndexNode* tmp_node, inode_t* inode,
+                                        ExportEncoding encoding) {
     // XXX unbound recursive behavior... dangerous in general... ok in test
 
     switch(inode->type) {
         case INTERNAL_NODE: {
-            if (tmp_node->children.size() != inode->size) return false;
+            if (tmp_node->children.size() != inode_get_size(inode)) return false;
+            // leaves of the subtree should start at the next leaf
+            if (inode->leaves_begin != next_leaf) return false;
+
+            if (encoding == EXPORT_ENCODING_COMPACT &&
+                    inode->num_consts <= INODE_COMPACT_MAX_SIZE) {
+                if (inode->layout != INODE_LAYOUT_COMPACT) return false;
+            } else if (inode->layout != (inode->num_consts < INODE_EYTZINGER_MIN_SIZE ?
+                                         INODE_LAYOUT_SORTED :
+                                         INODE_LAYOUT_EYTZINGER)) return false;
 
-            int i = 0;
             MwsIndexNode::_MapType::iterator it;
             for (it = tmp_node->children.begin();
                 it != tmp_node->children.end();
-                it++, i++) {
+                it++) {
 
                 MeaningId     meaningId  = it->first.first;
                 Arity         arity      = it->first.second;
                 MwsIndexNode* child_node = it->second;
 
-                if (meaningId != inode->data[i].token.id) return false;
-                if (arity     != inode->data[i].token.arity) return false;
+                // variables should be in the variable section
+                if ((meaningId <= VAR_ID_MAX) !=
+                    (it - tmp_node->children.begin() < inode->num_vars)) return false;
 
-                inode_t* child_inode = (inode_t*) memsector_off2addr(alloc, inode->data[i].off);
-                if (!memsector_inode_consistent(child_node, child_inode)) return false;
+                memsector_off_t off = index_get_child(index_handle, inode,
+                                                      encoded_token(meaningId, arity));
+                if (off == 0) return false;
+
+                inode_t* child_inode = (inode_t*) memsector_off2addr(alloc, off);
+                if (!memsector_inode_consistent(child_node, child_inode,
+                                                encoding)) return false;
             }
-            return true;
+            // and end after the last leaf of the last child
+            return (inode->leaves_end == next_leaf);
+        }
+
+        case PATH_NODE: {
+            pnode_t* path = (pnode_t*) inode;
+            if (path->leaves_begin != next_leaf) return false;
+            if (path->compact != (encoding == EXPORT_ENCODING_COMPACT)) return false;
+
+            // the run should follow the chain of single constant children
+            vector<encoded_token_t> buf(path->size);
+            const encoded_token_t* tokens = pnode_get_tokens(index_handle, path, buf.data());
+            for (uint32_t i = 0; i < path->size; i++) {
+                if (tmp_node->children.size() != 1) return false;
+                MwsIndexNode::_MapType::iterator it = tmp_node->children.begin();
+                encoded_token_t token = tokens[path->size - 1 - i];
+                if (it->first.first <= VAR_ID_MAX) return false;
+                if (it->first.first  != token.id) return false;
+                if (it->first.second != token.arity) return false;
+                tmp_node = it->second;
+            }
+
+            inode_t* next = (inode_t*) memsector_off2addr(alloc, path->next);
+            if (next->type == PATH_NODE) return false;
+            if (!memsector_inode_consistent(tmp_node, next, encoding)) return false;
+            return (path->leaves_end == next_leaf);
         }
 
         case LEAF_NODE: {
             leaf_t *leaf = (leaf_t*)inode;
+            // leaves should be stored densely in DFS order
+            if (leaf != &leaves[next_leaf]) return false;
+            next_leaf++;
             return (tmp_node->id == leaf->dbid) && (tmp_node->solutions == leaf->num_hits);
         }
 
@@ -148,9 +246,14 @@ bool Tester::memsector_inode_consistent(MwsIndexNode* tmp_node, inode_t* inode)
 }
 
 static
-int test_memsector_consistency(MwsIndexNode* data, memsector_handle_t* ms) {
+int test_memsector_consistency(MwsIndexNode* data, memsector_handle_t* ms,
+                               ExportEncoding encoding) {
     alloc = ms_get_alloc(ms);
-    if (Tester::memsector_inode_consistent(data, ms->index.root))
+    index_handle = &ms->index;
+    leaves = ms->index.leaves;
+    next_leaf = 0;
+    if (Tester::memsector_inode_consistent(data, ms->index.root, encoding) &&
+            next_leaf == ms->index.num_leaves)
         return 0;
     else
         return -1;
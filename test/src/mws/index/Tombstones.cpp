@@ -0,0 +1,102 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+ * @file Tombstones.cpp
+ *
+ */
+
+#include <sstream>
+
+#include "mws/index/Tombstones.hpp"
+
+#include "common/utils/macro_func.h"
+
+using namespace std;
+using namespace mws::index;
+using mws::FormulaId;
+
+int main() {
+    Tombstones tombstones;
+    map<FormulaId, uint32_t> removed;
+    map<FormulaId, FormulaId> renamed;
+
+    tombstones.addOccurrence("doc1", 1);
+    tombstones.addOccurrence("doc1", 2);
+    tombstones.addOccurrence("doc2", 2);
+    FAIL_ON(tombstones.copyDeadHits()->getLiveHits(2, 2) != 2);
+
+    FAIL_ON(tombstones.removeDocument("doc3") != -1);
+    FAIL_ON(tombstones.removeDocument("doc1") != 2);
+    FAIL_ON(tombstones.removeDocument("doc1") != -1);
+    FAIL_ON(tombstones.copyDeadHits()->getLiveHits(1, 1) != 0);
+    FAIL_ON(tombstones.copyDeadHits()->getLiveHits(2, 2) != 1);
+
+    // updated document
+    tombstones.addOccurrence("doc1", 3);
+    FAIL_ON(tombstones.copyDeadHits()->getLiveHits(1, 1) != 0);
+    FAIL_ON(tombstones.copyDeadHits()->getLiveHits(3, 1) != 1);
+    FAIL_ON(tombstones.removeDocument("doc1") != 1);
+
+    // saved without formula 3, which is not in the index yet
+    {
+        stringstream buf;
+        Tombstones loaded;
+        FAIL_ON(tombstones.save(buf, 2) != 0);
+        FAIL_ON(loaded.load(buf) != 0);
+        FAIL_ON(loaded.copyDeadHits()->getLiveHits(1, 1) != 0);
+        FAIL_ON(loaded.copyDeadHits()->getLiveHits(2, 2) != 1);
+        FAIL_ON(loaded.copyDeadHits()->getLiveHits(3, 1) != 1);
+        FAIL_ON(loaded.removeDocument("doc1") != -1);
+        FAIL_ON(loaded.removeDocument("doc2") != 1);
+    }
+
+    // documents with an empty URI (url="" in the harvest) are saved too
+    {
+        stringstream buf;
+        Tombstones empty, loaded;
+        empty.addOccurrence("", 4);
+        empty.addOccurrence("doc4", 4);
+        empty.addOccurrence("doc5", 5);
+        FAIL_ON(empty.removeDocument("doc5") != 1);
+        FAIL_ON(empty.save(buf, 5) != 0);
+        FAIL_ON(loaded.load(buf) != 0);
+        FAIL_ON(loaded.copyDeadHits()->getLiveHits(5, 1) != 0);
+        FAIL_ON(loaded.removeDocument("doc5") != -1);
+        FAIL_ON(loaded.removeDocument("") != 1);
+        FAIL_ON(loaded.removeDocument("doc4") != 1);
+        FAIL_ON(loaded.copyDeadHits()->getLiveHits(4, 2) != 0);
+    }
+
+    // formula 1 and a hit of formula 2 removed, formula 3 merged into 2
+    removed[1] = 1;
+    removed[2] = 1;
+    renamed[3] = 2;
+    tombstones.compact(removed, renamed);
+    FAIL_ON(tombstones.copyDeadHits()->getLiveHits(1, 1) != 1);
+    FAIL_ON(tombstones.copyDeadHits()->getLiveHits(2, 2) != 1);
+    FAIL_ON(tombstones.removeDocument("doc2") != 1);
+    FAIL_ON(tombstones.copyDeadHits()->getLiveHits(2, 2) != 0);
+
+    return 0;
+
+fail:
+    return -1;
+}
@@ -0,0 +1,89 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+  * @brief Testing for the binary answer sets
+  *
+  * @file writeBinaryAnswsetToFdTest.cpp
+  * @date 19 Oct 2026
+  *
+  * License: GPL v3
+  *
+  */
+
+#include <string>
+#include <vector>
+
+#include "mws/xmlparser/writeBinaryAnswsetToFd.hpp"
+#include "common/utils/macro_func.h"
+
+using namespace std;
+using namespace mws;
+using namespace mws::types;
+
+int main()
+{
+    MwsAnswset  answset;
+    MwsAnswset  read;
+    MwsAnswset  truncated;
+    MwsAnswset  empty;
+    vector<MwsAnswset*> batch;
+    string      data;
+    // ids go down as well as up, and one does not fit 28 bits
+    const FormulaId formulaIds[] = {7, 3, 300, 0xfffffff0, 1};
+
+    for (FormulaId formulaId : formulaIds) {
+        Answer* answer = new Answer();
+        answer->formulaId = formulaId;
+        answset.answers.push_back(answer);
+    }
+    answset.total = 42;
+    answset.qvars.push_back(Qvar("x", "/1/2"));
+
+    data = writeBinaryAnswsetToString(&answset);
+    // header, 1 + 1 + 2 + 5 + 5 bytes of ids, then 1 + 2 + 5 bytes of qvars
+    FAIL_ON(data.compare(0, 4, "MWSA") != 0);
+    FAIL_ON(data.size() != 16 + 14 + 8);
+
+    FAIL_ON(readBinaryAnswset(data.data(), data.size(), &read) != 0);
+    FAIL_ON(read.total != 42);
+    FAIL_ON(read.answers.size() != answset.answers.size());
+    for (size_t i = 0; i < read.answers.size(); i++) {
+        FAIL_ON(read.answers[i]->formulaId != formulaIds[i]);
+    }
+    FAIL_ON(read.qvars.size() != 1);
+    FAIL_ON(read.qvars[0].name != "x" || read.qvars[0].xpath != "/1/2");
+
+    FAIL_ON(readBinaryAnswset(data.data(), data.size() - 1, &truncated) != -1);
+
+    // a batch answering the same expression twice, then an empty one
+    data = writeBinaryAnswsetsToString({&answset, &answset, &empty});
+    FAIL_ON(readBinaryAnswsets(data.data(), data.size(), &batch) != 0);
+    FAIL_ON(batch.size() != 3);
+    FAIL_ON(batch[1]->total != 42 || batch[1]->answers.size() != 5);
+    FAIL_ON(!batch[2]->answers.empty());
+
+    for (MwsAnswset* result : batch) delete result;
+    return 0;
+
+fail:
+    for (MwsAnswset* result : batch) delete result;
+    return -1;
+}
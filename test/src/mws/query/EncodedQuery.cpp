@@ -0,0 +1,143 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+ * @file EncodedQuery.cpp
+ *
+ */
+
+#include <string.h>
+#include <string>
+
+#include "mws/query/EncodedQuery.hpp"
+#include "mws/query/EngineSearchContext.hpp"
+#include "mws/types/CmmlToken.hpp"
+#include "mws/types/MeaningDictionary.hpp"
+
+#include "common/utils/macro_func.h"
+#include "common/utils/ToString.hpp"
+
+using namespace mws;
+using namespace mws::types;
+using namespace std;
+
+static void setToken(CmmlToken* token, const char* tag, const char* text) {
+    token->setTag(tag);
+    token->appendTextContent(text, strlen(text));
+}
+
+int main() {
+    CmmlToken* expression = CmmlToken::newRoot(false);
+    CmmlToken* decoded = NULL;
+    CmmlToken* token;
+    EncodedQuery query, read, truncated, again, rejected;
+    MeaningDictionary dict(CONST_ID_MIN);
+    MwsAnswset* fromTokens = NULL;
+    MwsAnswset* fromEncoded = NULL;
+    string data;
+
+    // apply(eq, x, ?a, apply(plus, ?, ?a))
+    setToken(expression, "m:apply", "");
+    setToken(expression->newChildNode(), "m:eq", "");
+    setToken(expression->newChildNode(), "m:ci", "x");
+    setToken(expression->newChildNode(), "mws:qvar", "a");
+    token = expression->newChildNode();
+    setToken(token, "m:apply", "");
+    setToken(token->newChildNode(), "m:plus", "");
+    setToken(token->newChildNode(), "mws:qvar", "");
+    setToken(token->newChildNode(), "mws:qvar", "a");
+
+    query.setExpression(expression);
+    query.offset = 5;
+    query.outputFormat = DATAFORMAT_BINARY;
+    FAIL_ON(query.tokens.size() != 8);
+    FAIL_ON(query.tokens[0].value != "apply" || query.tokens[0].arity != 4);
+    FAIL_ON(query.tokens[2].value != "#x");
+
+    data = writeEncodedQuery(query);
+    FAIL_ON(readEncodedQuery(data.data(), data.size(), &read) != 0);
+    FAIL_ON(read.offset != 5 || read.size != query.size);
+    FAIL_ON(read.outputFormat != DATAFORMAT_BINARY);
+    FAIL_ON(read.tokens.size() != query.tokens.size());
+    for (size_t i = 0; i < read.tokens.size(); i++) {
+        FAIL_ON(read.tokens[i].value != query.tokens[i].value);
+        FAIL_ON(read.tokens[i].arity != query.tokens[i].arity);
+        FAIL_ON(read.tokens[i].isQvar != query.tokens[i].isQvar);
+    }
+    // a truncated expression is not a query
+    FAIL_ON(readEncodedQuery(data.data(), data.size() - 3,
+                             &truncated) != -1);
+
+    // queries which the engine cannot hold are rejected
+    for (int i = 0; i < 600; i++) {
+        rejected.tokens.push_back(EncodedQueryToken("f", 1, false));
+    }
+    rejected.tokens.push_back(EncodedQueryToken("#x", 0, false));
+    data = writeEncodedQuery(rejected);
+    FAIL_ON(readEncodedQuery(data.data(), data.size(), &read) != -1);
+    rejected.tokens.clear();
+    rejected.tokens.push_back(EncodedQueryToken("f", 40, false));
+    for (int i = 0; i < 40; i++) {
+        rejected.tokens.push_back(EncodedQueryToken(ToString(i), 0, true));
+    }
+    data = writeEncodedQuery(rejected);
+    FAIL_ON(readEncodedQuery(data.data(), data.size(), &read) != -1);
+    // as many distinct qvars as the engine has ids for are fine
+    rejected.tokens[0].arity = 32;
+    rejected.tokens.erase(rejected.tokens.begin() + 33, rejected.tokens.end());
+    data = writeEncodedQuery(rejected);
+    FAIL_ON(readEncodedQuery(data.data(), data.size(), &read) != 0);
+    data = writeEncodedQuery(query);
+    FAIL_ON(readEncodedQuery(data.data(), data.size(), &read) != 0);
+
+    // the expression built back has the same tokens
+    decoded = read.toCmmlToken();
+    again.setExpression(decoded);
+    FAIL_ON(again.tokens.size() != query.tokens.size());
+    for (size_t i = 0; i < again.tokens.size(); i++) {
+        FAIL_ON(again.tokens[i].value != query.tokens[i].value);
+    }
+
+    // the engine reports the qvars of both at the same xpaths
+    for (auto& meaning : {"apply", "eq", "#x", "plus"}) dict.put(meaning);
+    fromTokens = EngineSearchContext(expression, &dict).getResult(NULL,
+                                                                   0, 0, 0);
+    fromEncoded = EngineSearchContext(read, &dict).getResult(NULL, 0, 0, 0);
+    FAIL_ON(fromEncoded->qvars.size() != 2);
+    FAIL_ON(fromTokens->qvars.size() != fromEncoded->qvars.size());
+    for (size_t i = 0; i < fromTokens->qvars.size(); i++) {
+        FAIL_ON(fromTokens->qvars[i].name != fromEncoded->qvars[i].name);
+        FAIL_ON(fromTokens->qvars[i].xpath != fromEncoded->qvars[i].xpath);
+    }
+    FAIL_ON(fromEncoded->qvars[1].xpath != "/*[4]/*[3]");
+
+    delete fromEncoded;
+    delete fromTokens;
+    delete decoded;
+    delete expression;
+    return 0;
+
+fail:
+    delete fromEncoded;
+    delete fromTokens;
+    delete decoded;
+    delete expression;
+    return -1;
+}
@@ -42,51 +42,76 @@ along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
 /*--------------------------------------------------------------------------*/
 
 #define TMPFILE_PATH    "/tmp/test.map"
-#define TMPFILE_SIZE    100 * 1024 * 1024
 
 /*--------------------------------------------------------------------------*/
 /* Methods                                                                  */
 /*--------------------------------------------------------------------------*/
 
+/**
+ * Export data to a memsector at ms_path with the given layout and encoding,
+ * and load it back
+ */
 static inline
-int query_engine_tester(mws::MwsIndexNode* data,
-                        encoded_formula_t* query,
-                        result_callback_t cb,
-                        void *cb_handle) {
-
-    const char* ms_path = TMPFILE_PATH;
+int query_engine_export(mws::MwsIndexNode* data,
+                        const char* ms_path,
+                        mws::ExportLayout layout,
+                        const mws::AccessCounts* access_counts,
+                        mws::ExportEncoding encoding,
+                        memsector_handle_t* ms) {
     memsector_writer_t mswr;
-    memsector_handle_t ms;
 
     /* ensure the file does not exist */
-    FAIL_ON(unlink(TMPFILE_PATH) != 0 && errno != ENOENT);
+    FAIL_ON(unlink(ms_path) != 0 && errno != ENOENT);
 
-    FAIL_ON(memsector_create(&mswr, ms_path, TMPFILE_SIZE) != 0);
+    FAIL_ON(memsector_create(&mswr, ms_path, 0) != 0);
     printf("Memsector %s created\n", ms_path);
-    
-    data->exportToMemsector(&mswr);
-    printf("Index exported to memsector\n");
-    printf("Space used: %d\n", memsector_size_inuse(&mswr.ms_header->alloc_header));
+
+    FAIL_ON(data->exportToMemsector(&mswr, layout, access_counts,
+                                    encoding) != 0);
+    printf("Index exported to memsector with layout %d encoding %d\n",
+           layout, encoding);
+    printf("Space used: %llu\n", (unsigned long long)
+           memsector_size_inuse(&mswr.ms_header->alloc_header));
 
     FAIL_ON(memsector_save(&mswr) != 0);
     printf("Memsector saved\n");
 
-    FAIL_ON(memsector_load(&ms, ms_path) != 0);
+    FAIL_ON(memsector_load(ms, ms_path) != 0);
     printf("Memsector loaded\n");
 
+    return EXIT_SUCCESS;
+
+fail:
+    return EXIT_FAILURE;
+}
+
+static inline
+int query_engine_tester(mws::MwsIndexNode* data,
+                        encoded_formula_t* query,
+                        result_callback_t cb,
+                        void *cb_handle,
+                        mws::ExportLayout layout = mws::EXPORT_LAYOUT_DFS,
+                        const mws::AccessCounts* access_counts = NULL,
+                        mws::ExportEncoding encoding =
+                                mws::EXPORT_ENCODING_FIXED) {
+    memsector_handle_t ms;
+
+    FAIL_ON(query_engine_export(data, TMPFILE_PATH, layout, access_counts,
+                                encoding, &ms) != EXIT_SUCCESS);
+
     if (query_engine_run(&ms.index, query, cb, cb_handle)
             == QUERY_ERROR) {
         goto fail;
     }
     printf("Query successfull\n");
 
+    FAIL_ON(memsector_unload(&ms) != 0);
     FAIL_ON(memsector_remove(&ms) != 0);
     printf("Memsector removed\n");
 
     return EXIT_SUCCESS;
 
 fail:
-    if (data) delete data;
     return EXIT_FAILURE;
 }
 
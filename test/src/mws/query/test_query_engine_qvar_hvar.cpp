@@ -39,11 +39,14 @@ using namespace std;
 
 /*
 
-index: F(H,H,H): (apply,4) (F,1) (H,1) (H,1) (H,1)
+index: F(H,H,H): (apply,4) (F,0) (H,0) (H,0) (H,0)
+       H, F
 hvars: F,H
-query: Q(Q,P,h): (apply,4) (Q,1) (Q,1) (P,1) (h,1)
+query: Q(Q,P,h): (apply,4) (Q,0) (Q,0) (P,0) (h,0)
 qvars: Q,P
 
+F(H,H,H) unifies with Q = P = F = H = h, H and F with the whole query.
+
 Meanings: F -> 0
           H -> 1
 
@@ -57,8 +60,8 @@ Meanings: F -> 0
 
 static
 MwsIndexNode* create_test_MwsIndexNode() {
-    NodeInfo F_ni = make_pair(0, 1);
-    NodeInfo H_ni = make_pair(1, 1);
+    NodeInfo F_ni = make_pair(0, 0);
+    NodeInfo H_ni = make_pair(1, 0);
     NodeInfo apply_ni = make_pair(65, 4);
 
     MwsIndexNode* data = new MwsIndexNode();
@@ -72,7 +75,6 @@ MwsIndexNode* create_test_MwsIndexNode() {
     data->children.insert(make_pair(F_ni, F_node_1));
 
     MwsIndexNode* apply_node_1 = new MwsIndexNode();
-    apply_node_1->solutions = 1;
     data->children.insert(make_pair(apply_ni, apply_node_1));
 
     MwsIndexNode* F_node_2 = new MwsIndexNode();
@@ -97,10 +99,10 @@ static encoded_formula_t create_test_query() {
     result.data = new encoded_token_t[5];
     result.size = 5;
     result.data[0] = encoded_token(65, 4); // apply, 4
-    result.data[1] = encoded_token(32, 1); // Q, 1
-    result.data[2] = encoded_token(32, 1); // Q, 1
-    result.data[3] = encoded_token(33, 1); // P, 1
-    result.data[4] = encoded_token(66, 1); // h, 1
+    result.data[1] = encoded_token(32, 0); // Q, 0
+    result.data[2] = encoded_token(32, 0); // Q, 0
+    result.data[3] = encoded_token(33, 0); // P, 0
+    result.data[4] = encoded_token(66, 0); // h, 0
 
     return result;
 }
@@ -108,11 +110,11 @@ static encoded_formula_t create_test_query() {
 static
 result_cb_return_t result_callback(void* handle,
                                    const leaf_t * leaf) {
-    UNUSED(handle);
     UNUSED(leaf);
 
     printf("Result found!\n");
     fflush(stdout);
+    (*(int*) handle)++;
 
     return QUERY_CONTINUE;
 }
@@ -120,8 +122,32 @@ result_cb_return_t result_callback(void* handle,
 int main() {
     mws::MwsIndexNode* index = create_test_MwsIndexNode();
     encoded_formula_t query = create_test_query();
-
-    return -1; // TODO remove after test is running
-    return query_engine_tester(index, &query, result_callback, NULL);
+    const ExportLayout layouts[] = {
+        EXPORT_LAYOUT_DFS, EXPORT_LAYOUT_BLOCKS, EXPORT_LAYOUT_HOT
+    };
+    const ExportEncoding encodings[] = {
+        EXPORT_ENCODING_FIXED, EXPORT_ENCODING_COMPACT
+    };
+    AccessCounts accessCounts;
+    int found;
+
+    for (ExportLayout layout : layouts) {
+        for (ExportEncoding encoding : encodings) {
+            found = 0;
+            FAIL_ON(query_engine_tester(index, &query, result_callback,
+                                        &found, layout, &accessCounts,
+                                        encoding) != EXIT_SUCCESS);
+            FAIL_ON(found != 3);
+        }
+    }
+
+    delete[] query.data;
+    delete index;
+    return EXIT_SUCCESS;
+
+fail:
+    delete[] query.data;
+    delete index;
+    return EXIT_FAILURE;
 }
 
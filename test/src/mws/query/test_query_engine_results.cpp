@@ -0,0 +1,335 @@
+/*
+
+Copyright (C) 2010-2013 KWARC Group <kwarc.info>
+
+This file is part of MathWebSearch.
+
+MathWebSearch is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+MathWebSearch is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with MathWebSearch.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/**
+ * @file test_query_engine_results.cpp
+ *
+ * Answers random queries on a random index exported with every layout and
+ * encoding. Formulas without hvars are checked against a plain matcher, and
+ * every export has to give the results of the DFS layout with fixed size
+ * nodes. The index has wide inodes (Eytzinger), narrow ones (compact),
+ * unary chains longer than a path node and hvars.
+ */
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <map>
+#include <string>
+#include <vector>
+
+#define private public
+
+#include "mws/index/MwsIndexNode.hpp"
+#include "mws/index/encoded_token_dict.h"
+#include "mws/query/query_engine.h"
+
+#include "query_engine_tester.hpp"
+
+using namespace mws;
+using namespace std;
+
+#define RESULTS_MS_PATH "/tmp/test_query_engine_results.map"
+
+typedef vector<encoded_token_t> Formula;
+
+/*
+
+Constants: 64..71 with arities 0, 0, 0, 1, 1, 2, 2, 3
+           g (80, 1) applied to 100..299, which makes g a wide inode
+           u (90, 1) heading unary chains of 91..93 (arity 1)
+Hvars:     0..3
+Qvars:     32..35
+
+*/
+
+static const uint32_t ARITIES[] = { 0, 0, 0, 1, 1, 2, 2, 3 };
+
+static uint32_t
+randomNumber(uint32_t max) {
+    return (uint32_t) (rand() % max);
+}
+
+static void
+randomTerm(Formula* formula, int depth, bool hvars) {
+    if (hvars && randomNumber(6) == 0) {
+        formula->push_back(encoded_token(randomNumber(4), 0));
+        return;
+    }
+    uint32_t constant = randomNumber((depth > 0) ? 8 : 3);
+    formula->push_back(encoded_token(64 + constant, ARITIES[constant]));
+    for (uint32_t i = 0; i < ARITIES[constant]; i++) {
+        randomTerm(formula, depth - 1, hvars);
+    }
+}
+
+/**
+ * @return end of the subterm starting at pos
+ */
+static size_t
+termEnd(const Formula& formula, size_t pos) {
+    uint32_t missing = 1;
+
+    while (missing > 0) {
+        missing += formula[pos].arity;
+        missing--;
+        pos++;
+    }
+
+    return pos;
+}
+
+static bool
+sameTokens(const Formula& a, size_t aBegin, size_t aEnd,
+           const Formula& b, size_t bBegin, size_t bEnd) {
+    if (aEnd - aBegin != bEnd - bBegin) return false;
+    for (size_t i = 0; i < aEnd - aBegin; i++) {
+        if (a[aBegin + i].id != b[bBegin + i].id ||
+                a[aBegin + i].arity != b[bBegin + i].arity) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Plain matching of a query to a formula without hvars
+ */
+static bool
+matches(const Formula& query, const Formula& formula) {
+    map<uint32_t, pair<size_t, size_t> > bindings;
+    size_t pos = 0;
+
+    for (size_t i = 0; i < query.size(); i++) {
+        if (pos >= formula.size()) return false;
+        if (encoded_token_is_var(query[i])) {
+            size_t end = termEnd(formula, pos);
+            uint32_t id = encoded_token_get_id(query[i]);
+            if (bindings.count(id) == 0) {
+                bindings[id] = make_pair(pos, end);
+            } else if (!sameTokens(formula, bindings[id].first,
+                                   bindings[id].second, formula, pos, end)) {
+                return false;
+            }
+            pos = end;
+        } else {
+            if (query[i].id != formula[pos].id ||
+                    query[i].arity != formula[pos].arity) {
+                return false;
+            }
+            pos++;
+        }
+    }
+
+    return pos == formula.size();
+}
+
+/**
+ * Query from a formula, some subterms of which are replaced by qvars
+ */
+static Formula
+queryFromFormula(const Formula& formula) {
+    Formula query;
+    size_t pos = 0;
+
+    while (pos < formula.size()) {
+        if (encoded_token_is_var(formula[pos]) || randomNumber(4) == 0) {
+            query.push_back(encoded_token(QVAR_ID_MIN + randomNumber(4), 0));
+            pos = termEnd(formula, pos);
+        } else {
+            query.push_back(formula[pos]);
+            pos++;
+        }
+    }
+
+    return query;
+}
+
+static MwsIndexNode*
+insertFormula(MwsIndexNode* root, const Formula& formula) {
+    MwsIndexNode* node = root;
+
+    for (const encoded_token_t& token : formula) {
+        NodeInfo info = make_pair((MeaningId) token.id, token.arity);
+        auto it = node->children.find(info);
+        if (it == node->children.end()) {
+            MwsIndexNode* child = new MwsIndexNode();
+            node->children.insert(make_pair(info, child));
+            node = child;
+        } else {
+            node = it->second;
+        }
+    }
+    node->solutions++;
+
+    return node;
+}
+
+static void
+countAccesses(MwsIndexNode* node, AccessCounts* counts) {
+    (*counts)[node] = randomNumber(100);
+    for (auto& child : node->children) countAccesses(child.second, counts);
+}
+
+static
+result_cb_return_t result_callback(void* handle, const leaf_t* leaf) {
+    ((vector<uint32_t>*) handle)->push_back(leaf->dbid);
+
+    return QUERY_CONTINUE;
+}
+
+int main() {
+    MwsIndexNode* index = new MwsIndexNode();
+    vector<Formula> formulas;
+    vector<uint32_t> leafIds;
+    vector<Formula> queries;
+    vector<vector<uint32_t> > expected;
+    AccessCounts accessCounts;
+    memsector_handle_t ms;
+    const ExportLayout layouts[] = {
+        EXPORT_LAYOUT_DFS, EXPORT_LAYOUT_BLOCKS, EXPORT_LAYOUT_HOT
+    };
+    const ExportEncoding encodings[] = {
+        EXPORT_ENCODING_FIXED, EXPORT_ENCODING_COMPACT
+    };
+
+    srand(42);
+
+    // random formulas, some with hvars
+    for (int i = 0; i < 400; i++) {
+        Formula formula;
+        randomTerm(&formula, 1 + randomNumber(4), (i % 4 == 0));
+        formulas.push_back(formula);
+    }
+    // g(c) for 200 constants
+    for (uint32_t c = 100; c < 300; c++) {
+        Formula formula;
+        formula.push_back(encoded_token(80, 1));
+        formula.push_back(encoded_token(c, 0));
+        formulas.push_back(formula);
+    }
+    // unary chains longer than a path node, ending in a constant or an hvar
+    for (int i = 0; i < 20; i++) {
+        Formula formula;
+        formula.push_back(encoded_token(90, 1));
+        uint32_t length = 10 + randomNumber(3 * PNODE_MAX_SIZE);
+        for (uint32_t j = 0; j < length; j++) {
+            formula.push_back(encoded_token(91 + randomNumber(3), 1));
+        }
+        formula.push_back((i % 5 == 0) ? encoded_token(randomNumber(4), 0) :
+                                         encoded_token(64, 0));
+        formulas.push_back(formula);
+    }
+    for (const Formula& formula : formulas) {
+        leafIds.push_back(insertFormula(index, formula)->id);
+    }
+    const vector<uint32_t> leafIdOf = leafIds;
+    countAccesses(index, &accessCounts);
+
+    // queries from the formulas, and ones matching whole subtrees
+    for (int i = 0; i < 300; i++) {
+        queries.push_back(queryFromFormula(
+                formulas[randomNumber(formulas.size())]));
+    }
+    queries.push_back(Formula(1, encoded_token(QVAR_ID_MIN, 0)));
+    queries.push_back(Formula(1, encoded_token(80, 1)));
+    queries.back().push_back(encoded_token(QVAR_ID_MIN, 0));
+    queries.push_back(Formula(1, encoded_token(90, 1)));
+    queries.back().push_back(encoded_token(QVAR_ID_MIN, 0));
+    queries.push_back(Formula(1, encoded_token(69, 2)));
+    queries.back().push_back(encoded_token(QVAR_ID_MIN, 0));
+    queries.back().push_back(encoded_token(QVAR_ID_MIN, 0));
+    // formulas with hvars, which are instantiated to the constant 64
+    size_t numQueries = queries.size();
+    vector<size_t> instantiated;
+    for (size_t i = 0; i < formulas.size(); i++) {
+        Formula query;
+        bool hasHvars = false;
+        for (const encoded_token_t& token : formulas[i]) {
+            hasHvars |= encoded_token_is_var(token);
+            query.push_back(encoded_token_is_var(token) ?
+                            encoded_token(64, 0) : token);
+        }
+        if (hasHvars) {
+            queries.push_back(query);
+            instantiated.push_back(i);
+        }
+    }
+
+    for (ExportLayout layout : layouts) {
+        for (ExportEncoding encoding : encodings) {
+            FAIL_ON(query_engine_export(index, RESULTS_MS_PATH, layout,
+                                        &accessCounts, encoding,
+                                        &ms) != EXIT_SUCCESS);
+
+            for (size_t i = 0; i < queries.size(); i++) {
+                vector<uint32_t> results;
+                encoded_formula_t query;
+                query.data = queries[i].data();
+                query.size = queries[i].size();
+                FAIL_ON(query_engine_run(&ms.index, &query, result_callback,
+                                         &results) == QUERY_ERROR);
+                sort(results.begin(), results.end());
+
+                // formulas without hvars are results iff they match
+                for (size_t j = 0; j < formulas.size(); j++) {
+                    bool hasHvars = false;
+                    for (const encoded_token_t& token : formulas[j]) {
+                        hasHvars |= encoded_token_is_var(token);
+                    }
+                    if (hasHvars) continue;
+                    FAIL_ON(binary_search(results.begin(), results.end(),
+                                          leafIds[j]) !=
+                            matches(queries[i], formulas[j]));
+                }
+
+                // every export gives the results of the first one
+                if (expected.size() <= i) {
+                    expected.push_back(results);
+                } else {
+                    FAIL_ON(results != expected[i]);
+                }
+            }
+
+            FAIL_ON(memsector_unload(&ms) != 0);
+            FAIL_ON(memsector_remove(&ms) != 0);
+        }
+    }
+
+    // a single qvar matches every formula
+    sort(leafIds.begin(), leafIds.end());
+    leafIds.erase(unique(leafIds.begin(), leafIds.end()), leafIds.end());
+    FAIL_ON(expected[numQueries - 4] != leafIds);
+    // a formula is among the results of its hvars instantiated
+    for (size_t i = 0; i < instantiated.size(); i++) {
+        const vector<uint32_t>& results = expected[numQueries + i];
+        FAIL_ON(!binary_search(results.begin(), results.end(),
+                               leafIdOf[instantiated[i]]));
+    }
+
+    delete index;
+    return EXIT_SUCCESS;
+
+fail:
+    delete index;
+    return EXIT_FAILURE;
+}